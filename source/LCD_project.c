@@ -41,19 +41,26 @@
 #include "fsl_debug_console.h"
 /* TODO: insert other include files here. */
 #include "mma8451.h"
+#include "ring.h"
 #include "timer.h"
 #include "utility.h"
 #include "lcd.h"
+#include "dsp.h"
+#include "cadence.h"
+#include "activity.h"
 /* TODO: insert other definitions and declarations here. */
-int16_t x[100] = {0};
-int16_t y[100] = {0};
-int16_t z[100] = {0};
-int x_avg, y_avg, z_avg;
-int16_t total_vect[100] = {0};
-int16_t avg[100] = {0};
+#define FIFO_WATERMARK	16				//One 50 Hz output per FIFO interrupt at 800 Hz
+sample_ring_t ring;
+step_detector detector;
+mma_sample_t block[STEP_BLOCK_LEN];
+step_event events[STEP_BLOCK_LEN];
+int16_t block_mag[STEP_BLOCK_LEN];
+cadence_est cadence;
+activity_tracker activity;
+odometer odo;
 uint16_t step_count = 0;
-uint16_t distance = 0;
-uint16_t calorie = 0;
+uint32_t distance = 0;
+uint32_t calorie = 0;
 /*
  * @brief   Application entry point.
  */
@@ -70,13 +77,16 @@ int main(void) {
     init_systick();
     I2C_init();
 
-    if(!init_mma()){				//Initialize accelerometer
+    if(!init_mma_fifo(FIFO_WATERMARK)){		//Initialize accelerometer, 800 Hz into the FIFO
     	while(1);
     }
     lcd_init();				//initialize LCD
 
 
-    calibrate(x, y, z, &x_avg, &y_avg, &z_avg);
+    step_detector_init(&detector, NULL);
+    cadence_init(&cadence, MMA_STREAM_RATE_HZ);
+    activity_init(&activity, MMA_STREAM_RATE_HZ);
+    odometer_init(&odo, ODO_HEIGHT_CM_DEFAULT);
     delay(1000);
 /*****************Initialize LCD*****************/
     start_lcd();
@@ -87,35 +97,49 @@ int main(void) {
 	lcd_data_write("Fitness Track", LCD_LINE1);
 	delay(2000);
 	clear_lcd();
+	lcd_engine_start();							//LCD output from now on in the background
+	ring_init(&ring);
+	if(!mma_stream_start(&ring, 1)){			//FIFO interrupts fill the ring at 50 Hz
+		while(1);
+	}
 
-    volatile static int i = 0 ;
     /************main while loop*****************/
     while(1)
     {
-        i++ ;
-        if(i<100){
-        	step_count = step_detect(step_count, i);
+        //Take a block of the stream, sleep until the FIFO interrupts fill it
+        uint16_t n = 0;
+        while(n < STEP_BLOCK_LEN){
+        	n += ring_get_block(&ring, &block[n], STEP_BLOCK_LEN - n);
+        	__disable_irq();
+        	if((n < STEP_BLOCK_LEN) && (ring_count(&ring) == 0)){
+        		__WFI();						//Woken by PORTA, I2C0, DMA0 and SysTick
+        	}
+        	__enable_irq();
+        }
+        uint16_t steps = step_detect(&detector, block, n, events, STEP_BLOCK_LEN);
+        step_count += steps;
 
+        dsp_magnitude_q15(block, block_mag, n);
+        cadence_feed_block(&cadence, block_mag, n);
+
+        //Activity sets stride and energy per step. The sensor stays on
+        //the 800 Hz FIFO profile the stream and thresholds are built for.
+        activity_feed(&activity, block, n, steps, cadence.spm);
+        for(uint16_t i = 0; i < steps; i++){
+        	odometer_step(&odo, events[i].ts, activity.cls);
+        }
 
-        	distance = step_count*0.41;
-        	lcd_data_write("distance:", LCD_LINE1);
-        	lcd_data_write_int(distance, SAME_LINE);
+        distance = (uint32_t)(odo.distance_q16 >> 16);
+        lcd_fb_write(0, 0, "distance:");
+        lcd_fb_write_int(0, 9, distance, LCD_COLS - 9);
 
 /***********calorie measure Algorithm********************/
 
-        	 if ((distance%2)==0)
-        	{
-        		 delay(2000);
-        			calorie++;
-        			lcd_data_write("calorie", LCD_LINE2);
-        			lcd_data_write_int(calorie, SAME_LINE);
-        	}
-        }
-        else
-        {
-        	i=0;
-        }
+        calorie = (uint32_t)(odo.calorie_q16 >> 16);
+        lcd_fb_write(1, 0, "calorie:");
+        lcd_fb_write_int(1, 9, calorie, LCD_COLS - 9);
 
+        lcd_fb_flush();							//Only the changed cells are sent
     }
     return 0 ;
 }
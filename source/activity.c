@@ -0,0 +1,238 @@
+/**@file: activity.c
+ * @brief: Activity classifier (idle / walk / run / stairs)
+ *			activity_init clears a tracker for a given sample rate
+ *			activity_feed accumulates the features of a window and
+ *			classifies it with the generated decision tree
+ *			activity_kcal_q16 gives the energy per step of each activity
+ *			odometer: distance and calories updated on each step event, the
+ *			stride follows the cadence and the user height
+ *
+ *			The tree lives in activity_tree.h, emitted by
+ *			tools/gen_activity_tree.py from labelled feature windows.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ */
+
+#include "activity.h"
+#include "activity_tree.h"
+#include "timer.h"
+#include "utility.h"
+
+//0.04, 0.04, 0.08 and 0.10 kcal per step. Steps while idle are isolated
+//walking steps.
+const uint32_t activity_kcal_q16[ACTIVITY_COUNT] = {2621, 2621, 5243, 6554};
+
+/**
+ * @function abs32
+ * @brief  	 Absolute value
+ * @param    v	value
+ * @return   |v|
+ */
+static inline int32_t abs32(int32_t v){
+	return (v < 0) ? -v : v;
+}
+
+/**
+ * @function activity_reset_window
+ * @brief  	 Clear the accumulators of the current window
+ * @param    act	tracker state
+ * @return   none
+ */
+static void activity_reset_window(activity_tracker *act){
+	act->count = 0;
+	act->steps = 0;
+	act->sum_mag = 0;
+	act->sum_mag2 = 0;
+	act->energy[0] = 0;
+	act->energy[1] = 0;
+	act->energy[2] = 0;
+}
+
+/**
+ * @function activity_init
+ * @brief  	 Reset an activity tracker
+ * @param    1. act		tracker state
+ * 			 2. rate_hz	sample rate of the stream
+ * @return   none
+ */
+void activity_init(activity_tracker *act, uint16_t rate_hz){
+	gravity_init(&act->gravity, rate_hz);
+	act->window = rate_hz * ACTIVITY_WINDOW_S;
+	act->cls = ACTIVITY_IDLE;
+	act->cycles = 0;
+	for(uint8_t i = 0; i < FEAT_COUNT; i++){
+		act->feat[i] = 0;
+	}
+	activity_reset_window(act);
+}
+
+/**
+ * @function activity_features
+ * @brief  	 Compute the features of the completed window
+ * @param    1. act		tracker state
+ * 			 2. cadence	latest cadence estimate in steps/min
+ * @return   none
+ */
+static void activity_features(activity_tracker *act, uint16_t cadence){
+	uint32_t mean = act->sum_mag / act->count;
+	uint64_t var = (act->sum_mag2 / act->count) - ((uint64_t)mean * mean);
+	uint32_t span = act->ts_last - act->ts_start;
+	uint64_t total = act->energy[0] + act->energy[1] + act->energy[2];
+	uint8_t vert = 0;
+
+	act->feat[FEAT_STD] = (int32_t)isqrt32((var > UINT32_MAX) ? UINT32_MAX : (uint32_t)var);
+	act->feat[FEAT_STEP_RATE] = span ? (int32_t)(((uint64_t)act->steps * 60000000UL) / span) : 0;
+	act->feat[FEAT_CADENCE] = cadence;
+
+	//Vertical is the axis carrying most of gravity
+	if(abs32(act->gravity.gy) > abs32(act->gravity.gx)){
+		vert = 1;
+	}
+	if(abs32(act->gravity.gz) > abs32((vert == 1) ? act->gravity.gy : act->gravity.gx)){
+		vert = 2;
+	}
+	act->feat[FEAT_VERT_RATIO] = total ? (int32_t)((act->energy[vert] * 256) / total) : 0;
+}
+
+/**
+ * @function activity_classify
+ * @brief  	 Walk the decision tree, at most ACTIVITY_TREE_DEPTH nodes
+ * @param    feat	FEAT_COUNT feature values
+ * @return   activity class
+ */
+activity_class activity_classify(const int32_t *feat){
+	uint8_t node = 0;
+
+	for(uint8_t d = 0; d < ACTIVITY_TREE_DEPTH; d++){
+		const activity_node *nd = &activity_tree[node];
+
+		if(nd->feature == ACTIVITY_LEAF){
+			return (activity_class)nd->threshold;
+		}
+		node = (feat[nd->feature] < nd->threshold) ? nd->left : nd->right;
+	}
+	return ACTIVITY_IDLE;				//Malformed tree
+}
+
+/**
+ * @function activity_feed
+ * @brief  	 Add a block of samples and the steps found in it. When the
+ * 			 window is complete its features are computed and classified.
+ * @param    1. act		tracker state
+ * 			 2. s		acceleration samples, oldest first
+ * 			 3. n		number of samples
+ * 			 4. steps	steps detected in the block
+ * 			 5. cadence	latest cadence estimate in steps/min, 0 if none
+ * @return   1 if act->cls was updated, 0 otherwise
+ */
+uint8_t activity_feed(activity_tracker *act, const mma_sample_t *s, uint16_t n,
+					uint16_t steps, uint16_t cadence){
+	uint8_t updated = 0;
+
+	act->steps += steps;
+	for(uint16_t i = 0; i < n; i++){
+		mma_sample_t d;
+		int32_t dx, dy, dz;
+		uint32_t sq;
+
+		gravity_remove(&act->gravity, &s[i], &d);
+		dx = d.x;
+		dy = d.y;
+		dz = d.z;
+		act->energy[0] += (uint32_t)(dx * dx);
+		act->energy[1] += (uint32_t)(dy * dy);
+		act->energy[2] += (uint32_t)(dz * dz);
+		sq = (uint32_t)(dx * dx) + (uint32_t)(dy * dy) + (uint32_t)(dz * dz);
+		act->sum_mag += isqrt32(sq);
+		act->sum_mag2 += sq;
+
+		if(act->count == 0){
+			act->ts_start = s[i].ts;
+		}
+		act->ts_last = s[i].ts;
+		act->count++;
+
+		if(act->count >= act->window){
+			uint32_t start = now_cycles();
+
+			activity_features(act, cadence);
+			act->cls = activity_classify(act->feat);
+			act->cycles = now_cycles() - start;
+			activity_reset_window(act);
+			updated = 1;
+		}
+	}
+	return updated;
+}
+
+/**
+ * @function odometer_init
+ * @brief  	 Reset an odometer
+ * @param    1. odo			odometer state
+ * 			 2. height_cm	user height, sets the stride
+ * @return   none
+ */
+void odometer_init(odometer *odo, uint16_t height_cm){
+	odo->height_cm = height_cm;
+	odo->cadence = ODO_CADENCE_DEFAULT;
+	odo->last_step_us = 0;
+	odo->has_step = false;
+	odo->distance_q16 = 0;
+	odo->calorie_q16 = 0;
+}
+
+/**
+ * @function odometer_stride_q16
+ * @brief  	 Stride length for a cadence and an activity
+ * @param    1. height_cm	user height
+ * 			 2. cadence		steps/min
+ * 			 3. cls			activity
+ * @return   stride in meters, Q16
+ */
+uint32_t odometer_stride_q16(uint16_t height_cm, uint16_t cadence, activity_class cls){
+	uint32_t ratio;
+
+	if(cls == ACTIVITY_STAIRS){
+		return ODO_STAIR_STRIDE_Q16;
+	}
+	ratio = ODO_RATIO_A_Q16 + ((uint32_t)ODO_RATIO_B_Q16 * cadence);
+	if(ratio < ODO_RATIO_MIN_Q16){
+		ratio = ODO_RATIO_MIN_Q16;
+	}
+	else if(ratio > ODO_RATIO_MAX_Q16){
+		ratio = ODO_RATIO_MAX_Q16;
+	}
+	return (ratio * height_cm) / 100;
+}
+
+/**
+ * @function odometer_step
+ * @brief  	 Account for one step: update the cadence from the step
+ * 			 interval, then add the stride and energy of the activity
+ * @param    1. odo	odometer state
+ * 			 2. ts	time stamp of the step in us
+ * 			 3. cls	current activity
+ * @return   none
+ */
+void odometer_step(odometer *odo, uint32_t ts, activity_class cls){
+	if(odo->has_step){
+		uint32_t interval = ts - odo->last_step_us;
+
+		if((interval == 0) || (interval > ODO_PAUSE_US)){
+			odo->cadence = ODO_CADENCE_DEFAULT;
+		}
+		else{
+			//Quarter weight to the new interval, smooths step jitter. Rounded,
+			//truncation settles up to 3 steps/min low.
+			odo->cadence = (uint16_t)(((3UL * odo->cadence) + (60000000UL / interval) + 2) / 4);
+		}
+	}
+	odo->last_step_us = ts;
+	odo->has_step = true;
+
+	odo->distance_q16 += odometer_stride_q16(odo->height_cm, odo->cadence, cls);
+	odo->calorie_q16 += activity_kcal_q16[cls];
+}
@@ -0,0 +1,151 @@
+/**@file: activity.h
+ * @brief: Activity classifier (idle / walk / run / stairs)
+ *			activity_init clears a tracker for a given sample rate
+ *			activity_feed accumulates the features of a window and
+ *			classifies it with the generated decision tree
+ *			activity_kcal_q16 gives the energy per step of each activity
+ *			odometer: distance and calories updated on each step event, the
+ *			stride follows the cadence and the user height
+ *
+ *			The tree lives in activity_tree.h, emitted by
+ *			tools/gen_activity_tree.py from labelled feature windows.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ */
+#ifndef ACTIVITY_H_
+#define ACTIVITY_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mma8451.h"
+#include "dsp.h"
+
+#define ACTIVITY_WINDOW_S	4			//Length of a classification window
+
+typedef enum{
+	ACTIVITY_IDLE,
+	ACTIVITY_WALK,
+	ACTIVITY_RUN,
+	ACTIVITY_STAIRS,
+	ACTIVITY_COUNT
+}activity_class;
+
+//Features of one window, in the units the tree is trained on
+typedef enum{
+	FEAT_STD,							//Std deviation of the dynamic magnitude (counts)
+	FEAT_STEP_RATE,						//Steps counted in the window (steps/min)
+	FEAT_CADENCE,						//Dominant frequency of the gait (steps/min)
+	FEAT_VERT_RATIO,					//Share of the energy on the vertical axis (Q8)
+	FEAT_COUNT
+}activity_feature;
+
+#define ACTIVITY_LEAF		0xFF		//Node feature of a leaf, threshold is the class
+
+typedef struct{
+	uint8_t feature;					//activity_feature or ACTIVITY_LEAF
+	int16_t threshold;
+	uint8_t left;						//Next node when the feature is below threshold
+	uint8_t right;
+}activity_node;
+
+typedef struct{
+	gravity_tracker gravity;
+	uint16_t window;					//Samples per window
+	uint16_t count;						//Samples in the current window
+	uint32_t ts_start;
+	uint32_t ts_last;
+	uint16_t steps;
+	uint32_t sum_mag;
+	uint64_t sum_mag2;
+	uint64_t energy[3];					//Dynamic energy of each axis
+	int32_t feat[FEAT_COUNT];			//Features of the last window
+	activity_class cls;					//Class of the last window
+	uint32_t cycles;					//Core cycles of the last classification
+}activity_tracker;
+
+#define ODO_HEIGHT_CM_DEFAULT	170
+#define ODO_CADENCE_DEFAULT		100		//steps/min assumed after a pause
+#define ODO_PAUSE_US			2000000	//Longer step interval restarts the cadence
+//Stride / height = A + B * cadence, clamped to [MIN, MAX] (Q16)
+#define ODO_RATIO_A_Q16			4260	//0.065
+#define ODO_RATIO_B_Q16			229		//0.0035 per step/min
+#define ODO_RATIO_MIN_Q16		19661	//0.30
+#define ODO_RATIO_MAX_Q16		65536	//1.00
+#define ODO_STAIR_STRIDE_Q16	19661	//0.30 m, one stair tread
+
+typedef struct{
+	uint16_t height_cm;
+	uint16_t cadence;					//Smoothed from step intervals (steps/min)
+	uint32_t last_step_us;
+	bool has_step;						//last_step_us is valid
+	uint64_t distance_q16;				//Meters, 32 bits would wrap at 65 km
+	uint64_t calorie_q16;				//kcal
+}odometer;
+
+extern const uint32_t activity_kcal_q16[ACTIVITY_COUNT];
+
+/**
+ * @function activity_init
+ * @brief  	 Reset an activity tracker
+ * @param    1. act		tracker state
+ * 			 2. rate_hz	sample rate of the stream
+ * @return   none
+ */
+void activity_init(activity_tracker *act, uint16_t rate_hz);
+
+/**
+ * @function activity_feed
+ * @brief  	 Add a block of samples and the steps found in it. When the
+ * 			 window is complete its features are computed and classified.
+ * @param    1. act		tracker state
+ * 			 2. s		acceleration samples, oldest first
+ * 			 3. n		number of samples
+ * 			 4. steps	steps detected in the block
+ * 			 5. cadence	latest cadence estimate in steps/min, 0 if none
+ * @return   1 if act->cls was updated, 0 otherwise
+ */
+uint8_t activity_feed(activity_tracker *act, const mma_sample_t *s, uint16_t n,
+					uint16_t steps, uint16_t cadence);
+
+/**
+ * @function activity_classify
+ * @brief  	 Walk the decision tree, at most ACTIVITY_TREE_DEPTH nodes
+ * @param    feat	FEAT_COUNT feature values
+ * @return   activity class
+ */
+activity_class activity_classify(const int32_t *feat);
+
+/**
+ * @function odometer_init
+ * @brief  	 Reset an odometer
+ * @param    1. odo			odometer state
+ * 			 2. height_cm	user height, sets the stride
+ * @return   none
+ */
+void odometer_init(odometer *odo, uint16_t height_cm);
+
+/**
+ * @function odometer_step
+ * @brief  	 Account for one step: update the cadence from the step
+ * 			 interval, then add the stride and energy of the activity
+ * @param    1. odo	odometer state
+ * 			 2. ts	time stamp of the step in us
+ * 			 3. cls	current activity
+ * @return   none
+ */
+void odometer_step(odometer *odo, uint32_t ts, activity_class cls);
+
+/**
+ * @function odometer_stride_q16
+ * @brief  	 Stride length for a cadence and an activity
+ * @param    1. height_cm	user height
+ * 			 2. cadence		steps/min
+ * 			 3. cls			activity
+ * @return   stride in meters, Q16
+ */
+uint32_t odometer_stride_q16(uint16_t height_cm, uint16_t cadence, activity_class cls);
+
+#endif /* ACTIVITY_H_ */
@@ -0,0 +1,27 @@
+/**@file: activity_tree.h
+ * @brief: Decision tree of the activity classifier, generated by
+ *			tools/gen_activity_tree.py (default tree), do not edit.
+ *			Node: {feature, threshold, left, right}, left when the
+ *			feature is below the threshold. Leaves hold the class.
+ */
+#ifndef ACTIVITY_TREE_H_
+#define ACTIVITY_TREE_H_
+
+#define ACTIVITY_TREE_DEPTH	6
+#define ACTIVITY_TREE_NODES	11
+
+static const activity_node activity_tree[ACTIVITY_TREE_NODES] = {
+	{FEAT_STD, 250, 1, 2},		//0
+	{ACTIVITY_LEAF, ACTIVITY_IDLE, 0, 0},		//1
+	{FEAT_STEP_RATE, 40, 3, 4},		//2
+	{ACTIVITY_LEAF, ACTIVITY_IDLE, 0, 0},		//3
+	{FEAT_STEP_RATE, 140, 5, 6},		//4
+	{FEAT_VERT_RATIO, 200, 7, 8},		//5
+	{ACTIVITY_LEAF, ACTIVITY_RUN, 0, 0},		//6
+	{ACTIVITY_LEAF, ACTIVITY_WALK, 0, 0},		//7
+	{FEAT_CADENCE, 100, 9, 10},		//8
+	{ACTIVITY_LEAF, ACTIVITY_STAIRS, 0, 0},		//9
+	{ACTIVITY_LEAF, ACTIVITY_WALK, 0, 0},		//10
+};
+
+#endif /* ACTIVITY_TREE_H_ */
@@ -0,0 +1,280 @@
+/**@file: cadence.c
+ * @brief: Cadence (steps per minute) from the spectrum of the acceleration
+ *			magnitude, a cross check for the peak counting step detectors.
+ *			cadence_init clears an estimator for a given sample rate
+ *			cadence_feed / cadence_feed_block add magnitude samples and run
+ *			a windowed FFT every CADENCE_HOP samples (50% overlap)
+ *
+ *			The transform is a local Q15 radix-2 FFT with the scaling of
+ *			the CMSIS-DSP arm_cfft_q15 (1/2 per stage), the DSP library is
+ *			not linked in this project.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: https://arm-software.github.io/CMSIS_5/DSP/html/group__ComplexFFT.html
+ */
+
+#include "cadence.h"
+#include "timer.h"
+#include "utility.h"
+
+#define QUARTER		(CADENCE_FFT_LEN / 4)
+
+//sin(2*pi*i/256) for the first quarter wave, Q15
+static const int16_t sin_quarter[65] = {
+	0, 804, 1608, 2411, 3212, 4011, 4808, 5602,
+	6393, 7180, 7962, 8740, 9512, 10279, 11039, 11793,
+	12540, 13279, 14010, 14733, 15447, 16151, 16846, 17531,
+	18205, 18868, 19520, 20160, 20788, 21403, 22006, 22595,
+	23170, 23732, 24279, 24812, 25330, 25833, 26320, 26791,
+	27246, 27684, 28106, 28511, 28899, 29269, 29622, 29957,
+	30274, 30572, 30853, 31114, 31357, 31581, 31786, 31972,
+	32138, 32286, 32413, 32522, 32610, 32679, 32729, 32758,
+	32767,
+};
+
+//Work buffers of the transform, one analysis at a time (main loop only)
+static int16_t fft_re[CADENCE_FFT_LEN];
+static int16_t fft_im[CADENCE_FFT_LEN];
+
+static void cadence_analyse(cadence_est *est);
+
+/**
+ * @function sin_q15
+ * @brief  	 sin(2*pi*i/CADENCE_FFT_LEN) from the quarter wave table
+ * @param    i	angle index, 0 to CADENCE_FFT_LEN - 1
+ * @return   sine in Q15
+ */
+static int16_t sin_q15(uint16_t i){
+	//Table has 64 steps per quarter, shorter transforms skip entries
+	uint16_t k = i & (QUARTER - 1);
+	uint16_t step = 64 / QUARTER;
+
+	switch(i / QUARTER){
+	case 0:
+		return sin_quarter[k * step];
+	case 1:
+		return sin_quarter[(QUARTER - k) * step];
+	case 2:
+		return -sin_quarter[k * step];
+	default:
+		return -sin_quarter[(QUARTER - k) * step];
+	}
+}
+
+/**
+ * @function cos_q15
+ * @brief  	 cos(2*pi*i/CADENCE_FFT_LEN) from the quarter wave table
+ * @param    i	angle index, 0 to CADENCE_FFT_LEN - 1
+ * @return   cosine in Q15
+ */
+static int16_t cos_q15(uint16_t i){
+	return sin_q15((i + QUARTER) & (CADENCE_FFT_LEN - 1));
+}
+
+/**
+ * @function fft_q15
+ * @brief  	 In place radix-2 decimation in time FFT of fft_re/fft_im.
+ * 			 Each stage halves the data so the result is scaled by 1/N.
+ * @return   none
+ */
+static void fft_q15(void){
+	//Bit reversed reordering
+	for(uint16_t i = 0; i < CADENCE_FFT_LEN; i++){
+		uint16_t r = 0;
+
+		for(uint8_t b = 0; b < CADENCE_FFT_BITS; b++){
+			r |= ((i >> b) & 1) << (CADENCE_FFT_BITS - 1 - b);
+		}
+		if(r > i){
+			int16_t t = fft_re[i];
+			fft_re[i] = fft_re[r];
+			fft_re[r] = t;
+			t = fft_im[i];
+			fft_im[i] = fft_im[r];
+			fft_im[r] = t;
+		}
+	}
+
+	for(uint16_t size = 2; size <= CADENCE_FFT_LEN; size <<= 1){
+		uint16_t half = size / 2;
+		uint16_t step = CADENCE_FFT_LEN / size;
+
+		for(uint16_t j = 0; j < half; j++){
+			int32_t wr = cos_q15(j * step);
+			int32_t wi = -sin_q15(j * step);
+
+			for(uint16_t a = j; a < CADENCE_FFT_LEN; a += size){
+				uint16_t b = a + half;
+				int32_t tr = ((wr * fft_re[b]) - (wi * fft_im[b])) >> 15;
+				int32_t ti = ((wr * fft_im[b]) + (wi * fft_re[b])) >> 15;
+				int32_t ar = fft_re[a], ai = fft_im[a];
+
+				fft_re[b] = (int16_t)((ar - tr) >> 1);
+				fft_im[b] = (int16_t)((ai - ti) >> 1);
+				fft_re[a] = (int16_t)((ar + tr) >> 1);
+				fft_im[a] = (int16_t)((ai + ti) >> 1);
+			}
+		}
+	}
+}
+
+/**
+ * @function bin_mag
+ * @brief  	 Magnitude of one FFT bin
+ * @param    k	bin
+ * @return   magnitude
+ */
+static int32_t bin_mag(uint16_t k){
+	int32_t re = fft_re[k], im = fft_im[k];
+
+	return (int32_t)isqrt32((uint32_t)(re * re) + (uint32_t)(im * im));
+}
+
+/**
+ * @function cadence_init
+ * @brief  	 Reset a cadence estimator
+ * @param    1. est		estimator state
+ * 			 2. rate_hz	sample rate of the magnitude stream
+ * @return   none
+ */
+void cadence_init(cadence_est *est, uint16_t rate_hz){
+	est->pos = 0;
+	est->fill = 0;
+	est->since = 0;
+	est->rate_hz = rate_hz;
+	est->spm = 0;
+	est->peak = 0;
+	est->cycles = 0;
+}
+
+/**
+ * @function cadence_feed
+ * @brief  	 Add one magnitude sample, the window is analysed once it is
+ * 			 full and then every CADENCE_HOP samples
+ * @param    1. est		estimator state
+ * 			 2. value	magnitude, raw or band-pass filtered
+ * @return   1 if est->spm was updated, 0 otherwise
+ */
+uint8_t cadence_feed(cadence_est *est, int16_t value){
+	est->win[est->pos] = value;
+	est->pos = (est->pos + 1) & (CADENCE_FFT_LEN - 1);
+	if(est->fill < CADENCE_FFT_LEN){
+		est->fill++;
+	}
+	est->since++;
+
+	if((est->fill < CADENCE_FFT_LEN) || (est->since < CADENCE_HOP)){
+		return 0;
+	}
+	est->since = 0;
+	cadence_analyse(est);
+	return 1;
+}
+
+/**
+ * @function cadence_feed_block
+ * @brief  	 Add a block of magnitude samples
+ * @param    1. est		estimator state
+ * 			 2. src		magnitudes, oldest first
+ * 			 3. n		number of samples
+ * @return   1 if est->spm was updated, 0 otherwise
+ */
+uint8_t cadence_feed_block(cadence_est *est, const int16_t *src, uint16_t n){
+	uint8_t updated = 0;
+
+	for(uint16_t i = 0; i < n; i++){
+		updated |= cadence_feed(est, src[i]);
+	}
+	return updated;
+}
+
+/**
+ * @function cadence_analyse
+ * @brief  	 Window the buffered samples, transform them and pick the
+ * 			 strongest bin of the gait band. The peak position is refined
+ * 			 by a parabola through the peak and its neighbours.
+ * @param    est	estimator state
+ * @return   none
+ */
+static void cadence_analyse(cadence_est *est){
+	uint32_t start = now_cycles();
+	uint32_t lo = ((uint32_t)CADENCE_MIN_HZ_X10 * CADENCE_FFT_LEN + (10U * est->rate_hz) - 1) / (10U * est->rate_hz);
+	uint32_t hi = ((uint32_t)CADENCE_MAX_HZ_X10 * CADENCE_FFT_LEN) / (10U * est->rate_hz);
+	int32_t sum = 0, peak = 0, band = 0, max_abs = 1;
+	uint16_t k_peak = 0;
+	uint8_t shift = 0;
+
+	if(lo < 1){
+		lo = 1;
+	}
+	if(hi > (CADENCE_FFT_LEN / 2) - 2){
+		hi = (CADENCE_FFT_LEN / 2) - 2;
+	}
+
+	//Remove the mean (gravity) and find the range for block scaling
+	for(uint16_t i = 0; i < CADENCE_FFT_LEN; i++){
+		sum += est->win[i];
+	}
+	sum /= CADENCE_FFT_LEN;
+	for(uint16_t i = 0; i < CADENCE_FFT_LEN; i++){
+		int32_t v = est->win[i] - sum;
+
+		if(v < 0){
+			v = -v;
+		}
+		if(v > max_abs){
+			max_abs = v;
+		}
+	}
+	while((max_abs << (shift + 1)) < 16384){
+		shift++;
+	}
+
+	//Hann window, w = (1 - cos) / 2, oldest sample first
+	for(uint16_t i = 0; i < CADENCE_FFT_LEN; i++){
+		int32_t v = (est->win[(est->pos + i) & (CADENCE_FFT_LEN - 1)] - sum) * (1 << shift);
+		int32_t w = (32767 - cos_q15(i)) >> 1;
+
+		fft_re[i] = (int16_t)((v * w) >> 15);
+		fft_im[i] = 0;
+	}
+
+	fft_q15();
+
+	for(uint16_t k = lo; k <= hi; k++){
+		int32_t m = bin_mag(k);
+
+		band += m;
+		if(m > peak){
+			peak = m;
+			k_peak = k;
+		}
+	}
+	est->peak = (uint16_t)peak;
+
+	//Walking gives one clear line, noise spreads over the band. Nothing
+	//at all in the band leaves k_peak without neighbours to interpolate.
+	if((max_abs < CADENCE_MIN_SWING) || (peak == 0) || ((peak * (int32_t)(hi - lo + 1)) < (3 * band))){
+		est->spm = 0;
+	}
+	else{
+		int32_t a = bin_mag(k_peak - 1), c = bin_mag(k_peak + 1);
+		int32_t den = a - (2 * peak) + c;
+		int32_t delta = 0;				//Peak offset in 1/256 bin
+
+		if(den != 0){
+			delta = ((a - c) * 128) / den;
+		}
+		if(delta > 128){
+			delta = 128;
+		}
+		else if(delta < -128){
+			delta = -128;
+		}
+		est->spm = (uint16_t)(((((int32_t)k_peak * 256) + delta) * est->rate_hz * 60) /
+					(CADENCE_FFT_LEN * 256));
+	}
+	est->cycles = now_cycles() - start;
+}
@@ -0,0 +1,81 @@
+/**@file: cadence.h
+ * @brief: Cadence (steps per minute) from the spectrum of the acceleration
+ *			magnitude, a cross check for the peak counting step detectors.
+ *			cadence_init clears an estimator for a given sample rate
+ *			cadence_feed / cadence_feed_block add magnitude samples and run
+ *			a windowed FFT every CADENCE_HOP samples (50% overlap)
+ *
+ *			The transform is a local Q15 radix-2 FFT with the scaling of
+ *			the CMSIS-DSP arm_cfft_q15 (1/2 per stage), the DSP library is
+ *			not linked in this project.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: https://arm-software.github.io/CMSIS_5/DSP/html/group__ComplexFFT.html
+ */
+#ifndef CADENCE_H_
+#define CADENCE_H_
+
+#include <stdint.h>
+
+//256 points on the 50 Hz stream (MMA_STREAM_RATE_HZ): 5.12 s window,
+//0.2 Hz bins refined by interpolation. An analysis every 2.56 s costs a
+//few ms, well inside the idle time between two FIFO bursts.
+#define CADENCE_FFT_LEN		256			//Power of 2, 64 to 256 (sine table)
+
+#if CADENCE_FFT_LEN == 64
+#define CADENCE_FFT_BITS	6
+#elif CADENCE_FFT_LEN == 128
+#define CADENCE_FFT_BITS	7
+#elif CADENCE_FFT_LEN == 256
+#define CADENCE_FFT_BITS	8
+#else
+#error "CADENCE_FFT_LEN must be 64, 128 or 256"
+#endif
+#define CADENCE_HOP			(CADENCE_FFT_LEN / 2)
+#define CADENCE_MIN_HZ_X10	5			//Gait band searched, 0.5 - 4 Hz
+#define CADENCE_MAX_HZ_X10	40
+#define CADENCE_MIN_SWING	150			//Smallest deviation from the mean taken as walking
+
+typedef struct{
+	int16_t win[CADENCE_FFT_LEN];		//Last CADENCE_FFT_LEN samples, circular
+	uint16_t pos;						//Next write position in win
+	uint16_t fill;						//Samples in win, up to CADENCE_FFT_LEN
+	uint16_t since;						//Samples since the last analysis
+	uint16_t rate_hz;
+	uint16_t spm;						//Last cadence, 0 if not walking
+	uint16_t peak;						//Magnitude of the dominant bin (block scaled)
+	uint32_t cycles;					//Core cycles of the last analysis
+}cadence_est;
+
+/**
+ * @function cadence_init
+ * @brief  	 Reset a cadence estimator
+ * @param    1. est		estimator state
+ * 			 2. rate_hz	sample rate of the magnitude stream
+ * @return   none
+ */
+void cadence_init(cadence_est *est, uint16_t rate_hz);
+
+/**
+ * @function cadence_feed
+ * @brief  	 Add one magnitude sample, the window is analysed once it is
+ * 			 full and then every CADENCE_HOP samples
+ * @param    1. est		estimator state
+ * 			 2. value	magnitude, raw or band-pass filtered
+ * @return   1 if est->spm was updated, 0 otherwise
+ */
+uint8_t cadence_feed(cadence_est *est, int16_t value);
+
+/**
+ * @function cadence_feed_block
+ * @brief  	 Add a block of magnitude samples
+ * @param    1. est		estimator state
+ * 			 2. src		magnitudes, oldest first
+ * 			 3. n		number of samples
+ * @return   1 if est->spm was updated, 0 otherwise
+ */
+uint8_t cadence_feed_block(cadence_est *est, const int16_t *src, uint16_t n);
+
+#endif /* CADENCE_H_ */
@@ -0,0 +1,96 @@
+/**@file: dma.c
+ * @brief: This file contains the functions related to DMA0 channel 0
+ *			dma_init enables the clocks and interrupt of the DMA channel
+ *			dma_start_rx moves bytes from a peripheral data register to RAM
+ *			dma_stop aborts a transfer in progress
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ * 			https://github.com/alexander-g-dean/ESF/tree/master/NXP/Code/Chapter_9/DMA_Examples/Source
+ * 			https://www.nxp.com/docs/en/reference-manual/KL25P80M48SF0RM.pdf
+ */
+
+#include "dma.h"
+
+static dma_callback done_cb = 0;
+
+/**
+ * @function dma_init
+ * @brief  	 Enable the clock to DMA and DMAMUX and the DMA0 interrupt
+ * @param    none
+ * @return   none
+ */
+void dma_init(void){
+	SIM->SCGC7 |= SIM_SCGC7_DMA_MASK;
+	SIM->SCGC6 |= SIM_SCGC6_DMAMUX_MASK;
+
+	DMAMUX0->CHCFG[DMA_CH] = 0;					//Channel disabled until a transfer starts
+
+	NVIC_SetPriority(DMA0_IRQn, DMA_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(DMA0_IRQn);
+	NVIC_EnableIRQ(DMA0_IRQn);
+}
+
+/**
+ * @function dma_start_rx
+ * @brief  	 Start moving bytes from a peripheral data register to RAM.
+ * 			 One byte is moved per peripheral request, the callback
+ * 			 is called once all bytes have been moved.
+ *
+ * @param    1. source	DMAMUX request source of the peripheral
+ * 			 2. src		address of the peripheral data register
+ * 			 3. dst		RAM buffer receiving the data
+ * 			 4. len		number of bytes to move
+ * 			 5. cb		completion callback
+ * @return   none
+ */
+void dma_start_rx(uint8_t source, volatile const void *src, uint8_t *dst, uint32_t len, dma_callback cb){
+	done_cb = cb;
+
+	DMAMUX0->CHCFG[DMA_CH] = 0;
+	DMA0->DMA[DMA_CH].DSR_BCR = DMA_DSR_BCR_DONE_MASK;		//Clear previous status
+
+	DMA0->DMA[DMA_CH].SAR = (uint32_t)src;
+	DMA0->DMA[DMA_CH].DAR = (uint32_t)dst;
+	DMA0->DMA[DMA_CH].DSR_BCR = DMA_DSR_BCR_BCR(len);
+
+	DMA0->DMA[DMA_CH].DCR = DMA_DCR_EINT_MASK |		//Interrupt when done
+							DMA_DCR_ERQ_MASK |		//Peripheral requests
+							DMA_DCR_CS_MASK |		//One transfer per request
+							DMA_DCR_SSIZE(1) |		//8 bit source
+							DMA_DCR_DSIZE(1) |		//8 bit destination
+							DMA_DCR_DINC_MASK |		//Increment destination only
+							DMA_DCR_D_REQ_MASK;		//Clear ERQ when BCR reaches 0
+
+	DMAMUX0->CHCFG[DMA_CH] = DMAMUX_CHCFG_SOURCE(source) | DMAMUX_CHCFG_ENBL_MASK;
+}
+
+/**
+ * @function dma_stop
+ * @brief  	 Abort the transfer in progress, the callback is not called
+ * @param    none
+ * @return   none
+ */
+void dma_stop(void){
+	DMAMUX0->CHCFG[DMA_CH] = 0;
+	DMA0->DMA[DMA_CH].DCR = 0;
+	DMA0->DMA[DMA_CH].DSR_BCR = DMA_DSR_BCR_DONE_MASK;		//Clear status
+	NVIC_ClearPendingIRQ(DMA0_IRQn);
+}
+
+/**
+ * @function DMA0_IRQHandler
+ * @brief  	 Clears the channel status and calls the completion callback
+ * @param    none
+ * @return   none
+ */
+void DMA0_IRQHandler(void){
+	DMA0->DMA[DMA_CH].DSR_BCR = DMA_DSR_BCR_DONE_MASK;		//Clear interrupt
+	DMAMUX0->CHCFG[DMA_CH] = 0;
+
+	if(done_cb){
+		done_cb();
+	}
+}
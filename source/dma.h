@@ -0,0 +1,59 @@
+/**@file: dma.h
+ * @brief: This file contains the functions related to DMA0 channel 0
+ *			dma_init enables the clocks and interrupt of the DMA channel
+ *			dma_start_rx moves bytes from a peripheral data register to RAM
+ *			dma_stop aborts a transfer in progress
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ * 			https://github.com/alexander-g-dean/ESF/tree/master/NXP/Code/Chapter_9/DMA_Examples/Source
+ * 			https://www.nxp.com/docs/en/reference-manual/KL25P80M48SF0RM.pdf
+ */
+#ifndef DMA_H_
+#define DMA_H_
+
+#include <stdint.h>
+#include "MKL25Z4.h"
+
+#define DMA_CH				0			//DMA channel used for peripheral reads
+#define DMA_IRQ_PRIORITY	2
+
+#define DMAMUX_SRC_I2C0		22			//DMAMUX request source of I2C0
+
+//Called from the DMA0 interrupt when all bytes have been moved
+typedef void (*dma_callback)(void);
+
+/**
+ * @function dma_init
+ * @brief  	 Enable the clock to DMA and DMAMUX and the DMA0 interrupt
+ * @param    none
+ * @return   none
+ */
+void dma_init(void);
+
+/**
+ * @function dma_start_rx
+ * @brief  	 Start moving bytes from a peripheral data register to RAM.
+ * 			 One byte is moved per peripheral request, the callback
+ * 			 is called once all bytes have been moved.
+ *
+ * @param    1. source	DMAMUX request source of the peripheral
+ * 			 2. src		address of the peripheral data register
+ * 			 3. dst		RAM buffer receiving the data
+ * 			 4. len		number of bytes to move
+ * 			 5. cb		completion callback
+ * @return   none
+ */
+void dma_start_rx(uint8_t source, volatile const void *src, uint8_t *dst, uint32_t len, dma_callback cb);
+
+/**
+ * @function dma_stop
+ * @brief  	 Abort the transfer in progress, the callback is not called
+ * @param    none
+ * @return   none
+ */
+void dma_stop(void);
+
+#endif /* DMA_H_ */
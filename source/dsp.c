@@ -0,0 +1,369 @@
+/**@file: dsp.c
+ * @brief: Fixed point signal processing for the step pipeline
+ *			dsp_magnitude_q15 computes the acceleration magnitude of samples
+ *			dsp_biquad_q15 runs a cascade of Q15 direct form I biquads
+ *			gait_bandpass_coeffs keeps the 0.5 - 5 Hz gait band at GAIT_FS_HZ
+ *			gravity_tracker follows the static (gravity) part of each axis
+ *			for the activity features, step detection does not need it:
+ *			the magnitude does not depend on orientation and the gait
+ *			band-pass removes its static part
+ *			dsp_fir_decimate_q15 low pass filters and down samples a block
+ *			dsp_decimator turns high ODR FIFO bursts into the 50 Hz stream
+ *
+ *			The biquad and the decimator use the coefficient and state layout
+ *			of the CMSIS-DSP arm_biquad_cascade_df1_q15() and
+ *			arm_fir_decimate_q15() so the library versions can be dropped in
+ *			once it is linked (the project only ships arm_math.h).
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: https://arm-software.github.io/CMSIS_5/DSP/html/group__BiquadCascadeDF1.html
+ * 			 https://arm-software.github.io/CMSIS_5/DSP/html/group__FIR__decimate.html
+ * 			 https://www.w3.org/TR/audio-eq-cookbook/
+ */
+
+#include "dsp.h"
+#include "timer.h"
+#include "utility.h"
+
+//The tangent series below is good to 1e-5 up to fs / 6
+#if (GAIT_LPF_HZ * 6) > GAIT_FS_HZ
+#error "GAIT_FS_HZ too low for the gait band-pass"
+#endif
+
+//2nd order Butterworth section by the bilinear transform, folded by the
+//compiler from the stream rate. K = tan(pi * fc / fs), a1/a2 negated for
+//the CMSIS form.
+#define BW_SQRT2			1.41421356237310
+#define BW_TAN(x)			((x) + ((x) * (x) * (x) / 3) + (2 * (x) * (x) * (x) * (x) * (x) / 15) + \
+							(17 * (x) * (x) * (x) * (x) * (x) * (x) * (x) / 315))
+#define BW_K(fc)			BW_TAN(3.14159265358979 * (fc) / GAIT_FS_HZ)
+#define BW_NORM(fc)			(1.0 / (1.0 + (BW_SQRT2 * BW_K(fc)) + (BW_K(fc) * BW_K(fc))))
+#define BW_A1(fc)			(2.0 * (1.0 - (BW_K(fc) * BW_K(fc))) * BW_NORM(fc))
+#define BW_A2(fc)			(-(1.0 - (BW_SQRT2 * BW_K(fc)) + (BW_K(fc) * BW_K(fc))) * BW_NORM(fc))
+#define BW_HP_B0(fc)		BW_NORM(fc)
+#define BW_LP_B0(fc)		(BW_K(fc) * BW_K(fc) * BW_NORM(fc))
+
+//High pass GAIT_HPF_HZ then low pass GAIT_LPF_HZ
+const int16_t gait_bandpass_coeffs[6 * GAIT_BANDPASS_STAGES] = {
+	DSP_Q14(BW_HP_B0(GAIT_HPF_HZ)), 0, DSP_Q14(-2.0 * BW_HP_B0(GAIT_HPF_HZ)), DSP_Q14(BW_HP_B0(GAIT_HPF_HZ)),
+	DSP_Q14(BW_A1(GAIT_HPF_HZ)), DSP_Q14(BW_A2(GAIT_HPF_HZ)),
+	DSP_Q14(BW_LP_B0(GAIT_LPF_HZ)), 0, DSP_Q14(2.0 * BW_LP_B0(GAIT_LPF_HZ)), DSP_Q14(BW_LP_B0(GAIT_LPF_HZ)),
+	DSP_Q14(BW_A1(GAIT_LPF_HZ)), DSP_Q14(BW_A2(GAIT_LPF_HZ))
+};
+
+//Hamming windowed sinc, 20 Hz at 800 Hz (10 Hz at 400 Hz), Q15.
+//Below -50 dB around every multiple of 50 Hz that folds onto 0 - 5 Hz.
+const int16_t decim_coeffs[DECIM_TAPS] = {
+	-26, -28, -32, -36, -41, -46, -50, -52,
+	-51, -45, -33, -13, 16, 55, 106, 169,
+	244, 330, 428, 535, 651, 771, 895, 1019,
+	1140, 1255, 1360, 1453, 1531, 1592, 1634, 1653,
+	1653, 1634, 1592, 1531, 1453, 1360, 1255, 1140,
+	1019, 895, 771, 651, 535, 428, 330, 244,
+	169, 106, 55, 16, -13, -33, -45, -51,
+	-52, -50, -46, -41, -36, -32, -28, -26,
+};
+
+/**
+ * @function dsp_sat_q15
+ * @brief  	 Saturate to the Q15 range
+ * @param    v	value
+ * @return   saturated value
+ */
+static inline int16_t dsp_sat_q15(int64_t v){
+	if(v > INT16_MAX){
+		return INT16_MAX;
+	}
+	if(v < INT16_MIN){
+		return INT16_MIN;
+	}
+	return (int16_t)v;
+}
+
+/**
+ * @function dsp_biquad_init_q15
+ * @brief  	 Initialize a biquad cascade and clear its state
+ * @param    1. S			filter instance
+ * 			 2. num_stages	number of second order stages
+ * 			 3. coeffs		6 coefficients per stage
+ * 			 4. state		4 state values per stage
+ * 			 5. post_shift	coefficient scaling (Q15 >> post_shift)
+ * @return   none
+ */
+void dsp_biquad_init_q15(dsp_biquad_q15_t *S, uint8_t num_stages, const int16_t *coeffs,
+						int16_t *state, int8_t post_shift){
+	S->num_stages = num_stages;
+	S->post_shift = post_shift;
+	S->coeffs = coeffs;
+	S->state = state;
+	S->cycles = 0;
+	for(int i = 0; i < 4 * num_stages; i++){
+		state[i] = 0;
+	}
+}
+
+/**
+ * @function dsp_biquad_q15
+ * @brief  	 Filter a block of samples through the cascade. Products are
+ * 			 accumulated on 64 bits and the output saturated to Q15.
+ * @param    1. S			filter instance
+ * 			 2. src			input block
+ * 			 3. dst			output block (can be src)
+ * 			 4. block_size	number of samples
+ * @return   none
+ */
+void dsp_biquad_q15(dsp_biquad_q15_t *S, const int16_t *src, int16_t *dst, uint32_t block_size){
+	uint32_t start = now_cycles();
+	const int16_t *c = S->coeffs;
+	int16_t *st = S->state;
+	uint8_t shift = 15 - S->post_shift;
+	const int16_t *in = src;
+
+	for(uint8_t stage = 0; stage < S->num_stages; stage++){
+		int32_t b0 = c[0], b1 = c[2], b2 = c[3], a1 = c[4], a2 = c[5];
+		int16_t x1 = st[0], x2 = st[1], y1 = st[2], y2 = st[3];
+
+		//Stage state stays in registers for the whole block
+		for(uint32_t n = 0; n < block_size; n++){
+			int16_t x0 = in[n];
+			int64_t acc = ((int64_t)b0 * x0) + ((int64_t)b1 * x1) + ((int64_t)b2 * x2) +
+						  ((int64_t)a1 * y1) + ((int64_t)a2 * y2);
+			int16_t y0 = dsp_sat_q15(acc >> shift);
+
+			x2 = x1;
+			x1 = x0;
+			y2 = y1;
+			y1 = y0;
+			dst[n] = y0;
+		}
+
+		st[0] = x1;
+		st[1] = x2;
+		st[2] = y1;
+		st[3] = y2;
+		c += 6;
+		st += 4;
+		in = dst;						//Next stage filters the output in place
+	}
+	S->cycles = now_cycles() - start;
+}
+
+/**
+ * @function dsp_magnitude_q15
+ * @brief  	 Acceleration magnitude of each sample, in 2g counts
+ * @param    1. s	samples
+ * 			 2. dst	magnitudes, saturated to Q15
+ * 			 3. n	number of samples
+ * @return   none
+ */
+void dsp_magnitude_q15(const mma_sample_t *s, int16_t *dst, uint32_t n){
+	for(uint32_t i = 0; i < n; i++){
+		int32_t x = s[i].x, y = s[i].y, z = s[i].z;
+
+		dst[i] = dsp_sat_q15(isqrt32((uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z)));
+	}
+}
+
+/**
+ * @function gravity_init
+ * @brief  	 Reset a gravity tracker, the time constant is about
+ * 			 GRAVITY_TAU_S at the given sample rate
+ * @param    1. gt		tracker state
+ * 			 2. rate_hz	sample rate of the stream
+ * @return   none
+ */
+void gravity_init(gravity_tracker *gt, uint16_t rate_hz){
+	uint32_t tau = (uint32_t)rate_hz * GRAVITY_TAU_S;
+	uint8_t shift = 0;
+
+	while((shift < 15) && ((1UL << (shift + 1)) <= tau)){
+		shift++;
+	}
+	gt->shift = shift;
+	gt->gx = 0;
+	gt->gy = 0;
+	gt->gz = 0;
+	gt->primed = false;
+}
+
+/**
+ * @function gravity_remove
+ * @brief  	 Update the gravity estimate with a sample and return the
+ * 			 sample without it. The first sample seeds the estimate.
+ * @param    1. gt	tracker state
+ * 			 2. in	acceleration sample
+ * 			 3. out	dynamic acceleration, saturated to int16 (can be in)
+ * @return   none
+ */
+void gravity_remove(gravity_tracker *gt, const mma_sample_t *in, mma_sample_t *out){
+	int32_t x = in->x * 256, y = in->y * 256, z = in->z * 256;
+
+	if(!gt->primed){
+		gt->gx = x;
+		gt->gy = y;
+		gt->gz = z;
+		gt->primed = true;
+	}
+	else{
+		gt->gx += (x - gt->gx) >> gt->shift;
+		gt->gy += (y - gt->gy) >> gt->shift;
+		gt->gz += (z - gt->gz) >> gt->shift;
+	}
+
+	out->ts = in->ts;
+	out->x = dsp_sat_q15((x - gt->gx) >> 8);
+	out->y = dsp_sat_q15((y - gt->gy) >> 8);
+	out->z = dsp_sat_q15((z - gt->gz) >> 8);
+}
+
+/**
+ * @function dsp_fir_decimate_init_q15
+ * @brief  	 Initialize a FIR decimator and clear its state
+ * @param    1. S			decimator instance
+ * 			 2. num_taps	filter length
+ * 			 3. M			decimation factor
+ * 			 4. coeffs		num_taps coefficients
+ * 			 5. state		num_taps + block_size - 1 values
+ * 			 6. block_size	largest block, multiple of M
+ * @return   1 on success, 0 if block_size is not a multiple of M
+ */
+uint8_t dsp_fir_decimate_init_q15(dsp_fir_decimate_q15_t *S, uint16_t num_taps, uint8_t M,
+								const int16_t *coeffs, int16_t *state, uint16_t block_size){
+	if((M == 0) || ((block_size % M) != 0)){
+		return 0;
+	}
+	S->M = M;
+	S->num_taps = num_taps;
+	S->coeffs = coeffs;
+	S->state = state;
+	S->cycles = 0;
+	for(uint16_t i = 0; i < (num_taps + block_size - 1); i++){
+		state[i] = 0;
+	}
+	return 1;
+}
+
+/**
+ * @function dsp_fir_decimate_q15
+ * @brief  	 Filter a block and keep one output every M inputs. Only the
+ * 			 kept outputs are computed.
+ * @param    1. S			decimator instance
+ * 			 2. src			input block
+ * 			 3. dst			block_size / M outputs
+ * 			 4. block_size	number of inputs, multiple of M
+ * @return   none
+ */
+void dsp_fir_decimate_q15(dsp_fir_decimate_q15_t *S, const int16_t *src, int16_t *dst, uint16_t block_size){
+	uint32_t start = now_cycles();
+	int16_t *st = S->state;
+	uint16_t taps = S->num_taps;
+	uint16_t cur = taps - 1;			//Inputs go after the last num_taps - 1
+	uint16_t in = 0;
+
+	for(uint16_t o = 0; o < (block_size / S->M); o++){
+		int64_t acc = 0;
+
+		for(uint8_t m = 0; m < S->M; m++){
+			st[cur++] = src[in++];
+		}
+		//Window ends at the newest input, coefficients are time reversed
+		for(uint16_t k = 0; k < taps; k++){
+			acc += (int32_t)st[(o * S->M) + S->M - 1 + k] * S->coeffs[k];
+		}
+		dst[o] = dsp_sat_q15(acc >> 15);
+	}
+
+	//Keep the last num_taps - 1 inputs for the next block
+	for(uint16_t k = 0; k < (taps - 1); k++){
+		st[k] = st[block_size + k];
+	}
+	S->cycles = now_cycles() - start;
+}
+
+/**
+ * @function dsp_decimator_init
+ * @brief  	 Initialize a three axis decimator with decim_coeffs. The
+ * 			 filter keeps 0 - 5 Hz for 800 Hz / 16 and 400 Hz / 8.
+ * @param    1. dec	decimator state
+ * 			 2. M	decimation factor, divides DECIM_MAX_BLOCK
+ * @return   1 on success, 0 if the factor is not supported
+ */
+uint8_t dsp_decimator_init(dsp_decimator *dec, uint8_t M){
+	dec->fill = 0;
+	dec->cycles = 0;
+	for(uint8_t a = 0; a < 3; a++){
+		if(!dsp_fir_decimate_init_q15(&dec->axis[a], DECIM_TAPS, M, decim_coeffs,
+									dec->state[a], DECIM_MAX_BLOCK)){
+			return 0;
+		}
+	}
+	return 1;
+}
+
+/**
+ * @function dsp_decimator_flush
+ * @brief  	 Decimate the complete groups waiting in the input buffer
+ * @param    1. dec	decimator state
+ * 			 2. out	decimated samples
+ * @return   number of decimated samples
+ */
+static uint16_t dsp_decimator_flush(dsp_decimator *dec, mma_sample_t *out){
+	uint8_t M = dec->axis[0].M;
+	uint8_t blk = dec->fill - (dec->fill % M);
+	uint8_t n = blk / M;
+	int16_t res[3][DECIM_MAX_BLOCK];
+
+	for(uint8_t a = 0; a < 3; a++){
+		dsp_fir_decimate_q15(&dec->axis[a], dec->in[a], res[a], blk);
+	}
+	for(uint8_t i = 0; i < n; i++){
+		out[i].ts = dec->ts[(i * M) + M - 1];
+		out[i].x = res[0][i];
+		out[i].y = res[1][i];
+		out[i].z = res[2][i];
+	}
+
+	//Incomplete group waits for the next burst
+	for(uint8_t i = blk; i < dec->fill; i++){
+		dec->in[0][i - blk] = dec->in[0][i];
+		dec->in[1][i - blk] = dec->in[1][i];
+		dec->in[2][i - blk] = dec->in[2][i];
+		dec->ts[i - blk] = dec->ts[i];
+	}
+	dec->fill -= blk;
+	return n;
+}
+
+/**
+ * @function dsp_decimator_feed
+ * @brief  	 Decimate a burst of samples. Inputs that do not complete a
+ * 			 group of M are kept for the next burst. An output carries
+ * 			 the time stamp of the last input of its group.
+ * @param    1. dec	decimator state
+ * 			 2. in	samples, oldest first
+ * 			 3. n	number of samples
+ * 			 4. out	decimated samples, room for (n + M - 1) / M
+ * @return   number of decimated samples
+ */
+uint16_t dsp_decimator_feed(dsp_decimator *dec, const mma_sample_t *in, uint16_t n, mma_sample_t *out){
+	uint32_t start = now_cycles();
+	uint16_t outs = 0;
+
+	for(uint16_t i = 0; i < n; i++){
+		dec->in[0][dec->fill] = in[i].x;
+		dec->in[1][dec->fill] = in[i].y;
+		dec->in[2][dec->fill] = in[i].z;
+		dec->ts[dec->fill] = in[i].ts;
+		dec->fill++;
+		if(dec->fill == DECIM_MAX_BLOCK){
+			outs += dsp_decimator_flush(dec, &out[outs]);
+		}
+	}
+	if(dec->fill >= dec->axis[0].M){
+		outs += dsp_decimator_flush(dec, &out[outs]);
+	}
+	dec->cycles = now_cycles() - start;
+	return outs;
+}
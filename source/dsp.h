@@ -0,0 +1,190 @@
+/**@file: dsp.h
+ * @brief: Fixed point signal processing for the step pipeline
+ *			dsp_magnitude_q15 computes the acceleration magnitude of samples
+ *			dsp_biquad_q15 runs a cascade of Q15 direct form I biquads
+ *			gait_bandpass_coeffs keeps the 0.5 - 5 Hz gait band at GAIT_FS_HZ
+ *			gravity_tracker follows the static (gravity) part of each axis
+ *			for the activity features, step detection does not need it:
+ *			the magnitude does not depend on orientation and the gait
+ *			band-pass removes its static part
+ *			dsp_fir_decimate_q15 low pass filters and down samples a block
+ *			dsp_decimator turns high ODR FIFO bursts into the 50 Hz stream
+ *
+ *			The biquad and the decimator use the coefficient and state layout
+ *			of the CMSIS-DSP arm_biquad_cascade_df1_q15() and
+ *			arm_fir_decimate_q15() so the library versions can be dropped in
+ *			once it is linked (the project only ships arm_math.h).
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: https://arm-software.github.io/CMSIS_5/DSP/html/group__BiquadCascadeDF1.html
+ * 			 https://arm-software.github.io/CMSIS_5/DSP/html/group__FIR__decimate.html
+ * 			 https://www.w3.org/TR/audio-eq-cookbook/
+ */
+#ifndef DSP_H_
+#define DSP_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mma8451.h"
+
+//Coefficient conversion done by the compiler, no float code in the image
+#define DSP_Q14(v)			((int16_t)(((v) * 16384.0) + (((v) >= 0) ? 0.5 : -0.5)))
+
+#define GAIT_FS_HZ			MMA_STREAM_RATE_HZ	//Rate of the processing stream
+#define GAIT_HPF_HZ			0.5			//Band kept by gait_bandpass_coeffs
+#define GAIT_LPF_HZ			5
+#define GAIT_BANDPASS_STAGES	2
+#define GAIT_BANDPASS_SHIFT	1			//Coefficients are Q14 (Q15 >> 1)
+
+//Cascade of biquads, coeffs {b0, 0, b1, b2, a1, a2} and state
+//{x[n-1], x[n-2], y[n-1], y[n-2]} per stage, a1/a2 with CMSIS sign
+typedef struct{
+	uint8_t num_stages;
+	int8_t post_shift;
+	const int16_t *coeffs;
+	int16_t *state;
+	uint32_t cycles;					//Core cycles spent on the last block
+}dsp_biquad_q15_t;
+
+#define GRAVITY_TAU_S		2			//Time constant of the gravity estimate
+
+//First order low pass per axis, estimates are Q8 counts
+typedef struct{
+	int32_t gx, gy, gz;
+	uint8_t shift;						//Time constant is 2^shift samples
+	bool primed;						//Estimates are initialized
+}gravity_tracker;
+
+#define DECIM_TAPS			64
+#define DECIM_MAX_BLOCK		MMA_FIFO_SIZE	//Largest input block, multiple of the factor
+
+//FIR decimator, state holds num_taps + block_size - 1 samples
+typedef struct{
+	uint8_t M;							//Decimation factor
+	uint16_t num_taps;
+	const int16_t *coeffs;				//Q15, time reversed
+	int16_t *state;
+	uint32_t cycles;					//Core cycles spent on the last block
+}dsp_fir_decimate_q15_t;
+
+//Decimates the three axes of a sample stream, any burst length
+typedef struct{
+	dsp_fir_decimate_q15_t axis[3];
+	int16_t state[3][DECIM_TAPS + DECIM_MAX_BLOCK - 1];
+	int16_t in[3][DECIM_MAX_BLOCK];		//Inputs waiting for a full group
+	uint32_t ts[DECIM_MAX_BLOCK];
+	uint8_t fill;
+	uint32_t cycles;					//Core cycles spent on the last burst
+}dsp_decimator;
+
+extern const int16_t gait_bandpass_coeffs[6 * GAIT_BANDPASS_STAGES];
+extern const int16_t decim_coeffs[DECIM_TAPS];
+
+/**
+ * @function dsp_biquad_init_q15
+ * @brief  	 Initialize a biquad cascade and clear its state
+ * @param    1. S			filter instance
+ * 			 2. num_stages	number of second order stages
+ * 			 3. coeffs		6 coefficients per stage
+ * 			 4. state		4 state values per stage
+ * 			 5. post_shift	coefficient scaling (Q15 >> post_shift)
+ * @return   none
+ */
+void dsp_biquad_init_q15(dsp_biquad_q15_t *S, uint8_t num_stages, const int16_t *coeffs,
+						int16_t *state, int8_t post_shift);
+
+/**
+ * @function dsp_biquad_q15
+ * @brief  	 Filter a block of samples through the cascade. Products are
+ * 			 accumulated on 64 bits and the output saturated to Q15.
+ * @param    1. S			filter instance
+ * 			 2. src			input block
+ * 			 3. dst			output block (can be src)
+ * 			 4. block_size	number of samples
+ * @return   none
+ */
+void dsp_biquad_q15(dsp_biquad_q15_t *S, const int16_t *src, int16_t *dst, uint32_t block_size);
+
+/**
+ * @function dsp_magnitude_q15
+ * @brief  	 Acceleration magnitude of each sample, in 2g counts
+ * @param    1. s	samples
+ * 			 2. dst	magnitudes, saturated to Q15
+ * 			 3. n	number of samples
+ * @return   none
+ */
+void dsp_magnitude_q15(const mma_sample_t *s, int16_t *dst, uint32_t n);
+
+/**
+ * @function gravity_init
+ * @brief  	 Reset a gravity tracker, the time constant is about
+ * 			 GRAVITY_TAU_S at the given sample rate
+ * @param    1. gt		tracker state
+ * 			 2. rate_hz	sample rate of the stream
+ * @return   none
+ */
+void gravity_init(gravity_tracker *gt, uint16_t rate_hz);
+
+/**
+ * @function gravity_remove
+ * @brief  	 Update the gravity estimate with a sample and return the
+ * 			 sample without it. The first sample seeds the estimate.
+ * @param    1. gt	tracker state
+ * 			 2. in	acceleration sample
+ * 			 3. out	dynamic acceleration, saturated to int16 (can be in)
+ * @return   none
+ */
+void gravity_remove(gravity_tracker *gt, const mma_sample_t *in, mma_sample_t *out);
+
+/**
+ * @function dsp_fir_decimate_init_q15
+ * @brief  	 Initialize a FIR decimator and clear its state
+ * @param    1. S			decimator instance
+ * 			 2. num_taps	filter length
+ * 			 3. M			decimation factor
+ * 			 4. coeffs		num_taps coefficients
+ * 			 5. state		num_taps + block_size - 1 values
+ * 			 6. block_size	largest block, multiple of M
+ * @return   1 on success, 0 if block_size is not a multiple of M
+ */
+uint8_t dsp_fir_decimate_init_q15(dsp_fir_decimate_q15_t *S, uint16_t num_taps, uint8_t M,
+								const int16_t *coeffs, int16_t *state, uint16_t block_size);
+
+/**
+ * @function dsp_fir_decimate_q15
+ * @brief  	 Filter a block and keep one output every M inputs. Only the
+ * 			 kept outputs are computed.
+ * @param    1. S			decimator instance
+ * 			 2. src			input block
+ * 			 3. dst			block_size / M outputs
+ * 			 4. block_size	number of inputs, multiple of M
+ * @return   none
+ */
+void dsp_fir_decimate_q15(dsp_fir_decimate_q15_t *S, const int16_t *src, int16_t *dst, uint16_t block_size);
+
+/**
+ * @function dsp_decimator_init
+ * @brief  	 Initialize a three axis decimator with decim_coeffs. The
+ * 			 filter keeps 0 - 5 Hz for 800 Hz / 16 and 400 Hz / 8.
+ * @param    1. dec	decimator state
+ * 			 2. M	decimation factor, divides DECIM_MAX_BLOCK
+ * @return   1 on success, 0 if the factor is not supported
+ */
+uint8_t dsp_decimator_init(dsp_decimator *dec, uint8_t M);
+
+/**
+ * @function dsp_decimator_feed
+ * @brief  	 Decimate a burst of samples. Inputs that do not complete a
+ * 			 group of M are kept for the next burst. An output carries
+ * 			 the time stamp of the last input of its group.
+ * @param    1. dec	decimator state
+ * 			 2. in	samples, oldest first
+ * 			 3. n	number of samples
+ * 			 4. out	decimated samples, room for (n + M - 1) / M
+ * @return   number of decimated samples
+ */
+uint16_t dsp_decimator_feed(dsp_decimator *dec, const mma_sample_t *in, uint16_t n, mma_sample_t *out);
+
+#endif /* DSP_H_ */
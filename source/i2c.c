@@ -1,12 +1,17 @@
 /**@file: i2c .c
  * @brief: This file contains all the function related to  i2c
  *			i2c_init this file contains all the configuration of registers
- *			i2c_busy checks if the i2c line is busy or not
- *			i2c_wait i2c wait till the line is cleared or not
- *			i2c_start starts the I2c Transfer and receive register
  *			i2c_read reads the value from specific address
- *			i2c_repeated_read reads value from specific address
  *			i2c_write write the data to specific device and memory location
+ *			i2c_read_block / i2c_write_block access consecutive registers
+ *			i2c_write_batch writes a list of registers with a single STOP
+ *			i2c_submit queues a transaction for the interrupt driven engine
+ *			i2c_engine_idle reports if the engine has finished all transactions
+ *			reads flagged I2C_XFER_DMA are moved to RAM by DMA0 channel 0
+ *			failed transactions are retried after clocking a stuck slave off the bus
+ *			i2c_engine_get_stats returns transfer and error counters
+ *			i2c_set_speed computes the baud rate divider from the bus clock
+ *			i2c_get_throughput reports the measured bytes per second
  * @author: Swapnil Ghonge
  * @date: 	May 2nd 2022
  * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
@@ -19,9 +24,68 @@
  */
 
 #include "i2c.h"
-
-int lock_detect = 0;
-int i2c_lock = 0;
+#include "dma.h"
+#include "timer.h"
+#include "fsl_clock.h"
+
+#define SCL_MASK	((uint32_t)1 << I2C_SCL_PIN)
+#define SDA_MASK	((uint32_t)1 << I2C_SDA_PIN)
+
+//States of the interrupt driven engine
+typedef enum{
+	I2C_STATE_ADDR,				//Device address (write) sent
+	I2C_STATE_REG,				//Register address sent
+	I2C_STATE_TX_DATA,			//Data byte sent
+	I2C_STATE_ADDR_READ,		//Device address (read) sent after repeated start
+	I2C_STATE_RX_DATA,			//Data byte received
+	I2C_STATE_WAIT_BUS,			//Waiting for the stop detect of the previous transaction
+	I2C_STATE_RECOVER			//Bus clear sequence running, then retry
+}i2c_state;
+
+//Steps of the bus clear sequence, one line edge per half SCL period
+typedef enum{
+	I2C_REC_IDLE,
+	I2C_REC_RELEASE,			//Pins to GPIO, both lines released
+	I2C_REC_SCL_LOW,			//Clock pulse while the slave holds SDA
+	I2C_REC_SCL_HIGH,
+	I2C_REC_STOP_SDA_LOW,		//STOP: SDA rises while SCL is high
+	I2C_REC_STOP_SCL_HIGH,
+	I2C_REC_STOP_SDA_HIGH,
+	I2C_REC_ENABLE				//Pins back to I2C0
+}i2c_rec_phase;
+
+static i2c_xfer_t *volatile queue[I2C_QUEUE_LEN];
+static volatile uint8_t q_head = 0;		//Next free slot, written by submitter
+static volatile uint8_t q_tail = 0;		//Next transaction to run, written by engine
+static i2c_xfer_t *volatile cur = NULL;	//Transaction on the bus
+static i2c_state state;
+static uint16_t idx;					//Data bytes handled in current transaction
+static uint8_t retries;					//Retries done on current transaction
+static uint32_t start_us;				//Start of the current attempt
+static uint32_t budget_us;				//Time allowed for the current attempt
+static i2c_status failed;				//Error of the attempt being recovered from
+
+static i2c_rec_phase rec_phase = I2C_REC_IDLE;
+static uint8_t rec_clocks;				//Clock pulses sent by the bus clear
+static uint32_t rec_us;					//Time of the last bus clear edge
+
+static uint32_t speed_hz = I2C_SPEED_DEFAULT;	//Last requested SCL rate
+static uint32_t tput_bytes;				//Byte count at the last throughput call
+static uint32_t tput_us;				//Time of the last throughput call
+
+//SCL divider for each ICR value (KL25 reference manual, I2C divider table)
+static const uint16_t scl_div[64] = {
+	20, 22, 24, 26, 28, 30, 34, 40, 28, 32, 36, 40, 44, 48, 56, 68,
+	48, 56, 64, 72, 80, 88, 104, 128, 80, 96, 112, 128, 144, 160, 192, 240,
+	160, 192, 224, 256, 288, 320, 384, 480, 320, 384, 448, 512, 576, 640, 768, 960,
+	640, 768, 896, 1024, 1152, 1280, 1536, 1920, 1280, 1536, 1792, 2048, 2304, 2560, 3072, 3840
+};
+
+static void I2C_check_timeout(void);
+static void I2C_clock_hook(void);
+static void I2C_engine_address(void);
+static void I2C_engine_retry(i2c_status status);
+static i2c_engine_stats engine_stats;
 
 /**
  * @function I2C_init
@@ -34,189 +98,714 @@ void I2C_init(void){
 	SIM->SCGC4 |= SIM_SCGC4_I2C0_MASK;
 	SIM->SCGC5 |= SIM_SCGC5_PORTE_MASK;
 
-	//Set pins to I2C functionality
-	PORTE->PCR[24] |= PORT_PCR_MUX(5);	//Setting I2C0_SCL pin configuration
-	PORTE->PCR[25] |= PORT_PCR_MUX(5);	//Setting I2C0_SDA pin configuration
-
-	I2C0->F = (I2C_F_MULT(0) | I2C_F_ICR(0X10));
+	I2C_set_speed(speed_hz);
 
-	//Enable I2C and set it to master mode
-	I2C0->C1 |= I2C_C1_IICEN_MASK;
+	//Free the bus in case a slave was left mid byte by a reset, this also
+	//sets the pins to I2C functionality and enables I2C0
+	I2C_recover();
+	engine_stats.recoveries = 0;
 
 	//Select high drive mode
 	I2C0->C2 |= I2C_C2_HDRS_MASK;
+
+	dma_init();
+
+	//Engine interrupt, I2C0 IICIE is only set while a transaction runs
+	NVIC_SetPriority(I2C0_IRQn, I2C_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(I2C0_IRQn);
+	NVIC_EnableIRQ(I2C0_IRQn);
+
+	timer_add_hook(I2C_check_timeout);
+	timer_add_clock_hook(I2C_clock_hook);		//Divider follows timer_clock_changed()
 }
 
-/*
- * @function I2C_busy
- * @brief  	 This function checks the I2C line be busy or not
+/**
+ * @function I2C_set_speed
+ * @brief  	 Program the I2C0 F register for the fastest SCL rate not above
+ * 			 the requested one, using the bus clock currently configured.
+ * 			 Waits for the engine to be idle before changing the rate.
+ * @param    hz		requested SCL rate (I2C_SPEED_xxx)
+ * @return   achieved SCL rate in Hz
+ */
+uint32_t I2C_set_speed(uint32_t hz){
+	uint32_t bus = CLOCK_GetBusClkFreq();
+	uint32_t best_rate = 0, rate;
+	uint8_t best_f = I2C_F_MULT(2) | I2C_F_ICR(0x3F);	//Slowest setting
+
+	speed_hz = hz;
+	for(uint8_t mult = 0; mult < 3; mult++){
+		for(uint8_t icr = 0; icr < 64; icr++){
+			rate = bus / ((1U << mult) * scl_div[icr]);
+			if((rate <= hz) && (rate > best_rate)){
+				best_rate = rate;
+				best_f = I2C_F_MULT(mult) | I2C_F_ICR(icr);
+			}
+		}
+	}
+	if(best_rate == 0){
+		best_rate = bus / (4 * scl_div[0x3F]);
+	}
+
+	while(!I2C_engine_idle()){
+		__asm volatile ("nop");
+	}
+	I2C0->F = best_f;
+	return best_rate;
+}
+
+/**
+ * @function I2C_clock_changed
+ * @brief  	 Re-apply the last requested SCL rate. Run by
+ * 			 timer_clock_changed() after switching clock configuration
+ * 			 (e.g. BOARD_BootClockVLPR).
+ * @param    none
+ * @return   achieved SCL rate in Hz
+ */
+uint32_t I2C_clock_changed(void){
+	return I2C_set_speed(speed_hz);
+}
+
+/**
+ * @function I2C_clock_hook
+ * @brief  	 Clock hook registered with timer_add_clock_hook()
  * @param    none
  * @return   none
  */
-void I2C_busy(void){
-	lock_detect = 0;
-	I2C0->C1 &= ~I2C_C1_IICEN_MASK;
-	I2C0->C1 |= I2C_C1_TX_MASK;		//Set to transmit mode
-	I2C0->C1 |= I2C_C1_MST_MASK;
-	I2C0->C1 |= I2C_C1_IICEN_MASK;
+static void I2C_clock_hook(void){
+	I2C_clock_changed();
+}
+
+/**
+ * @function I2C_get_throughput
+ * @brief  	 Bytes moved on the bus per second since the previous call
+ * @param    none
+ * @return   bytes per second
+ */
+uint32_t I2C_get_throughput(void){
+	uint32_t bytes = engine_stats.bytes;
+	uint32_t t = now_us();
+	uint32_t elapsed = t - tput_us;
+	uint32_t result = 0;
+
+	if(elapsed > 0){
+		result = (uint32_t)(((uint64_t)(bytes - tput_bytes) * 1000000U) / elapsed);
+	}
+	tput_bytes = bytes;
+	tput_us = t;
+	return result;
+}
+
+/**
+ * @function I2C_recover_begin
+ * @brief  	 Start the bus clear sequence, run by I2C_recover_step()
+ * @param    none
+ * @return   none
+ */
+static void I2C_recover_begin(void){
+	engine_stats.recoveries++;
+	rec_phase = I2C_REC_RELEASE;
+}
+
+/**
+ * @function I2C_recover_step
+ * @brief  	 Advance the bus clear sequence by one line edge once half an
+ * 			 SCL period has passed since the previous one. Only a few
+ * 			 register writes, so it can run from the SysTick hook.
+ * @param    none
+ * @return   1 when the sequence is over and I2C0 is enabled again
+ */
+static int I2C_recover_step(void){
+	uint32_t t = now_us();
+
+	if(rec_phase == I2C_REC_IDLE){
+		return 1;
+	}
+	if((rec_phase != I2C_REC_RELEASE) && ((t - rec_us) < I2C_RECOVER_HALF_US)){
+		return 0;
+	}
+	rec_us = t;
+
+	switch(rec_phase){
+	case I2C_REC_RELEASE:
+		I2C0->C1 = 0;								//Disable I2C0, releases the pins
+
+		//Open drain emulation: output latch low, line driven by direction
+		GPIOE->PCOR = SCL_MASK | SDA_MASK;
+		GPIOE->PDDR &= ~(SCL_MASK | SDA_MASK);		//Both released (pulled up)
+		PORTE->PCR[I2C_SCL_PIN] = PORT_PCR_MUX(1);
+		PORTE->PCR[I2C_SDA_PIN] = PORT_PCR_MUX(1);
+		rec_clocks = 0;
+		rec_phase = I2C_REC_SCL_LOW;
+		break;
+
+	case I2C_REC_SCL_LOW:
+		GPIOE->PDDR |= SCL_MASK;					//SCL low
+		//Clock until the slave has shifted out its byte and released SDA,
+		//else SCL low is the first edge of the STOP
+		if((rec_clocks < 9) && !(GPIOE->PDIR & SDA_MASK)){
+			rec_phase = I2C_REC_SCL_HIGH;
+		}
+		else{
+			rec_phase = I2C_REC_STOP_SDA_LOW;
+		}
+		break;
+
+	case I2C_REC_SCL_HIGH:
+		GPIOE->PDDR &= ~SCL_MASK;					//SCL high
+		rec_clocks++;
+		rec_phase = I2C_REC_SCL_LOW;
+		break;
+
+	case I2C_REC_STOP_SDA_LOW:
+		GPIOE->PDDR |= SDA_MASK;
+		rec_phase = I2C_REC_STOP_SCL_HIGH;
+		break;
+
+	case I2C_REC_STOP_SCL_HIGH:
+		GPIOE->PDDR &= ~SCL_MASK;
+		rec_phase = I2C_REC_STOP_SDA_HIGH;
+		break;
+
+	case I2C_REC_STOP_SDA_HIGH:
+		GPIOE->PDDR &= ~SDA_MASK;
+		rec_phase = I2C_REC_ENABLE;
+		break;
+
+	default:
+		//Set pins back to I2C functionality
+		PORTE->PCR[I2C_SCL_PIN] = PORT_PCR_MUX(5);	//Setting I2C0_SCL pin configuration
+		PORTE->PCR[I2C_SDA_PIN] = PORT_PCR_MUX(5);	//Setting I2C0_SDA pin configuration
+
+		I2C0->S = I2C_S_ARBL_MASK | I2C_S_IICIF_MASK;
+		I2C0->C1 = I2C_C1_IICEN_MASK;				//Enable I2C
+		rec_phase = I2C_REC_IDLE;
+		return 1;
+	}
+	return 0;
+}
 
-	//Clear I2C line
-	I2C0->C1 |= I2C_C1_MST_MASK;	//Set Master mode
-	I2C0->C1 |= I2C_C1_TX_MASK;		//Set Transmitter mode
-	I2C0->D = 0xFF;
-	while((I2C0->S & I2C_S_IICIF_MASK) == 0U){
-	}								//I2c wait interrupt
-	I2C0->S |= I2C_S_IICIF_MASK;	//I2C clear interrupt
+/**
+ * @function I2C_recover
+ * @brief  	 Release a bus held by a slave: SCL and SDA are taken as GPIO,
+ * 			 up to 9 clocks are sent until the slave frees SDA, then a
+ * 			 STOP is generated and the I2C0 module is re-enabled.
+ * 			 Busy waits for the whole sequence, for use while the engine
+ * 			 is idle (I2C_init). The engine runs the same sequence one
+ * 			 edge at a time from I2C_check_timeout.
+ * @param    none
+ * @return   none
+ */
+void I2C_recover(void){
+	I2C_recover_begin();
+	while(!I2C_recover_step()){
+		__asm volatile ("nop");
+	}
+}
+
+/**
+ * @function I2C_read_byte
+ * @brief  	 configuration of the register to read the data in I2C
+ * @param    1. dev		Device address to read data
+ * 			 2. address	Address of the register to read data
+ *
+ * @return   data read from register
+ */
+uint8_t I2C_read_byte(uint8_t dev, uint8_t address){
+	uint8_t data = 0;
+
+	I2C_read_block(dev, address, &data, 1);
+	return data;					//return the data to be read from the registers
+}
+
+/**
+ * @function I2C_write_byte
+ * @brief  	 configuration I2C to write byte
+ * @param   1. dev		Device address whre data is written
+ * 			 2. address	Address of the register whre data is written
+ *
+ * 			 3. data		Data to be written
+ * @return   none
+ */
+void I2C_write_byte(uint8_t dev, uint8_t address, uint8_t data){
+	I2C_write_block(dev, address, &data, 1);
+}
 
-	I2C0->S |= I2C_S_ARBL_MASK;		//Clear arbitration
+/**
+ * @function I2C_transfer
+ * @brief  	 Queue a transaction and wait until the engine has run it.
+ * 			 Must not be called from interrupt context.
+ * @param    xfer	transaction descriptor
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_transfer(i2c_xfer_t *xfer){
+	xfer->callback = NULL;
+	while(!I2C_submit(xfer)){
+		__asm volatile ("nop");		//Queue full, wait for the engine
+	}
+	while((xfer->status == I2C_STATUS_QUEUED) || (xfer->status == I2C_STATUS_BUSY)){
+		I2C_check_timeout();
+	}
+	return (xfer->status == I2C_STATUS_DONE);
+}
 
-	I2C0->C1 &= ~I2C_C1_IICEN_MASK;	//Send start
-//	I2C0->C1 |= I2C_C1_TX_MASK;		//set transmitter mode
-	I2C0->C1 |= I2C_C1_MST_MASK;	//Start Sending signal
+/**
+ * @function I2C_read_block
+ * @brief  	 Read consecutive registers in one transaction and wait
+ * 			 for the result.
+ * @param    1. dev		Device address to read data
+ * 			 2. reg		Address of the first register
+ * 			 3. buf		Storage for the data
+ * 			 4. len		Number of registers to read
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_read_block(uint8_t dev, uint8_t reg, uint8_t *buf, uint16_t len){
+	i2c_xfer_t xfer;
+
+	xfer.dev = dev;
+	xfer.reg = reg;
+	xfer.dir = I2C_XFER_READ;
+	xfer.buf = buf;
+	xfer.len = len;
+	xfer.flags = 0;
+	return I2C_transfer(&xfer);
+}
 
-	I2C0->C1 |= I2C_C1_IICEN_MASK;
+/**
+ * @function I2C_write_block
+ * @brief  	 Write consecutive registers in one transaction and wait
+ * 			 for the result.
+ * @param    1. dev		Device address where data is written
+ * 			 2. reg		Address of the first register
+ * 			 3. buf		Data to be written
+ * 			 4. len		Number of registers to write
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_write_block(uint8_t dev, uint8_t reg, const uint8_t *buf, uint16_t len){
+	i2c_xfer_t xfer;
+
+	xfer.dev = dev;
+	xfer.reg = reg;
+	xfer.dir = I2C_XFER_WRITE;
+	xfer.buf = (uint8_t *)buf;		//Only read by the engine in write mode
+	xfer.len = len;
+	xfer.flags = 0;
+	return I2C_transfer(&xfer);
+}
 
-	I2C0->C1 &= ~I2C_C1_IICEN_MASK;
-	I2C0->C1 |= I2C_C1_MST_MASK;
-	I2C0->C1 &= ~I2C_C1_MST_MASK;	//Set to slave mode
-	I2C0->C1 &= ~I2C_C1_TX_MASK;	//Set Receiver mode
-	I2C0->C1 |= I2C_C1_IICEN_MASK;
+/**
+ * @function I2C_write_batch
+ * @brief  	 Write a list of (not necessarily consecutive) registers.
+ * 			 The writes are chained with repeated STARTs and a single
+ * 			 STOP at the end, then the function waits for the result.
+ * @param    1. dev		Device address where data is written
+ * 			 2. writes	register/value pairs, written in order
+ * 			 3. count	number of pairs
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_write_batch(uint8_t dev, const i2c_reg_write *writes, uint16_t count){
+	i2c_xfer_t xfer;
 
-	I2C0->S |= I2C_S_IICIF_MASK;
-	I2C0->S |= I2C_S_ARBL_MASK;		//Clear arbitration
-	i2c_lock = 1;
+	if(count == 0){
+		return 1;
+	}
+	xfer.dev = dev;
+	xfer.reg = writes[0].reg;
+	xfer.dir = I2C_XFER_WRITE_BATCH;
+	xfer.buf = (uint8_t *)writes;	//Pairs of reg, val bytes
+	xfer.len = count;
+	xfer.flags = 0;
+	return I2C_transfer(&xfer);
 }
 
 /**
- * @function I2C_wait
- * @brief  	 This function waits till I2C is cleared
+ * @function I2C_engine_begin
+ * @brief  	 Send START and device address of the current transaction,
+ * 			 from its first byte.
  * @param    none
  * @return   none
  */
-void I2C_wait(void){
-	lock_detect = 0;
-	while(((I2C0->S & I2C_S_IICIF_MASK) == 0) & (lock_detect < 200)){
-		lock_detect++;
+static void I2C_engine_begin(void){
+	uint32_t bytes;
+
+	idx = 0;
+
+	//Bytes on the bus, used to bound the time of the attempt
+	if(cur->dir == I2C_XFER_WRITE_BATCH){
+		bytes = 3 * cur->len;
 	}
-	if(lock_detect >= 200){
-		I2C_busy();
+	else{
+		bytes = cur->len + 3;
 	}
-	I2C0->S |= I2C_S_IICIF_MASK;
+	budget_us = bytes * I2C_BYTE_TIMEOUT_US;
+	start_us = now_us();
+
+	//Let the STOP of the previous transaction finish on the bus: the
+	//stop detect interrupt sends the START once it is seen
+	if(I2C0->S & I2C_S_BUSY_MASK){
+		state = I2C_STATE_WAIT_BUS;
+		I2C0->FLT = I2C_FLT_STOPF_MASK | I2C_FLT_STOPIE_MASK;
+		I2C0->C1 |= I2C_C1_IICIE_MASK;
+		if(I2C0->S & I2C_S_BUSY_MASK){
+			return;
+		}
+		I2C0->FLT = I2C_FLT_STOPF_MASK;		//Freed meanwhile, no stop interrupt
+	}
+	I2C_engine_address();
 }
 
 /**
- * @function I2C_start
- * @brief  	 Begin I2C
+ * @function I2C_engine_address
+ * @brief  	 Send START and device address on a free bus
  * @param    none
  * @return   none
  */
-void I2C_start(void){
-	I2C0->C1 |= I2C_C1_TX_MASK;
-	I2C0->C1 |= I2C_C1_MST_MASK;
+static void I2C_engine_address(void){
+	state = I2C_STATE_ADDR;
+	I2C0->C1 |= I2C_C1_IICIE_MASK;
+	I2C0->C1 |= I2C_C1_TX_MASK;		//Set to transmit mode
+	I2C0->C1 |= I2C_C1_MST_MASK;	//Send start
+	I2C0->D = cur->dev;				//Send device address
+	engine_stats.bytes++;
 }
 
 /**
- * @function I2C_read_setup
- * @brief  	 Configure the registers to read value register address and device address.
- *
- * @param    1. dev		Device address to read data
- * 			 2. Address	Address of the register to read data
- *
+ * @function I2C_engine_start
+ * @brief  	 Take the oldest queued transaction and start it. Called
+ * 			 with the I2C0 interrupt masked or from the I2C0 interrupt.
+ * @param    none
  * @return   none
  */
-void I2C_read_setup(uint8_t dev, uint8_t address){
-	I2C0->D = dev;					//Send device address
-	I2C_wait();						// Wait till the line is cleared
-	I2C0->D = address;				//Send read address
-	I2C_wait();						// Wait till the I2C line is cleared
-	I2C0->C1 |= I2C_C1_RSTA_MASK;	//Restart
-	I2C0->D = (dev|0x1);			//Send device address for the value to be read
-	I2C_wait();						// Wait till the I2C line is cleared
-	I2C0->C1 &= ~I2C_C1_TX_MASK;	//Set to receive mode
+static void I2C_engine_start(void){
+	cur = queue[q_tail];
+	q_tail = (q_tail + 1) & (I2C_QUEUE_LEN - 1);
+	cur->status = I2C_STATUS_BUSY;
+	retries = 0;
+	I2C_engine_begin();
 }
 
 /**
- * @function I2C_repeated_read
- * @brief  	 configure the I2C to configure the repeated read registers
- * @param    i2c_flag	indicating flag fot the function
- * @return   data to be read from register
+ * @function I2C_engine_finish
+ * @brief  	 Send STOP, start the next queued transaction if any and
+ * 			 report the result of the current one. The callback runs
+ * 			 last so it can submit (or resubmit its own descriptor).
+ * @param    status	result of the transaction
+ * @return   none
  */
-uint8_t I2C_repeated_read(uint8_t i2c_flag){
-	uint8_t data;
-	lock_detect = 0;
+static void I2C_engine_finish(i2c_status status){
+	i2c_xfer_t *done = cur;
+
+	I2C0->C1 &= ~I2C_C1_MST_MASK;	//Send stop
+	I2C0->C1 &= ~(I2C_C1_TX_MASK | I2C_C1_TXAK_MASK | I2C_C1_DMAEN_MASK);
+	cur = NULL;
 
-	if(i2c_flag){
-		I2C0->C1 |= I2C_C1_TXAK_MASK;
+	engine_stats.xfers++;
+	if(status != I2C_STATUS_DONE){
+		engine_stats.errors++;
+	}
+
+	//Engine state is final before the callback: a submit from it either
+	//queues behind the next transaction or starts an idle engine
+	if(q_tail != q_head){
+		I2C_engine_start();
 	}
 	else{
-		I2C0->C1 &= ~I2C_C1_TXAK_MASK;
+		I2C0->C1 &= ~I2C_C1_IICIE_MASK;
 	}
 
-	data = I2C0->D;					//Backup read data locally
-	I2C_wait();						// Wait till the I2C line is cleared
+	done->status = status;
+	if(done->callback){
+		done->callback(done);
+	}
+}
 
-	if(i2c_flag){
-		I2C0->C1 &= ~I2C_C1_MST_MASK;
+/**
+ * @function I2C_engine_error
+ * @brief  	 Count the error, clear the bus if needed and restart the
+ * 			 current transaction, or fail it once out of retries.
+ * @param    status	error seen on the bus
+ * @return   none
+ */
+static void I2C_engine_error(i2c_status status){
+	dma_stop();
+	I2C0->C1 &= ~I2C_C1_MST_MASK;	//Send stop
+	I2C0->C1 &= ~(I2C_C1_TX_MASK | I2C_C1_TXAK_MASK | I2C_C1_DMAEN_MASK);
+	I2C0->FLT = I2C_FLT_STOPF_MASK;	//Stop detect interrupt off
+
+	switch(status){
+	case I2C_STATUS_NAK:
+		engine_stats.naks++;
+		break;
+	case I2C_STATUS_ARB_LOST:
+		engine_stats.arb_lost++;
+		break;
+	default:
+		engine_stats.timeouts++;
+		break;
 	}
-	data = I2C0->D;					//Read data from the address
 
-	return data;				// return the data to be read from the registers
+	//A NAK leaves the bus free, anything else may be a slave holding SDA:
+	//clear the bus first, I2C_check_timeout retries once it is done
+	if(status != I2C_STATUS_NAK){
+		failed = status;
+		state = I2C_STATE_RECOVER;
+		I2C0->C1 &= ~I2C_C1_IICIE_MASK;
+		I2C_recover_begin();
+		return;
+	}
+	I2C_engine_retry(status);
 }
 
 /**
- * @function I2C_read_byte
- * @brief  	 configuration of the register to read the data in I2C
- * @param    1. dev		Device address to read data
- * 			 2. address	Address of the register to read data
- *
- * @return   data read from register
+ * @function I2C_engine_retry
+ * @brief  	 Restart the current transaction, or fail it once out of
+ * 			 retries.
+ * @param    status	error of the failed attempt
+ * @return   none
  */
-uint8_t I2C_read_byte(uint8_t dev, uint8_t address){
-	uint8_t data;
+static void I2C_engine_retry(i2c_status status){
+	if(retries < I2C_MAX_RETRIES){
+		retries++;
+		engine_stats.retries++;
+		I2C_engine_begin();
+	}
+	else{
+		I2C_engine_finish(status);
+	}
+}
 
-	I2C0->C1 |= I2C_C1_TX_MASK;		//Set to transmit mode
-	I2C0->C1 &= ~I2C_C1_IICEN_MASK;	//Send start
-	I2C0->D = dev;					//Send device address
-	I2C_wait();						//// Wait till the I2C line is cleared
+/**
+ * @function I2C_check_timeout
+ * @brief  	 Fail the current attempt if it ran longer than its budget
+ * 			 and step the bus clear of a failed attempt, retrying once
+ * 			 it is over. Called from the SysTick hook and from blocking
+ * 			 waits, each call only takes a few register accesses.
+ * @param    none
+ * @return   none
+ */
+static void I2C_check_timeout(void){
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	if(cur != NULL){
+		if(state == I2C_STATE_RECOVER){
+			if(I2C_recover_step()){
+				I2C_engine_retry(failed);
+			}
+		}
+		else if((now_us() - start_us) > budget_us){
+			I2C_engine_error(I2C_STATUS_TIMEOUT);
+		}
+	}
+	__set_PRIMASK(primask);
+}
 
-	I2C0->D = address;				//Send read address
-	I2C_wait();						//// Wait till the I2C line is cleared
+/**
+ * @function I2C_dma_done
+ * @brief  	 DMA0 has moved all but the last two bytes of a read. Hand
+ * 			 the transaction back to the I2C0 interrupt which NACKs and
+ * 			 stops the last two bytes.
+ * @param    none
+ * @return   none
+ */
+static void I2C_dma_done(void){
+	I2C0->C1 &= ~I2C_C1_DMAEN_MASK;
+	idx = cur->len - 2;
+	engine_stats.bytes += idx;
+
+	I2C0->S = I2C_S_IICIF_MASK;
+	I2C0->C1 |= I2C_C1_IICIE_MASK;
+	if(I2C0->S & I2C_S_TCF_MASK){
+		NVIC_SetPendingIRQ(I2C0_IRQn);	//Next byte already received
+	}
+}
 
-	I2C0->C1 |= I2C_C1_RSTA_MASK;	//Repeated start
-	I2C0->D = (dev|0x1);			//Send development address - read
-	I2C_wait();						//// Wait till the I2C line is cleared
+/**
+ * @function I2C_submit
+ * @brief  	 Queue a transaction for the interrupt driven engine. The
+ * 			 function returns immediately, the START, address, repeated
+ * 			 START, data and STOP phases are run from the I2C0 interrupt.
+ * 			 The blocking functions above must not be used while the
+ * 			 engine is busy.
+ * @param    xfer	transaction descriptor
+ * @return   1 if queued, 0 if the queue is full or the descriptor is invalid
+ * 			 (read or batch of no data, data without buffer)
+ */
+int I2C_submit(i2c_xfer_t *xfer){
+	uint32_t primask;
+	uint8_t next;
 
-	I2C0->C1 &= ~I2C_C1_TX_MASK;	//Set to receive mode
-	I2C0->C1 |= I2C_C1_TXAK_MASK;	//Set NACK after read
+	if(xfer == NULL){
+		return 0;
+	}
+	//Reads and batches always have a data phase, a write of no data only
+	//sets the register pointer
+	if(((xfer->len == 0) && (xfer->dir != I2C_XFER_WRITE)) || ((xfer->len != 0) && (xfer->buf == NULL))){
+		return 0;
+	}
 
-	data = I2C0->D;					//Read backup
-	I2C_wait();						//// Wait till the I2C line is cleared
+	primask = __get_PRIMASK();
+	__disable_irq();
+	next = (q_head + 1) & (I2C_QUEUE_LEN - 1);
+	if(next == q_tail){
+		__set_PRIMASK(primask);
+		return 0;						//Queue full
+	}
+	xfer->status = I2C_STATUS_QUEUED;
+	queue[q_head] = xfer;
+	q_head = next;
+	if(cur == NULL){
+		I2C_engine_start();				//Bus idle, kick the engine
+	}
+	__set_PRIMASK(primask);
+	return 1;
+}
 
-	I2C0->C1 &= ~I2C_C1_MST_MASK;	//Send stop
-	data = I2C0->D;					//Read data
+/**
+ * @function I2C_engine_idle
+ * @brief  	 Checks if the engine has no transaction in progress or queued
+ * @param    none
+ * @return   1 if idle, 0 otherwise
+ */
+int I2C_engine_idle(void){
+	return (cur == NULL) && (q_tail == q_head);
+}
+
+/**
+ * @function I2C_engine_get_stats
+ * @brief  	 Copy the engine counters
+ * @param    stats	destination of the counters
+ * @return   none
+ */
+void I2C_engine_get_stats(i2c_engine_stats *stats){
+	uint32_t primask = __get_PRIMASK();
 
-	return data;					//// return the data to be read from the registers
+	__disable_irq();
+	*stats = engine_stats;
+	__set_PRIMASK(primask);
 }
 
 /**
- * @function I2C_write_byte
- * @brief  	 configuration I2C to write byte
- * @param   1. dev		Device address whre data is written
- * 			 2. address	Address of the register whre data is written
- *
- * 			 3. data		Data to be written
+ * @function I2C0_IRQHandler
+ * @brief  	 Advances the engine state machine, one step per byte
+ * 			 transferred on the bus.
+ * @param    none
  * @return   none
  */
-void I2C_write_byte(uint8_t dev, uint8_t address, uint8_t data){
-	I2C0->C1 |= I2C_C1_TX_MASK;		//Set to transmit mode
-	I2C0->C1 |= I2C_C1_MST_MASK;	//Send start
-	I2C0->D = dev;					//Send device address
-	I2C_wait();						//// Wait till the I2C line is cleared
+void I2C0_IRQHandler(void){
+	uint8_t status = I2C0->S;
+
+	I2C0->S = I2C_S_IICIF_MASK;		//Clear interrupt flag
+	engine_stats.irqs++;
+	if((cur == NULL) || (state == I2C_STATE_RECOVER)){
+		return;
+	}
+
+	if(state == I2C_STATE_WAIT_BUS){
+		if(I2C0->S & I2C_S_BUSY_MASK){
+			return;
+		}
+		I2C0->FLT = I2C_FLT_STOPF_MASK;	//Clear stop detect, interrupt off
+		I2C_engine_address();
+		return;
+	}
 
-	I2C0->D = address;				//Send write address
-	I2C_wait();						//// Wait till the I2C line is cleared
+	if(status & I2C_S_ARBL_MASK){
+		I2C0->S = I2C_S_ARBL_MASK;	//Clear arbitration
+		I2C_engine_error(I2C_STATUS_ARB_LOST);
+		return;
+	}
 
-	I2C0->D = data;					//Send data
-	I2C_wait();						//// Wait till the I2C line is cleared
-	I2C0->C1 &= ~I2C_C1_MST_MASK;	//Send stop bit
+	//Every transmitted byte must be acknowledged by the slave
+	if((state != I2C_STATE_RX_DATA) && (status & I2C_S_RXAK_MASK)){
+		I2C_engine_error(I2C_STATUS_NAK);
+		return;
+	}
+
+	switch(state){
+	case I2C_STATE_ADDR:
+		if(cur->dir == I2C_XFER_WRITE_BATCH){
+			I2C0->D = cur->buf[2*idx];	//Send register of the current pair
+		}
+		else{
+			I2C0->D = cur->reg;			//Send register address
+		}
+		engine_stats.bytes++;
+		state = I2C_STATE_REG;
+		break;
+
+	case I2C_STATE_REG:
+		if(cur->dir == I2C_XFER_READ){
+			I2C0->C1 |= I2C_C1_RSTA_MASK;	//Repeated start
+			I2C0->D = (cur->dev | 0x1);		//Send device address - read
+			engine_stats.bytes++;
+			state = I2C_STATE_ADDR_READ;
+			break;
+		}
+		if(cur->dir == I2C_XFER_WRITE_BATCH){
+			I2C0->D = cur->buf[2*idx + 1];	//Send value of the current pair
+			engine_stats.bytes++;
+			idx++;
+			state = I2C_STATE_TX_DATA;
+			break;
+		}
+		state = I2C_STATE_TX_DATA;
+		/* fall through */
+
+	case I2C_STATE_TX_DATA:
+		if(cur->dir == I2C_XFER_WRITE_BATCH){
+			if(idx < cur->len){
+				I2C0->C1 |= I2C_C1_RSTA_MASK;	//Repeated start for next pair
+				I2C0->D = cur->dev;
+				engine_stats.bytes++;
+				state = I2C_STATE_ADDR;
+			}
+			else{
+				I2C_engine_finish(I2C_STATUS_DONE);
+			}
+		}
+		else if(idx < cur->len){
+			I2C0->D = cur->buf[idx++];		//Send data
+			engine_stats.bytes++;
+		}
+		else{
+			I2C_engine_finish(I2C_STATUS_DONE);
+		}
+		break;
+
+	case I2C_STATE_ADDR_READ:
+		I2C0->C1 &= ~I2C_C1_TX_MASK;	//Set to receive mode
+		if(cur->len == 1){
+			I2C0->C1 |= I2C_C1_TXAK_MASK;	//NACK the only byte
+		}
+		else{
+			I2C0->C1 &= ~I2C_C1_TXAK_MASK;
+		}
+		state = I2C_STATE_RX_DATA;
+		if((cur->flags & I2C_XFER_DMA) && (cur->len > 2)){
+			//DMA reads the data register on each received byte
+			I2C0->C1 &= ~I2C_C1_IICIE_MASK;
+			dma_start_rx(DMAMUX_SRC_I2C0, &I2C0->D, cur->buf, cur->len - 2, I2C_dma_done);
+			I2C0->C1 |= I2C_C1_DMAEN_MASK;
+		}
+		(void)I2C0->D;					//Dummy read starts the reception
+		break;
+
+	case I2C_STATE_RX_DATA:
+		engine_stats.bytes++;
+		if(idx == (cur->len - 1)){
+			I2C0->C1 &= ~I2C_C1_MST_MASK;	//Stop before reading the last byte
+			cur->buf[idx++] = I2C0->D;
+			I2C_engine_finish(I2C_STATUS_DONE);
+		}
+		else{
+			if(idx == (cur->len - 2)){
+				I2C0->C1 |= I2C_C1_TXAK_MASK;	//NACK the last byte
+			}
+			cur->buf[idx++] = I2C0->D;		//Read data, starts next reception
+		}
+		break;
+
+	default:
+		break;
+	}
 }
@@ -1,12 +1,17 @@
 /**@file: i2c .h
  * @brief: This file contains all the function related to  i2c
  *			i2c_init this file contains all the configuration of registers
- *			i2c_busy checks if the i2c line is busy or not
- *			i2c_wait i2c wait till the line is cleared or not
- *			i2c_start starts the I2c Transfer and receive register
  *			i2c_read reads the value from specific address
- *			i2c_repeated_read reads value from specific address
  *			i2c_write write the data to specific device and memory location
+ *			i2c_read_block / i2c_write_block access consecutive registers
+ *			i2c_write_batch writes a list of registers with a single STOP
+ *			i2c_submit queues a transaction for the interrupt driven engine
+ *			i2c_engine_idle reports if the engine has finished all transactions
+ *			reads flagged I2C_XFER_DMA are moved to RAM by DMA0 channel 0
+ *			failed transactions are retried after clocking a stuck slave off the bus
+ *			i2c_engine_get_stats returns transfer and error counters
+ *			i2c_set_speed computes the baud rate divider from the bus clock
+ *			i2c_get_throughput reports the measured bytes per second
  * @author: Swapnil Ghonge
  * @date: 	May 2nd 2022
  * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
@@ -22,7 +27,82 @@
 #define I2C_H_
 
 #include <stdint.h>
+#include <stddef.h>
 #include "MKL25Z4.h"
+
+#define I2C_QUEUE_LEN	8			//Max transactions waiting for the engine (power of 2)
+#define I2C_IRQ_PRIORITY	2
+
+#define I2C_BYTE_TIMEOUT_US	500			//Time allowed per byte on the bus
+#define I2C_MAX_RETRIES		3			//Attempts after the first failure
+#define I2C_RECOVER_HALF_US	5			//Half SCL period of the bus clear (100 kHz)
+
+//Bus speed profiles
+#define I2C_SPEED_STANDARD	100000
+#define I2C_SPEED_FAST		400000
+#define I2C_SPEED_FAST_PLUS	1000000
+#define I2C_SPEED_DEFAULT	I2C_SPEED_FAST
+
+#define I2C_SCL_PIN			24			//PTE24
+#define I2C_SDA_PIN			25			//PTE25
+
+//Transaction flags
+#define I2C_XFER_DMA	0x01		//Move the read data with DMA0 instead of per byte interrupts
+
+//Direction of the data phase of a transaction
+typedef enum{
+	I2C_XFER_READ,
+	I2C_XFER_WRITE,
+	I2C_XFER_WRITE_BATCH			//buf holds len i2c_reg_write pairs
+}i2c_dir;
+
+//One register write of a batch
+typedef struct{
+	uint8_t reg;
+	uint8_t val;
+}i2c_reg_write;
+
+//Life cycle of a transaction handed to the engine
+typedef enum{
+	I2C_STATUS_IDLE,
+	I2C_STATUS_QUEUED,
+	I2C_STATUS_BUSY,
+	I2C_STATUS_DONE,
+	I2C_STATUS_NAK,
+	I2C_STATUS_ARB_LOST,
+	I2C_STATUS_TIMEOUT
+}i2c_status;
+
+typedef struct i2c_xfer i2c_xfer_t;
+
+//Called from the I2C0 interrupt once the transaction has ended
+typedef void (*i2c_callback)(i2c_xfer_t *xfer);
+
+//Transaction descriptor, must stay valid until the callback is called
+struct i2c_xfer{
+	uint8_t dev;					//Device address (write form)
+	uint8_t reg;					//First register to access
+	i2c_dir dir;					//Read or write data phase
+	uint8_t *buf;					//Data to send or storage for received data
+	uint16_t len;					//Number of data bytes
+	uint8_t flags;					//I2C_XFER_xxx flags
+	i2c_callback callback;			//Completion callback (can be NULL)
+	volatile i2c_status status;		//Updated by the engine
+};
+
+//Counters maintained by the engine
+typedef struct{
+	uint32_t irqs;					//I2C0 interrupts serviced
+	uint32_t bytes;					//Bytes moved on the bus (address bytes included)
+	uint32_t xfers;					//Transactions completed
+	uint32_t errors;				//Transactions failed after all retries
+	uint32_t timeouts;				//Transactions that did not finish in time
+	uint32_t arb_lost;				//Arbitration losses
+	uint32_t naks;					//Bytes not acknowledged by the slave
+	uint32_t retries;				//Transactions restarted after an error
+	uint32_t recoveries;			//Bus clear sequences sent
+}i2c_engine_stats;
+
 /**
  * @function I2C_init
  * @brief  	 Initialize the I2C0 module for KL25Z
@@ -31,49 +111,46 @@
  */
 void I2C_init(void);
 
-/*
- * @function I2C_busy
- * @brief  	 This function checks the I2C line be busy or not
- * @param    none
- * @return   none
+/**
+ * @function I2C_set_speed
+ * @brief  	 Program the I2C0 F register for the fastest SCL rate not above
+ * 			 the requested one, using the bus clock currently configured.
+ * 			 Waits for the engine to be idle before changing the rate.
+ * @param    hz		requested SCL rate (I2C_SPEED_xxx)
+ * @return   achieved SCL rate in Hz
  */
-void I2C_busy(void);
-
+uint32_t I2C_set_speed(uint32_t hz);
 
 /**
- * @function I2C_wait
- * @brief  	 This function waits till I2C is cleared
+ * @function I2C_clock_changed
+ * @brief  	 Re-apply the last requested SCL rate. Run by
+ * 			 timer_clock_changed() after switching clock configuration
+ * 			 (e.g. BOARD_BootClockVLPR).
  * @param    none
- * @return   none
+ * @return   achieved SCL rate in Hz
  */
-void I2C_wait(void);
+uint32_t I2C_clock_changed(void);
 
 /**
- * @function I2C_start
- * @brief  	 Begin I2C
+ * @function I2C_get_throughput
+ * @brief  	 Bytes moved on the bus per second since the previous call
  * @param    none
- * @return   none
+ * @return   bytes per second
  */
-void I2C_start(void);
+uint32_t I2C_get_throughput(void);
 
 /**
- * @function I2C_read_setup
- * @brief  	 Configure the registers to read value register address and device address.
- *
- * @param    1. dev		Device address to read data
- * 			 2. Address	Address of the register to read data
- *
+ * @function I2C_recover
+ * @brief  	 Release a bus held by a slave: SCL and SDA are taken as GPIO,
+ * 			 up to 9 clocks are sent until the slave frees SDA, then a
+ * 			 STOP is generated and the I2C0 module is re-enabled.
+ * 			 Busy waits for the whole sequence, for use while the engine
+ * 			 is idle (I2C_init). The engine runs the same sequence one
+ * 			 edge at a time from I2C_check_timeout.
+ * @param    none
  * @return   none
  */
-void I2C_read_setup(uint8_t dev, uint8_t address);
-
-/**
- * @function I2C_repeated_read
- * @brief  	 configure the I2C to configure the repeated read registers
- * @param    i2c_flag	indicating flag fot the function
- * @return   data to be read from register
- */
-uint8_t I2C_repeated_read(uint8_t flag);
+void I2C_recover(void);
 
 /**
  * @function I2C_read_byte
@@ -96,4 +173,78 @@ uint8_t I2C_read_byte(uint8_t dev, uint8_t address);
  */
 void I2C_write_byte(uint8_t dev, uint8_t address, uint8_t data);
 
+/**
+ * @function I2C_read_block
+ * @brief  	 Read consecutive registers in one transaction and wait
+ * 			 for the result.
+ * @param    1. dev		Device address to read data
+ * 			 2. reg		Address of the first register
+ * 			 3. buf		Storage for the data
+ * 			 4. len		Number of registers to read
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_read_block(uint8_t dev, uint8_t reg, uint8_t *buf, uint16_t len);
+
+/**
+ * @function I2C_write_block
+ * @brief  	 Write consecutive registers in one transaction and wait
+ * 			 for the result.
+ * @param    1. dev		Device address where data is written
+ * 			 2. reg		Address of the first register
+ * 			 3. buf		Data to be written
+ * 			 4. len		Number of registers to write
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_write_block(uint8_t dev, uint8_t reg, const uint8_t *buf, uint16_t len);
+
+/**
+ * @function I2C_write_batch
+ * @brief  	 Write a list of (not necessarily consecutive) registers.
+ * 			 The writes are chained with repeated STARTs and a single
+ * 			 STOP at the end, then the function waits for the result.
+ * @param    1. dev		Device address where data is written
+ * 			 2. writes	register/value pairs, written in order
+ * 			 3. count	number of pairs
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_write_batch(uint8_t dev, const i2c_reg_write *writes, uint16_t count);
+
+/**
+ * @function I2C_transfer
+ * @brief  	 Queue a transaction and wait until the engine has run it.
+ * 			 Must not be called from interrupt context.
+ * @param    xfer	transaction descriptor
+ * @return   1 on success, 0 on bus error
+ */
+int I2C_transfer(i2c_xfer_t *xfer);
+
+/**
+ * @function I2C_submit
+ * @brief  	 Queue a transaction for the interrupt driven engine. The
+ * 			 function returns immediately, the START, address, repeated
+ * 			 START, data and STOP phases are run from the I2C0 interrupt.
+ * 			 The blocking functions above must not be used while the
+ * 			 engine is busy.
+ * @param    xfer	transaction descriptor
+ * @return   1 if queued, 0 if the queue is full or the descriptor is invalid
+ * 			 (read or batch of no data, data without buffer)
+ */
+int I2C_submit(i2c_xfer_t *xfer);
+
+/**
+ * @function I2C_engine_idle
+ * @brief  	 Checks if the engine has no transaction in progress or queued
+ * @param    none
+ * @return   1 if idle, 0 otherwise
+ */
+int I2C_engine_idle(void);
+
+/**
+ * @function I2C_engine_get_stats
+ * @brief  	 Copy the engine counters
+ * @param    stats	destination of the counters
+ * @return   none
+ */
+void I2C_engine_get_stats(i2c_engine_stats *stats);
+
 #endif /* I2C_H_ */
@@ -1,13 +1,18 @@
 /**@file: lcd.c
  * @brief: the function is used to initialize the LCD and read and write the data
  * 			lcd_init configures the registers to initiaze the lcd
- * 			write_nibble write 4 bytes in DDRAM
+ * 			write_nibble write 4 bytes in DDRAM, set / clear masks from a table
  *			lcd_cmd sends the data that writes to memory
  *			lcd_start initializes the cursor on the lcd
  *			clear_lcd clears the LCD by configuring the data registers
  *			Lcd_string writes the string to be displayed on the LCD
  *			lcd_write to write at specific location on LCD
  *			lcd_write int write the integer value on LCD
+ *			lcd_wait_ready polls the busy flag instead of fixed delays
+ *			lcd_fb_*: 2x16 shadow framebuffer, the application draws in
+ *			RAM and lcd_fb_flush sends only the cells that changed
+ *			lcd_engine_*: queue drained from the SysTick interrupt so LCD
+ *			calls return at once
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -23,6 +28,55 @@
 
 #include "lcd.h"
 
+#define LCD_ADDR_UNKNOWN	0xFF
+
+//Port C set / clear masks of each nibble, built from the pin defines
+typedef struct{
+	uint32_t set;
+	uint32_t clr;
+}lcd_nibble_masks;
+
+#define LCD_NIBBLE(n)	{LCD_NIBBLE_SET(n), LCD_DATA_MASK & ~LCD_NIBBLE_SET(n)}
+
+static const lcd_nibble_masks nibble_masks[16] = {
+	LCD_NIBBLE(0), LCD_NIBBLE(1), LCD_NIBBLE(2), LCD_NIBBLE(3),
+	LCD_NIBBLE(4), LCD_NIBBLE(5), LCD_NIBBLE(6), LCD_NIBBLE(7),
+	LCD_NIBBLE(8), LCD_NIBBLE(9), LCD_NIBBLE(10), LCD_NIBBLE(11),
+	LCD_NIBBLE(12), LCD_NIBBLE(13), LCD_NIBBLE(14), LCD_NIBBLE(15)
+};
+
+static char lcd_fb[LCD_ROWS][LCD_COLS];		//Wanted contents
+static char lcd_shown[LCD_ROWS][LCD_COLS];	//Contents of the display
+static uint8_t lcd_addr = LCD_ADDR_UNKNOWN;	//DDRAM address counter
+static uint32_t bus_writes = 0;
+static uint8_t busy_flag_ok = 0;			//Controller answers busy flag reads
+static uint32_t busy_timeouts = 0;
+static uint16_t exec_us = LCD_HOME_US;		//Execution time of the last byte sent
+
+//Background engine, the main loop writes q_head and the SysTick hook q_tail
+#define LCD_QUEUE_MASK	(LCD_QUEUE_LEN - 1)
+#define LCD_Q_RS		0x100				//Queue entry is data, not a command
+
+#if (LCD_QUEUE_LEN > 256) || ((LCD_QUEUE_LEN & LCD_QUEUE_MASK) != 0)
+#error "LCD_QUEUE_LEN must be a power of 2, at most 256"
+#endif
+
+static volatile uint16_t lcd_queue[LCD_QUEUE_LEN];
+static volatile uint8_t q_head = 0;
+static volatile uint8_t q_tail = 0;
+static volatile uint8_t engine_on = 0;
+static uint8_t queue_high_water = 0;
+static uint8_t wait_ticks = 0;
+static uint16_t window_ticks = 0;
+static uint32_t window_bytes = 0;
+static volatile uint32_t engine_bytes = 0;
+static volatile uint32_t engine_bytes_per_s = 0;
+
+static void lcd_shown_reset(void);
+static void lcd_shown_invalidate(void);
+static uint8_t lcd_cmd_try(uint8_t cmd);
+static uint8_t lcd_char_try(uint8_t c);
+
 /**
  * @function lcd_init
  * @brief  	 Initialize the GPIO to interface the 16x2 LCD over it.
@@ -35,17 +89,19 @@ void lcd_init(void){
 	SIM->SCGC5 |= SIM_SCGC5_PORTC(1);
 
 	//Enable and initialize all the GPIO pins
-	PORTC->PCR[10] |= PORT_PCR_MUX(1);			//Configure PTC10
-	PORTC->PCR[7] |= PORT_PCR_MUX(1);			//Configure PTC7
-	PORTC->PCR[6] |= PORT_PCR_MUX(1);			//Configure PTC6
-	PORTC->PCR[5] |= PORT_PCR_MUX(1);			//Configure PTC5
-	PORTC->PCR[4] |= PORT_PCR_MUX(1);			//Configure PTC4
-	PORTC->PCR[3] |= PORT_PCR_MUX(1);			//Configure PTC3
-	PORTC->PCR[0] |= PORT_PCR_MUX(1);			//Configure PTC0
+	PORTC->PCR[LCD_RS_PIN] |= PORT_PCR_MUX(1);	//Configure PTC10
+	PORTC->PCR[LCD_DB7_PIN] |= PORT_PCR_MUX(1);	//Configure PTC7
+	PORTC->PCR[LCD_RW_PIN] |= PORT_PCR_MUX(1);	//Configure PTC6
+	PORTC->PCR[LCD_E_PIN] |= PORT_PCR_MUX(1);	//Configure PTC5
+	PORTC->PCR[LCD_DB4_PIN] |= PORT_PCR_MUX(1);	//Configure PTC4
+	PORTC->PCR[LCD_DB5_PIN] |= PORT_PCR_MUX(1);	//Configure PTC3
+	PORTC->PCR[LCD_DB6_PIN] |= PORT_PCR_MUX(1);	//Configure PTC0
 
 	//Configure all the pins as output
-	GPIOC->PDDR |= (LCD_DB7 | LCD_DB6 | LCD_DB5 |
-				LCD_DB4 | LCD_E | LCD_RS | LCD_RW);
+	GPIOC->PDDR |= (LCD_DATA_MASK | LCD_E | LCD_RS | LCD_RW);
+
+	lcd_fb_clear();
+	lcd_shown_invalidate();
 }
 
 /**
@@ -57,44 +113,286 @@ void lcd_init(void){
  * @return   none
  */
 void write_nibble(uint8_t nibble){
-	uint32_t gpio_temp;
+	const lcd_nibble_masks *m = &nibble_masks[nibble >> 4];
+
+	//Two atomic stores, no read of PDOR and no branch
+	GPIOC->PSOR = m->set;
+	GPIOC->PCOR = m->clr;
+}
+
+/**
+ * @function lcd_pulse_wait
+ * @brief  	 Hold time around an enable edge
+ * @param    none
+ * @return   none
+ */
+static inline void lcd_pulse_wait(void){
+	delay_cycles(NS_TO_CYCLES(LCD_PULSE_NS));
+}
+
+/**
+ * @function lcd_read_nibble
+ * @brief  	 Pulse EN with the data pins as input and read DB7-DB4
+ * @param    none
+ * @return   nibble read in bits 7-4
+ */
+static uint8_t lcd_read_nibble(void){
+	uint32_t pins;
+	uint8_t nibble = 0;
+
+	GPIOC->PSOR = LCD_E;						//EN = High
+	lcd_pulse_wait();							//Data valid after tDDR
+	pins = GPIOC->PDIR;
+	GPIOC->PCOR = LCD_E;						//EN = Low
+	lcd_pulse_wait();
+
+	nibble |= (pins & LCD_DB7) ? 0x80 : 0;
+	nibble |= (pins & LCD_DB6) ? 0x40 : 0;
+	nibble |= (pins & LCD_DB5) ? 0x20 : 0;
+	nibble |= (pins & LCD_DB4) ? 0x10 : 0;
+	return nibble;
+}
+
+/**
+ * @function lcd_read_status
+ * @brief  	 Read the busy flag and address counter
+ * @param    none
+ * @return   BF in bit 7, address counter in bits 6-0
+ */
+static uint8_t lcd_read_status(void){
+	uint8_t status;
+
+	GPIOC->PDDR &= ~LCD_DATA_MASK;				//Data pins as input
+	GPIOC->PCOR = LCD_RS;						//Instruction register
+	GPIOC->PSOR = LCD_RW;						//Read
 
-	//Get GPIOC Data Register
-	gpio_temp = GPIOC->PDOR;
+	status = lcd_read_nibble();					//BF and AC6-4
+	status |= lcd_read_nibble() >> 4;			//AC3-0
 
-	//Update the LCD data line DB7
-	if(nibble & 0x80){
-		gpio_temp |= LCD_DB7;
+	GPIOC->PCOR = LCD_RW;						//Write
+	GPIOC->PDDR |= LCD_DATA_MASK;				//Data pins as output
+	return status;
+}
+
+/**
+ * @function lcd_wait_ready
+ * @brief  	 Poll the busy flag until the controller accepts the next
+ * 			 byte. Falls back to the datasheet execution time of the
+ * 			 last byte before 4 bit mode is set and, for good, after a
+ * 			 timeout (RW not wired for example).
+ * @param    none
+ * @return   1 when ready, 0 on timeout or without busy flag
+ */
+static uint8_t lcd_wait_ready(void){
+	uint32_t start;
+
+	if(!busy_flag_ok){
+		delay_us(exec_us);						//Datasheet time of the last byte
+		return 0;
 	}
-	else{
-		gpio_temp &= ~LCD_DB7;
+
+	start = now_us();
+	while(lcd_read_status() & 0x80){
+		if((now_us() - start) > LCD_BUSY_TIMEOUT_US){
+			busy_flag_ok = 0;
+			busy_timeouts++;
+			break;
+		}
 	}
+	return busy_flag_ok;
+}
 
-	//Update the LCD data line DB6
-	if(nibble & 0x40){
-		gpio_temp |= LCD_DB6;
+/**
+ * @function lcd_send_byte
+ * @brief  	 Write a byte as two nibbles, the controller must be ready
+ * @param    1. b		byte
+ * 			 2. rs		0 for a command, 1 for data
+ * @return   none
+ */
+static void lcd_send_byte(uint8_t b, uint8_t rs){
+	if(rs){
+		GPIOC->PSOR = LCD_RS;					//Select data register
 	}
 	else{
-		gpio_temp &= ~LCD_DB6;
+		GPIOC->PCOR = LCD_RS;					//Select command register
+	}
+	GPIOC->PCOR = LCD_RW;						//Select write operation
+
+	write_nibble(b & 0xF0);						//Write upper nibble
+	GPIOC->PSOR = LCD_E;						//EN = High
+	lcd_pulse_wait();
+	GPIOC->PCOR = LCD_E;						//EN = Low
+	lcd_pulse_wait();
+
+	write_nibble((b << 4) & 0xF0);				//Write lower nibble
+	GPIOC->PSOR = LCD_E;						//EN = High
+	lcd_pulse_wait();
+	GPIOC->PCOR = LCD_E;						//EN = Low
+	lcd_pulse_wait();
+
+	exec_us = (!rs && (b <= 0x03)) ? LCD_HOME_US : LCD_EXEC_US;
+}
+
+/**
+ * @function lcd_write_byte
+ * @brief  	 Wait for the controller and write a byte
+ * @param    1. b		byte
+ * 			 2. rs		0 for a command, 1 for data
+ * @return   none
+ */
+static void lcd_write_byte(uint8_t b, uint8_t rs){
+	lcd_wait_ready();
+	lcd_send_byte(b, rs);
+}
+
+/**
+ * @function lcd_enqueue
+ * @brief  	 Queue a byte for the background engine (main loop side)
+ * @param    entry	byte, with LCD_Q_RS for data
+ * @return   1 if queued, 0 if the queue is full
+ */
+static uint8_t lcd_enqueue(uint16_t entry){
+	uint8_t head = q_head;
+	uint8_t next = (head + 1) & LCD_QUEUE_MASK;
+	uint8_t depth;
+
+	if(next == q_tail){
+		return 0;
 	}
+	lcd_queue[head] = entry;
+	__DMB();									//Entry visible before the index
+	q_head = next;
 
-	//Update the LCD data line DB5
-	if(nibble & 0x20){
-		gpio_temp |= LCD_DB5;
+	depth = (next - q_tail) & LCD_QUEUE_MASK;
+	if(depth > queue_high_water){
+		queue_high_water = depth;
 	}
-	else{
-		gpio_temp &= ~LCD_DB5;
+	return 1;
+}
+
+/**
+ * @function lcd_try_put
+ * @brief  	 Queue a byte when the engine runs, else write it now
+ * @param    1. b		byte
+ * 			 2. rs		0 for a command, 1 for data
+ * @return   1 if queued or written, 0 if the queue is full
+ */
+static uint8_t lcd_try_put(uint8_t b, uint8_t rs){
+	if(engine_on){
+		return lcd_enqueue(b | (rs ? LCD_Q_RS : 0));
 	}
+	lcd_write_byte(b, rs);
+	return 1;
+}
 
-	//Update the LCD data line DB4
-	if(nibble & 0x10){
-		gpio_temp |= LCD_DB4;
+/**
+ * @function lcd_put
+ * @brief  	 Queue or write a byte, waits while the queue is full.
+ * 			 Main loop only, the engine drains from the SysTick interrupt.
+ * @param    1. b		byte
+ * 			 2. rs		0 for a command, 1 for data
+ * @return   none
+ */
+static void lcd_put(uint8_t b, uint8_t rs){
+	while(!lcd_try_put(b, rs)){
 	}
-	else{
-		gpio_temp &= ~LCD_DB4;
+}
+
+/**
+ * @function lcd_engine_tick
+ * @brief  	 SysTick hook: send the next queued byte once the controller
+ * 			 is ready, without ever waiting in the interrupt
+ * @param    none
+ * @return   none
+ */
+static void lcd_engine_tick(void){
+	if(!engine_on){
+		return;
+	}
+
+	//Bytes per second over one second windows
+	if(++window_ticks >= 1000){
+		engine_bytes_per_s = window_bytes;
+		window_bytes = 0;
+		window_ticks = 0;
+	}
+
+	if(wait_ticks){
+		wait_ticks--;							//Long command still executing
+		return;
+	}
+
+	for(uint8_t n = 0; (n < LCD_ENGINE_BYTES_PER_TICK) && (q_tail != q_head); n++){
+		uint16_t entry;
+
+		if(busy_flag_ok && (lcd_read_status() & 0x80)){
+			break;								//Try again next tick
+		}
+		entry = lcd_queue[q_tail];
+		lcd_send_byte(entry & 0xFF, (entry & LCD_Q_RS) ? 1 : 0);
+		q_tail = (q_tail + 1) & LCD_QUEUE_MASK;
+		engine_bytes++;
+		window_bytes++;
+
+		if(!busy_flag_ok){
+			wait_ticks = exec_us / 1000;		//Ticks beyond the next one
+			break;
+		}
+	}
+}
+
+/**
+ * @function lcd_engine_start
+ * @brief  	 Send all further output from the SysTick interrupt. LCD
+ * 			 calls then only queue bytes and return.
+ * @param    none
+ * @return   1 on success, 0 if no SysTick hook is free
+ */
+int lcd_engine_start(void){
+	static uint8_t hooked = 0;
+
+	if(!hooked){
+		if(!timer_add_hook(lcd_engine_tick)){
+			return 0;
+		}
+		hooked = 1;
 	}
+	wait_ticks = (exec_us + 999) / 1000;		//Last direct byte may still be executing
+	engine_on = 1;
+	return 1;
+}
+
+/**
+ * @function lcd_engine_idle
+ * @brief  	 Reports if the queue has been sent
+ * @param    none
+ * @return   1 if nothing is queued, 0 otherwise
+ */
+int lcd_engine_idle(void){
+	return q_tail == q_head;
+}
 
-	GPIOC->PDOR = gpio_temp;					//Write - Update data on GPIO Port C
+/**
+ * @function lcd_engine_get_stats
+ * @brief  	 Copy the queue and throughput counters
+ * @param    stats	destination
+ * @return   none
+ */
+void lcd_engine_get_stats(lcd_engine_stats *stats){
+	stats->depth = (q_head - q_tail) & LCD_QUEUE_MASK;
+	stats->high_water = queue_high_water;
+	stats->bytes = engine_bytes;
+	stats->bytes_per_s = engine_bytes_per_s;
+}
+
+/**
+ * @function lcd_get_busy_timeouts
+ * @brief  	 Busy flag reads that timed out
+ * @param    none
+ * @return   timeout count
+ */
+uint32_t lcd_get_busy_timeouts(void){
+	return busy_timeouts;
 }
 
 /**
@@ -104,24 +402,28 @@ void write_nibble(uint8_t nibble){
  * @return   none
  */
 void lcd_cmd(uint8_t cmd){
-	GPIOC->PDOR &= ~LCD_RS;						//Select command register (RS=Low)
-	GPIOC->PDOR &= ~LCD_RW;						//Select write operation (RW=Low)
-
-	write_nibble(cmd & 0xF0);					//Write upper nibble
-
-	//Generate High to Low pulse on EN pin
-	GPIOC->PDOR |= LCD_E;						//EN = High
-	delay(1);
-	GPIOC->PDOR &= ~LCD_E;						//EN = Low
-	delay(1);
-
-	write_nibble((cmd<<4) & 0xF0);				//Write lower nibble
+	while(!lcd_cmd_try(cmd)){
+	}
+}
 
-	//Generate High to Low pulse on EN pin
-	GPIOC->PDOR |= LCD_E;						//EN = High
-	delay(1);
-	GPIOC->PDOR &= ~LCD_E;						//EN = Low
-	delay(1);
+/**
+ * @function lcd_cmd_try
+ * @brief  	 Send or queue a command, tracks the address counter
+ * @param    cmd	command
+ * @return   1 if sent or queued, 0 if the queue is full
+ */
+static uint8_t lcd_cmd_try(uint8_t cmd){
+	if(!lcd_try_put(cmd, 0)){
+		return 0;
+	}
+	bus_writes++;
+	if(cmd & LCD_CMD_DDRAM){
+		lcd_addr = cmd & ~LCD_CMD_DDRAM;		//Track the address counter
+	}
+	else if(cmd <= 0x03){
+		lcd_addr = 0;							//Clear and return home
+	}
+	return 1;
 }
 
 /**
@@ -134,14 +436,14 @@ void lcd_cmd(uint8_t cmd){
  * @return   none
  */
 void start_lcd(void){
+	busy_flag_ok = 0;							//Interface width not set yet
 	lcd_cmd(0x02);								//Moves the cursor to initial positions
-	delay(10);
 	lcd_cmd(0x28);								//Enable 4-bit, 2 line, 5x7 dots mode for characters
-	delay(10);
+	delay_us(LCD_EXEC_US);
+	busy_flag_ok = LCD_USE_BUSY_FLAG;
 	lcd_cmd(0x0C);								//Display ON, Cursor OFF
-	delay(10);
 	lcd_cmd(0x01);								//Clear display
-	delay(10);
+	lcd_shown_reset();
 }
 
 /**
@@ -152,7 +454,7 @@ void start_lcd(void){
  */
 void clear_lcd(void){
 	lcd_cmd(0x01);								//Clear display
-	delay(10);
+	lcd_shown_reset();
 }
 
 /**
@@ -166,26 +468,13 @@ void clear_lcd(void){
 uint8_t lcd_string_write(char **str){
 	uint8_t cnt = 0;							//Counting String length
 
+	lcd_shown_invalidate();						//Bypasses the framebuffer
 	//Write the complete message
 	while(**str && (cnt<16)){
-		GPIOC->PDOR |= LCD_RS;					//Select data register for LCD
-		GPIOC->PDOR &= ~LCD_RW;					//Select write mode
-
-		write_nibble(**str & 0xF0);				//Writing upper nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
-
-		write_nibble((**str << 4) & 0xF0);		//Writing upper nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
-
+		bus_writes++;
+		lcd_put(**str, 1);
 		(*str)++;								//Moving the pointer to next character
 		cnt++;
-		delay(10);
 	}
 	return cnt;
 }
@@ -259,41 +548,187 @@ void lcd_data_write_int(uint32_t num, lcd_line line){
 		idx++;
 	}
 
+	lcd_shown_invalidate();						//Bypasses the framebuffer
+	bus_writes += idx ? idx : 1;
+
 	//Convert the decimal into ASCII and print on the LCD
 	for(int i=(idx - 1); i>=0; i--){
-		GPIOC->PDOR |= LCD_RS;					//Select data register
-		GPIOC->PDOR &= ~LCD_RW;					//Select write mode
+		lcd_put('0' + byte[i], 1);
+	}
+	if(idx == 0){
+		lcd_put('0', 1);
+	}
+}
+
+/**
+ * @function lcd_char
+ * @brief  	 Write one character at the current DDRAM address
+ * @param    c	character
+ * @return   none
+ */
+void lcd_char(uint8_t c){
+	while(!lcd_char_try(c)){
+	}
+}
+
+/**
+ * @function lcd_char_try
+ * @brief  	 Send or queue a character, tracks the address counter
+ * @param    c	character
+ * @return   1 if sent or queued, 0 if the queue is full
+ */
+static uint8_t lcd_char_try(uint8_t c){
+	if(!lcd_try_put(c, 1)){
+		return 0;
+	}
+	bus_writes++;
+	if(lcd_addr != LCD_ADDR_UNKNOWN){
+		lcd_addr++;								//Controller auto increments
+	}
+	return 1;
+}
+
+/**
+ * @function lcd_get_bus_writes
+ * @brief  	 Bytes (commands and characters) sent to the LCD so far
+ * @param    none
+ * @return   byte count
+ */
+uint32_t lcd_get_bus_writes(void){
+	return bus_writes;
+}
 
-		write_nibble(('0'+byte[i]) & 0xF0);		//Write upper nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
+/**
+ * @function lcd_shown_reset
+ * @brief  	 The display was cleared: all cells are spaces and the
+ * 			 address counter is back to 0
+ * @param    none
+ * @return   none
+ */
+static void lcd_shown_reset(void){
+	for(uint8_t r = 0; r < LCD_ROWS; r++){
+		for(uint8_t c = 0; c < LCD_COLS; c++){
+			lcd_shown[r][c] = ' ';
+		}
+	}
+	lcd_addr = 0;
+}
 
-		write_nibble((('0'+byte[i]) << 4) & 0xF0);	//Write lower nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
+/**
+ * @function lcd_shown_invalidate
+ * @brief  	 The display was written around the framebuffer, the next
+ * 			 flush rewrites every cell
+ * @param    none
+ * @return   none
+ */
+static void lcd_shown_invalidate(void){
+	for(uint8_t r = 0; r < LCD_ROWS; r++){
+		for(uint8_t c = 0; c < LCD_COLS; c++){
+			lcd_shown[r][c] = '\0';
+		}
+	}
+	lcd_addr = LCD_ADDR_UNKNOWN;
+}
 
-		delay(10);
+/**
+ * @function lcd_fb_clear
+ * @brief  	 Fill the framebuffer with spaces, nothing is sent
+ * @param    none
+ * @return   none
+ */
+void lcd_fb_clear(void){
+	for(uint8_t r = 0; r < LCD_ROWS; r++){
+		for(uint8_t c = 0; c < LCD_COLS; c++){
+			lcd_fb[r][c] = ' ';
+		}
 	}
-	if(idx == 0){
-		GPIOC->PDOR |= LCD_RS;					//Select data register
-		GPIOC->PDOR &= ~LCD_RW;					//Select write mode
+}
+
+/**
+ * @function lcd_fb_write
+ * @brief  	 Write a string in the framebuffer, clipped at the end of
+ * 			 the line. Nothing is sent until lcd_fb_flush.
+ * @param    1. row	line, 0 or 1
+ * 			 2. col	first column
+ * 			 3. str	string
+ * @return   characters written
+ */
+uint8_t lcd_fb_write(uint8_t row, uint8_t col, const char *str){
+	uint8_t cnt = 0;
+
+	if(row >= LCD_ROWS){
+		return 0;
+	}
+	while(*str && (col < LCD_COLS)){
+		lcd_fb[row][col++] = *str++;
+		cnt++;
+	}
+	return cnt;
+}
 
-		write_nibble(('0'+byte[idx]) & 0xF0);		//Write upper nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
+/**
+ * @function lcd_fb_write_int
+ * @brief  	 Write an unsigned integer in the framebuffer, padded with
+ * 			 spaces up to width so a shorter number clears the old digits
+ * @param    1. row		line, 0 or 1
+ * 			 2. col		first column
+ * 			 3. num		number
+ * 			 4. width	cells to fill, 0 for the digits only
+ * @return   characters written
+ */
+uint8_t lcd_fb_write_int(uint8_t row, uint8_t col, uint32_t num, uint8_t width){
+	char text[LCD_COLS + 1];
+	char digits[10];
+	uint8_t n = 0, len = 0;
 
-		write_nibble((('0'+byte[idx]) << 4) & 0xF0);	//Write lower nibble
-		GPIOC->PDOR |= LCD_E;					//EN = High
-		delay(1);
-		GPIOC->PDOR &= ~LCD_E;					//EN = Low
-		delay(1);
+	//Recovering each digit from the input
+	do{
+		digits[n++] = '0' + (num % 10);
+		num /= 10;
+	}while(num != 0);
+
+	while((n > 0) && (len < LCD_COLS)){
+		text[len++] = digits[--n];
+	}
+	while((len < width) && (len < LCD_COLS)){
+		text[len++] = ' ';
+	}
+	text[len] = '\0';
+	return lcd_fb_write(row, col, text);
+}
 
-		delay(10);
+/**
+ * @function lcd_fb_flush
+ * @brief  	 Send the cells that differ from the display. The address is
+ * 			 only set when the next changed cell is not the one the
+ * 			 controller auto increments to. With the engine running it
+ * 			 never waits, cells that do not fit in the queue are sent
+ * 			 by the next flush.
+ * @param    none
+ * @return   bytes sent or queued
+ */
+uint16_t lcd_fb_flush(void){
+	uint16_t sent = 0;
+
+	for(uint8_t r = 0; r < LCD_ROWS; r++){
+		for(uint8_t c = 0; c < LCD_COLS; c++){
+			uint8_t addr = (r ? LCD_ROW2_ADDR : 0) + c;
+
+			if(lcd_fb[r][c] == lcd_shown[r][c]){
+				continue;
+			}
+			if(addr != lcd_addr){
+				if(!lcd_cmd_try(LCD_CMD_DDRAM | addr)){
+					return sent;				//Queue full, rest on next flush
+				}
+				sent++;
+			}
+			if(!lcd_char_try(lcd_fb[r][c])){
+				return sent;
+			}
+			lcd_shown[r][c] = lcd_fb[r][c];
+			sent++;
+		}
 	}
+	return sent;
 }
@@ -1,13 +1,18 @@
 /**@file: lcd.c
  * @brief: the function is used to initialize the LCD and read and write the data
  * 			lcd_init configures the registers to initiaze the lcd
- * 			write_nibble write 4 bytes in DDRAM
+ * 			write_nibble write 4 bytes in DDRAM, set / clear masks from a table
  *			lcd_cmd sends the data that writes to memory
  *			lcd_start initializes the cursor on the lcd
  *			clear_lcd clears the LCD by configuring the data registers
  *			Lcd_string writes the string to be displayed on the LCD
  *			lcd_write to write at specific location on LCD
  *			lcd_write int write the integer value on LCD
+ *			lcd_wait_ready polls the busy flag instead of fixed delays
+ *			lcd_fb_*: 2x16 shadow framebuffer, the application draws in
+ *			RAM and lcd_fb_flush sends only the cells that changed
+ *			lcd_engine_*: queue drained from the SysTick interrupt so LCD
+ *			calls return at once
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -29,14 +34,56 @@
 
  // LCD to GPIO pin configuration interface
 
-#define LCD_DB7  ((uint32_t)1 << 7)  // PTC7
-#define LCD_DB6  ((uint32_t)1 << 0)  // PTC0
-#define LCD_DB5  ((uint32_t)1 << 3)  // PTC3
-#define LCD_DB4  ((uint32_t)1 << 4)  // PTC4
+#define LCD_DB7_PIN		7
+#define LCD_DB6_PIN		0
+#define LCD_DB5_PIN		3
+#define LCD_DB4_PIN		4
+#define LCD_E_PIN		5
+#define LCD_RW_PIN		6
+#define LCD_RS_PIN		10
 
-#define LCD_E    ((uint32_t)1 << 5)  // PTC5
-#define LCD_RW   ((uint32_t)1 << 6)  // PTC6
-#define LCD_RS   ((uint32_t)1 << 10) // PTC10
+#define LCD_DB7  ((uint32_t)1 << LCD_DB7_PIN)  // PTC7
+#define LCD_DB6  ((uint32_t)1 << LCD_DB6_PIN)  // PTC0
+#define LCD_DB5  ((uint32_t)1 << LCD_DB5_PIN)  // PTC3
+#define LCD_DB4  ((uint32_t)1 << LCD_DB4_PIN)  // PTC4
+
+#define LCD_E    ((uint32_t)1 << LCD_E_PIN)  // PTC5
+#define LCD_RW   ((uint32_t)1 << LCD_RW_PIN)  // PTC6
+#define LCD_RS   ((uint32_t)1 << LCD_RS_PIN) // PTC10
+
+#define LCD_DATA_MASK	(LCD_DB7 | LCD_DB6 | LCD_DB5 | LCD_DB4)
+
+//Port C bits set by a nibble (bit 3 on DB7 ... bit 0 on DB4)
+#define LCD_NIBBLE_SET(n)	((((n) & 8) ? LCD_DB7 : 0) | (((n) & 4) ? LCD_DB6 : 0) | \
+							(((n) & 2) ? LCD_DB5 : 0) | (((n) & 1) ? LCD_DB4 : 0))
+
+//Busy flag reads let the LCD drive DB7-DB4. The module is wired to 5 V
+//(see README) and the KL25Z pins are not 5 V tolerant, so the fixed
+//execution delays are used. Set to 1 only with a 3.3 V module.
+#ifndef LCD_USE_BUSY_FLAG
+#define LCD_USE_BUSY_FLAG	0
+#endif
+#define LCD_BUSY_TIMEOUT_US	3000		//Longest command (clear) is 1.52 ms
+#define LCD_PULSE_NS		450			//Enable pulse width (PWEH) and data delay (tDDR)
+#define LCD_EXEC_US			50			//Execution time of most commands and data (37 us)
+#define LCD_HOME_US			1600		//Execution time of clear and return home (1.52 ms)
+
+#define LCD_QUEUE_LEN		64			//Bytes queued for the engine (power of 2, max 256)
+#define LCD_ENGINE_BYTES_PER_TICK	1	//Bytes sent per SysTick (1 ms) at most
+
+#define LCD_ROWS		2
+#define LCD_COLS		16
+#define LCD_CMD_CLEAR	0x01
+#define LCD_CMD_DDRAM	0x80			//Set DDRAM address, OR the address
+#define LCD_ROW2_ADDR	0x40			//DDRAM address of the second line
+
+//Counters of the background engine
+typedef struct{
+	uint8_t depth;					//Bytes waiting in the queue
+	uint8_t high_water;				//Largest depth seen
+	uint32_t bytes;					//Bytes sent by the engine
+	uint32_t bytes_per_s;			//Bytes sent during the last second
+}lcd_engine_stats;
 
 //lcd_line denotes the line number on the LCD.
 typedef enum{
@@ -123,4 +170,96 @@ void lcd_data_write(char *data, lcd_line line);
  */
 void lcd_data_write_int(uint32_t num, lcd_line line);
 
+/**
+ * @function lcd_char
+ * @brief  	 Write one character at the current DDRAM address
+ * @param    c	character
+ * @return   none
+ */
+void lcd_char(uint8_t c);
+
+/**
+ * @function lcd_get_bus_writes
+ * @brief  	 Bytes (commands and characters) sent to the LCD so far
+ * @param    none
+ * @return   byte count
+ */
+uint32_t lcd_get_bus_writes(void);
+
+/**
+ * @function lcd_get_busy_timeouts
+ * @brief  	 Busy flag reads that timed out
+ * @param    none
+ * @return   timeout count
+ */
+uint32_t lcd_get_busy_timeouts(void);
+
+/**
+ * @function lcd_engine_start
+ * @brief  	 Send all further output from the SysTick interrupt. LCD
+ * 			 calls then only queue bytes and return.
+ * @param    none
+ * @return   1 on success, 0 if no SysTick hook is free
+ */
+int lcd_engine_start(void);
+
+/**
+ * @function lcd_engine_idle
+ * @brief  	 Reports if the queue has been sent
+ * @param    none
+ * @return   1 if nothing is queued, 0 otherwise
+ */
+int lcd_engine_idle(void);
+
+/**
+ * @function lcd_engine_get_stats
+ * @brief  	 Copy the queue and throughput counters
+ * @param    stats	destination
+ * @return   none
+ */
+void lcd_engine_get_stats(lcd_engine_stats *stats);
+
+/**
+ * @function lcd_fb_clear
+ * @brief  	 Fill the framebuffer with spaces, nothing is sent
+ * @param    none
+ * @return   none
+ */
+void lcd_fb_clear(void);
+
+/**
+ * @function lcd_fb_write
+ * @brief  	 Write a string in the framebuffer, clipped at the end of
+ * 			 the line. Nothing is sent until lcd_fb_flush.
+ * @param    1. row	line, 0 or 1
+ * 			 2. col	first column
+ * 			 3. str	string
+ * @return   characters written
+ */
+uint8_t lcd_fb_write(uint8_t row, uint8_t col, const char *str);
+
+/**
+ * @function lcd_fb_write_int
+ * @brief  	 Write an unsigned integer in the framebuffer, padded with
+ * 			 spaces up to width so a shorter number clears the old digits
+ * @param    1. row		line, 0 or 1
+ * 			 2. col		first column
+ * 			 3. num		number
+ * 			 4. width	cells to fill, 0 for the digits only
+ * @return   characters written
+ */
+uint8_t lcd_fb_write_int(uint8_t row, uint8_t col, uint32_t num, uint8_t width);
+
+/**
+ * @function lcd_fb_flush
+ * @brief  	 Send the cells that differ from the display. The address is
+ * 			 only set when the next changed cell is not the one the
+ * 			 controller auto increments to. With the engine running it
+ * 			 never waits, cells that do not fit in the queue are sent
+ * 			 by the next flush.
+ * @param    none
+ * @return   bytes sent or queued
+ */
+uint16_t lcd_fb_flush(void);
+
 #endif /* LCD_H_ */
@@ -1,7 +1,17 @@
 /**@file: mma8451.c
  * @brief: this file contains the initialization of Acceleromter mma8451
- *			read_full_xyz reads the value from the register
- *			calibration: takes average value to calibrate the accelerometer
+ *			mma_read_sample: reads one time stamped sample
+ *			mma_read_burst_dma: DMA read of the sample registers (or FIFO)
+ *			mma_unpack: converts raw sample bytes to 14 bit samples
+ *			init_mma_fifo: enables the 32 sample FIFO with a watermark
+ *			mma_fifo_drain: reads all stored samples in one burst
+ *			mma_int_init: routes data ready / FIFO interrupts to PORTA
+ *			mma_get_events: returns the events signalled by the sensor
+ *			mma_apply_config / mma_set_profile: ODR, range and oversampling
+ *			read_xyz: 8 bit fast read of the X/Y/Z MSBs in one burst
+ *			mma_stream_start: interrupt driven acquisition into a sample ring,
+ *			decimated to MMA_STREAM_RATE_HZ
+ *			mma_stream_stop: ends the acquisition
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -10,107 +20,686 @@
  * 			 https://github.com/alexander-g-dean/ESF/blob/master/NXP/Code/Chapter_8/I2C-Demo/src/mma8451.c
 */
 #include "mma8451.h"
+#include "ring.h"
+#include "dsp.h"
 
-int16_t acc_x=0, acc_y=0, acc_z=0;
+static uint8_t fifo_raw[MMA_FIFO_SIZE * MMA_BYTES_PER_SAMPLE];
+static volatile uint8_t pending_events = 0;
+static uint8_t int_events = 0;			//Events routed to PORTA by mma_int_init
+static mma_event_callback event_cb = NULL;
+static mma_range cur_range = MMA_RANGE_2G;
+static uint8_t cur_fast_read = 0;
+static mma_odr cur_odr = MMA_ODR_800HZ;
+
+//Interrupt driven acquisition
+static sample_ring_t *stream_ring = NULL;
+static uint8_t stream_events;			//Event the stream reads on
+static uint8_t stream_count;			//Samples of the burst in flight
+static volatile uint8_t stream_pending;	//Event raised while a read was running
+static uint8_t stream_status;			//F_STATUS read at the start of a FIFO burst
+static i2c_xfer_t stream_xfer;
+static uint8_t stream_raw[MMA_FIFO_SIZE * MMA_BYTES_PER_SAMPLE];
+static mma_sample_t stream_samples[MMA_FIFO_SIZE];
+static uint8_t stream_decim;			//Decimation factor, 1 if the ODR is the stream rate
+static dsp_decimator stream_dec;
+static mma_sample_t stream_out[(MMA_FIFO_SIZE / MMA_STREAM_MIN_DECIM) + 1];
+
+//Sample period for each CTRL_REG1 DR value
+static const uint32_t odr_period_us[8] = {
+	1250, 2500, 5000, 10000, 20000, 80000, 160000, 640000
+};
+
+static int16_t mma_scale(int16_t counts);
+static void mma_stamp(mma_sample_t *samples, uint16_t count);
+static uint8_t mma_fifo_count(uint8_t f_status);
+static void mma_stream_status(i2c_xfer_t *xfer);
+static void mma_stream_done(i2c_xfer_t *xfer);
+
+const mma_config mma_profiles[MMA_PROFILE_COUNT] = {
+	[MMA_PROFILE_GAIT]		= {MMA_ODR_800HZ, MMA_RANGE_4G, MMA_MODS_HIGH_RES, 1, 16, 0},
+	[MMA_PROFILE_BALANCED]	= {MMA_ODR_200HZ, MMA_RANGE_2G, MMA_MODS_NORMAL, 1, 0, 0},
+	[MMA_PROFILE_IDLE]		= {MMA_ODR_12_5HZ, MMA_RANGE_2G, MMA_MODS_LOW_POWER, 0, 0, 1}
+};
 
 /**
  * @function init_mma
- * @brief  	 Initialize accelerometer by configuring the registers
+ * @brief  	 Initialize accelerometer with the balanced profile
  * @param    none
- * @return   none
+ * @return   1 on success, 0 otherwise
  */
 int init_mma(void){
-	//Set active mode, 14 bit samples and 800hz ODR
-	I2C_write_byte(MMA_ADDR, REG_CTRL1, 0x01);
+	return mma_set_profile(MMA_PROFILE_BALANCED);
+}
+
+/**
+ * @function mma_apply_config
+ * @brief  	 Put the sensor in standby, write range, oversampling, FIFO
+ * 			 and data rate and go back to active, all in one batch.
+ * 			 Samples are always returned scaled to 2g counts (4096/g)
+ * 			 whatever the range.
+ * @param    cfg	configuration to apply
+ * @return   1 on success, 0 otherwise
+ */
+int mma_apply_config(const mma_config *cfg){
+	i2c_reg_write config[5];
+	uint8_t ctrl1 = CTRL1_ACTIVE | (cfg->odr << CTRL1_DR_SHIFT);
+
+	if(cfg->fifo_watermark > MMA_FIFO_SIZE){
+		return 0;
+	}
+	if(cfg->fast_read){
+		ctrl1 |= CTRL1_F_READ;
+	}
+	//Low noise mode limits the range to 4g
+	if(cfg->low_noise && (cfg->range != MMA_RANGE_8G)){
+		ctrl1 |= CTRL1_LNOISE;
+	}
+
+	config[0].reg = REG_CTRL1;			//Registers below can only be written in standby
+	config[0].val = 0x00;
+	config[1].reg = REG_XYZ_DATA_CFG;
+	config[1].val = cfg->range;
+	config[2].reg = REG_CTRL2;
+	config[2].val = cfg->mods;
+	config[3].reg = REG_F_SETUP;
+	config[3].val = cfg->fifo_watermark ? (F_MODE_CIRCULAR | cfg->fifo_watermark) : 0x00;
+	config[4].reg = REG_CTRL1;			//Data rate, noise mode and active
+	config[4].val = ctrl1;
+
+	if(!I2C_write_batch(MMA_ADDR, config, 5)){
+		return 0;
+	}
+	cur_range = cfg->range;
+	cur_fast_read = cfg->fast_read;
+	cur_odr = cfg->odr;
 	return 1;
 }
 
 /**
- * @function read_full_xyz
- * @brief  	 Read acceleration values for x,y,z direction
- *
+ * @function mma_set_profile
+ * @brief  	 Apply one of the predefined configurations
+ * @param    profile	entry of mma_profiles[]
+ * @return   1 on success, 0 otherwise
+ */
+int mma_set_profile(mma_profile profile){
+	if(profile >= MMA_PROFILE_COUNT){
+		return 0;
+	}
+	return mma_apply_config(&mma_profiles[profile]);
+}
+
+/**
+ * @function mma_read_sample
+ * @brief  	 Read one time stamped sample
+ * @param    s	sample read
+ * @return   1 on success, 0 otherwise
+ */
+int mma_read_sample(mma_sample_t *s){
+	uint8_t data[MMA_BYTES_PER_SAMPLE];
+
+	//Read the sample registers in a single transaction
+	if(!I2C_read_block(MMA_ADDR, REG_XHI, data, mma_bytes_per_sample())){
+		return 0;
+	}
+	mma_int_arm(MMA_EVENT_DRDY);			//Data ready served
+	mma_unpack(data, s, 1);
+	mma_stamp(s, 1);
+	return 1;
+}
+
+/**
+ * @function read_xyz
+ * @brief  	 Read the 8 bit X/Y/Z MSBs in a single transaction (3 bytes
+ * 			 in F_READ mode) and scale them to 2g counts like
+ * 			 mma_read_sample.
+ * @param    s	time stamped sample read
+ * @return   1 on success, 0 otherwise
+ */
+int read_xyz(mma_sample_t *s){
+	uint8_t data[MMA_BYTES_PER_SAMPLE - 1];
+
+	if(cur_fast_read){
+		//Auto increment skips the LSB registers
+		if(!I2C_read_block(MMA_ADDR, REG_XHI, data, MMA_BYTES_PER_SAMPLE_FAST)){
+			return 0;
+		}
+	}
+	else{
+		//OUT_X_MSB..OUT_Z_MSB, LSBs are skipped below
+		if(!I2C_read_block(MMA_ADDR, REG_XHI, data, REG_ZHI - REG_XHI + 1)){
+			return 0;
+		}
+		data[1] = data[2];
+		data[2] = data[4];
+	}
+
+	s->x = mma_scale((int16_t)((int8_t)data[0]) * 64);
+	s->y = mma_scale((int16_t)((int8_t)data[1]) * 64);
+	s->z = mma_scale((int16_t)((int8_t)data[2]) * 64);
+	mma_stamp(s, 1);
+	return 1;
+}
+
+/**
+ * @function mma_stamp
+ * @brief  	 Time stamp a block of samples that has just been read, the
+ * 			 last one being the newest, spaced by the sample period.
+ * @param    1. samples	block of samples, oldest first
+ * 			 2. count	number of samples
+ * @return   none
+ */
+static void mma_stamp(mma_sample_t *samples, uint16_t count){
+	uint32_t t = now_us();
+	uint32_t period = odr_period_us[cur_odr];
+
+	for(uint16_t i = count; i > 0; i--){
+		samples[i - 1].ts = t;
+		t -= period;
+	}
+}
+
+/**
+ * @function mma_sample_period_us
+ * @brief  	 Time between two samples at the configured data rate
  * @param    none
+ * @return   sample period in microseconds
+ */
+uint32_t mma_sample_period_us(void){
+	return odr_period_us[cur_odr];
+}
+
+/**
+ * @function mma_bytes_per_sample
+ * @brief  	 Bytes transferred per sample in the current read mode
+ * @param    none
+ * @return   MMA_BYTES_PER_SAMPLE or MMA_BYTES_PER_SAMPLE_FAST
+ */
+uint8_t mma_bytes_per_sample(void){
+	return cur_fast_read ? MMA_BYTES_PER_SAMPLE_FAST : MMA_BYTES_PER_SAMPLE;
+}
+
+/**
+ * @function mma_read_burst_dma
+ * @brief  	 Queue a read of the OUT_X_MSB..OUT_Z_LSB block, moved to RAM
+ * 			 by DMA with a single completion interrupt. With the FIFO
+ * 			 enabled several samples can be drained in one burst, otherwise
+ * 			 samples must be 1.
+ * @param    1. xfer	transaction descriptor, valid until cb is called
+ * 			 2. raw		buffer of samples*mma_bytes_per_sample() bytes
+ * 			 3. samples	number of samples to read
+ * 			 4. cb		called from interrupt when raw is filled
+ * @return   1 if queued, 0 otherwise
+ */
+int mma_read_burst_dma(i2c_xfer_t *xfer, uint8_t *raw, uint16_t samples, i2c_callback cb){
+	xfer->dev = MMA_ADDR;
+	xfer->reg = REG_XHI;
+	xfer->dir = I2C_XFER_READ;
+	xfer->buf = raw;
+	xfer->len = samples * mma_bytes_per_sample();
+	xfer->flags = I2C_XFER_DMA;
+	xfer->callback = cb;
+	return I2C_submit(xfer);
+}
+
+/**
+ * @function mma_scale
+ * @brief  	 Bring a 14 bit sample of the current range to 2g counts,
+ * 			 saturated to the int16_t range.
+ * @param    counts	14 bit sample
+ * @return   sample in 2g counts
+ */
+static int16_t mma_scale(int16_t counts){
+	int32_t scaled = (int32_t)counts * (1 << cur_range);
+
+	if(scaled > INT16_MAX){
+		return INT16_MAX;
+	}
+	if(scaled < INT16_MIN){
+		return INT16_MIN;
+	}
+	return (int16_t)scaled;
+}
+
+/**
+ * @function mma_unpack
+ * @brief  	 Convert raw sample register bytes (14 bit, or 8 bit in
+ * 			 F_READ mode) to samples scaled to 2g counts for the
+ * 			 configured range
+ * @param    1. raw		bytes read from OUT_X_MSB onwards
+ * 			 2. out		converted samples
+ * 			 3. samples	number of samples in raw
+ * @return   none
+ */
+void mma_unpack(const uint8_t *raw, mma_sample_t *out, uint16_t samples){
+	if(cur_fast_read){
+		for(uint16_t i = 0; i < samples; i++){
+			//MSB only, align to 14 bits
+			out[i].x = mma_scale((int16_t)((int8_t)raw[0]) * 64);
+			out[i].y = mma_scale((int16_t)((int8_t)raw[1]) * 64);
+			out[i].z = mma_scale((int16_t)((int8_t)raw[2]) * 64);
+			raw += MMA_BYTES_PER_SAMPLE_FAST;
+		}
+		return;
+	}
+
+	for(uint16_t i = 0; i < samples; i++){
+		//Align for 14 bits
+		out[i].x = mma_scale(((int16_t)((raw[0]<<8) | raw[1])) / 4);
+		out[i].y = mma_scale(((int16_t)((raw[2]<<8) | raw[3])) / 4);
+		out[i].z = mma_scale(((int16_t)((raw[4]<<8) | raw[5])) / 4);
+		raw += MMA_BYTES_PER_SAMPLE;
+	}
+}
+
+/**
+ * @function init_mma_fifo
+ * @brief  	 Initialize the accelerometer with the gait profile and the
+ * 			 32 sample FIFO enabled in circular mode. The watermark flag
+ * 			 is raised once watermark samples are stored.
+ * @param    watermark	samples needed to raise the watermark flag (1..32)
+ * @return   1 on success, 0 otherwise
+ */
+int init_mma_fifo(uint8_t watermark){
+	mma_config cfg = mma_profiles[MMA_PROFILE_GAIT];
+
+	if((watermark == 0) || (watermark > MMA_FIFO_SIZE)){
+		return 0;
+	}
+	cfg.fifo_watermark = watermark;
+	return mma_apply_config(&cfg);
+}
+
+/**
+ * @function mma_fifo_count
+ * @brief  	 Samples stored in the FIFO according to F_STATUS
+ * @param    f_status	F_STATUS register
+ * @return   sample count (0..MMA_FIFO_SIZE)
+ */
+static uint8_t mma_fifo_count(uint8_t f_status){
+	uint8_t count = f_status & F_CNT_MASK;
+
+	return (count > MMA_FIFO_SIZE) ? MMA_FIFO_SIZE : count;
+}
+
+/**
+ * @function mma_fifo_drain
+ * @brief  	 Read every sample stored in the FIFO (up to max) in a single
+ * 			 DMA burst and hand them back as a contiguous block.
+ * @param    1. samples	storage for the samples, oldest first
+ * 			 2. max		capacity of samples
+ * @return   number of samples read
+ */
+uint8_t mma_fifo_drain(mma_sample_t *samples, uint8_t max){
+	uint8_t f_status;
+	uint8_t count;
+	i2c_xfer_t xfer;
+
+	if(!I2C_read_block(MMA_ADDR, REG_STATUS, &f_status, 1)){
+		return 0;
+	}
+	count = mma_fifo_count(f_status);
+	if(count > max){
+		count = max;
+	}
+	if(count == 0){
+		mma_int_arm(MMA_EVENT_FIFO);
+		return 0;
+	}
+
+	//OUT_X_MSB wraps back on itself in FIFO mode, one burst empties it
+	xfer.dev = MMA_ADDR;
+	xfer.reg = REG_XHI;
+	xfer.dir = I2C_XFER_READ;
+	xfer.buf = fifo_raw;
+	xfer.len = count * mma_bytes_per_sample();
+	xfer.flags = I2C_XFER_DMA;
+	if(!I2C_transfer(&xfer)){
+		return 0;
+	}
+	mma_int_arm(MMA_EVENT_FIFO);			//Still asserted if samples are left
+	mma_unpack(fifo_raw, samples, count);
+	mma_stamp(samples, count);
+	return count;
+}
+
+/**
+ * @function mma_int_init
+ * @brief  	 Enable the sensor interrupt sources, route the FIFO watermark
+ * 			 to INT1 (PTA14) and data ready to INT2 (PTA15) and arm the
+ * 			 PORTA level low interrupt of the enabled ones. A level
+ * 			 interrupt cannot miss an event that is raised again before
+ * 			 the previous one was served, as an edge would. Each event
+ * 			 disarms its pin until it is served, see mma_int_arm().
+ * @param    1. events	MMA_EVENT_xxx sources to enable
+ * 			 2. cb		called from interrupt on each event (can be NULL)
+ * @return   1 on success, 0 otherwise
+ */
+int mma_int_init(uint8_t events, mma_event_callback cb){
+	uint8_t ctrl1;
+	uint8_t int_en = 0;
+	i2c_reg_write config[4];
+
+	if(events & MMA_EVENT_DRDY){
+		int_en |= INT_EN_DRDY;
+	}
+	if(events & MMA_EVENT_FIFO){
+		int_en |= INT_EN_FIFO;
+	}
+
+	//CTRL_REG4/5 can only be written in standby
+	if(!I2C_read_block(MMA_ADDR, REG_CTRL1, &ctrl1, 1)){
+		return 0;
+	}
+	config[0].reg = REG_CTRL1;
+	config[0].val = ctrl1 & ~CTRL1_ACTIVE;
+	config[1].reg = REG_CTRL4;
+	config[1].val = int_en;
+	config[2].reg = REG_CTRL5;
+	config[2].val = INT_EN_FIFO;			//FIFO on INT1, everything else on INT2
+	config[3].reg = REG_CTRL1;
+	config[3].val = ctrl1;
+
+	event_cb = cb;
+	pending_events = 0;
+	int_events = 0;
+
+	//INT1/INT2 are active low push-pull (CTRL_REG3 default), disarmed
+	//until the sensor is configured
+	SIM->SCGC5 |= SIM_SCGC5_PORTA_MASK;
+	PORTA->PCR[MMA_INT1_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	PORTA->PCR[MMA_INT2_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	GPIOA->PDDR &= ~((1U << MMA_INT1_PIN) | (1U << MMA_INT2_PIN));
+
+	NVIC_SetPriority(PORTA_IRQn, MMA_IRQ_PRIORITY);
+	NVIC_ClearPendingIRQ(PORTA_IRQn);
+	NVIC_EnableIRQ(PORTA_IRQn);
+
+	if(!I2C_write_batch(MMA_ADDR, config, 4)){
+		return 0;
+	}
+	int_events = events & (MMA_EVENT_DRDY | MMA_EVENT_FIFO);
+	mma_int_arm(int_events);
+	return 1;
+}
+
+/**
+ * @function mma_int_arm
+ * @brief  	 Re-enable the PORTA interrupt of served events. If the
+ * 			 sensor still asserts the line (more data ready, FIFO still
+ * 			 above the watermark) the interrupt is raised again at once.
+ * @param    events	MMA_EVENT_xxx served, only the enabled ones are armed
  * @return   none
  */
-void read_full_xyz(void){
-	int i;
-	uint8_t data[6];
-	int16_t temp[3];
+void mma_int_arm(uint8_t events){
+	events &= int_events;
+	if(events & MMA_EVENT_FIFO){
+		PORTA->PCR[MMA_INT1_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK | PORT_PCR_IRQC(0x8);
+	}
+	if(events & MMA_EVENT_DRDY){
+		PORTA->PCR[MMA_INT2_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK | PORT_PCR_IRQC(0x8);
+	}
+}
 
-	I2C_start();
-	I2C_read_setup(MMA_ADDR, REG_XHI);
+/**
+ * @function mma_int_asserted
+ * @brief  	 Reads the sensor interrupt lines
+ * @param    events	MMA_EVENT_xxx lines to check
+ * @return   1 if one of them is asserted (low)
+ */
+static int mma_int_asserted(uint8_t events){
+	uint32_t pins = 0;
 
-	//Read five bytes in repeated mode
-	for(i=0; i<5; i++){
-		data[i] = I2C_repeated_read(0);
+	if(events & MMA_EVENT_FIFO){
+		pins |= 1U << MMA_INT1_PIN;
+	}
+	if(events & MMA_EVENT_DRDY){
+		pins |= 1U << MMA_INT2_PIN;
 	}
-	//Read last byte ending repeated mode
-	data[i] = I2C_repeated_read(1);
+	return (GPIOA->PDIR & pins) != pins;
+}
+
+/**
+ * @function mma_get_events
+ * @brief  	 Returns and clears the events raised since the last call
+ * @param    none
+ * @return   MMA_EVENT_xxx bit mask
+ */
+uint8_t mma_get_events(void){
+	uint8_t events;
+	uint32_t primask = __get_PRIMASK();
+
+	__disable_irq();
+	events = pending_events;
+	pending_events = 0;
+	__set_PRIMASK(primask);
+	return events;
+}
 
-	for(i=0; i<3; i++){
-		temp[i] = (int16_t)((data[2*i]<<8) | data[2*i+1]);
+/**
+ * @function mma_wait_event
+ * @brief  	 Sleep until the sensor raises an event
+ * @param    none
+ * @return   MMA_EVENT_xxx bit mask
+ */
+uint8_t mma_wait_event(void){
+	uint8_t events;
+
+	while((events = mma_get_events()) == 0){
+		__WFI();						//Woken by PORTA (or SysTick)
 	}
+	return events;
+}
 
-	//Align for 14 bits
-	acc_x = temp[0]/4;
-	acc_y = temp[1]/4;
-	acc_z = temp[2]/4;
+/**
+ * @function PORTA_IRQHandler
+ * @brief  	 Translates the sensor INT1/INT2 levels into events. The pin
+ * 			 stays disarmed until the event is served (mma_int_arm).
+ * @param    none
+ * @return   none
+ */
+void PORTA_IRQHandler(void){
+	uint32_t flags = PORTA->ISFR;
+	uint8_t events = 0;
 
+	if(flags & (1U << MMA_INT1_PIN)){
+		PORTA->PCR[MMA_INT1_PIN] = PORT_PCR_MUX(1);
+		events |= MMA_EVENT_FIFO;
+	}
+	if(flags & (1U << MMA_INT2_PIN)){
+		PORTA->PCR[MMA_INT2_PIN] = PORT_PCR_MUX(1);
+		events |= MMA_EVENT_DRDY;
+	}
+	PORTA->ISFR = flags;				//Clear the pin interrupt flags
+	if(events == 0){
+		return;
+	}
 
+	pending_events |= events;
+	if(event_cb){
+		event_cb(events);
+	}
 }
 
 /**
- * @function read_xyz
- * @brief  	 Read the value from the register where the x, y and z direction
- * 			 are stored.
+ * @function mma_stream_read
+ * @brief  	 Queue the reads of one acquisition event: F_STATUS first in
+ * 			 FIFO mode, the single sample otherwise
  * @param    none
  * @return   none
  */
-void read_xyz(void){
-	acc_x = (int8_t)I2C_read_byte(MMA_ADDR, REG_XHI);
-	delay(100);
-	acc_y = (int8_t)I2C_read_byte(MMA_ADDR, REG_YHI);
-	delay(100);
-	acc_z = (int8_t)I2C_read_byte(MMA_ADDR, REG_ZHI);
+static void mma_stream_read(void){
+	int queued;
+
+	stream_pending = 0;
+	if(stream_events == MMA_EVENT_FIFO){
+		stream_xfer.dev = MMA_ADDR;
+		stream_xfer.reg = REG_STATUS;
+		stream_xfer.dir = I2C_XFER_READ;
+		stream_xfer.buf = &stream_status;
+		stream_xfer.len = 1;
+		stream_xfer.flags = 0;
+		stream_xfer.callback = mma_stream_status;
+		queued = I2C_submit(&stream_xfer);
+	}
+	else{
+		stream_count = 1;
+		queued = mma_read_burst_dma(&stream_xfer, stream_raw, 1, mma_stream_done);
+	}
+	if(!queued){
+		mma_int_arm(stream_events);		//Engine queue full, the level retriggers
+	}
 }
 
 /**
- * @function calibrate
- * @brief  	 Calibrates the reading of the accelerometer. The
- * 			 function stores the value clearing the offset. It
- * 			 returns the average values for all 3 axis to a
- * 			 dedicated buffer.
- * @param    xval[in]	pointer to buffer to store 100 values of
- * 						x-axis.
- * 			 yval[in]	pointer to buffer to store 100 values of
- * 						y-axis.
- * 			 zval[in]	pointer to buffer to store 100 values of
- * 						z-axis.
- * 			 xavg[out]	returns the average of acc. along x-axis
- * 			 yavg[out]	returns the average of acc. along y-axis
- * 			 zavg[out]	returns the average of acc. along z-axis
- * @return   average values of acceleration along all the 3 axis
+ * @function mma_stream_next
+ * @brief  	 End of an acquisition event: read again if the sensor still
+ * 			 has data, else wait for the next interrupt
+ * @param    ok		0 if the last read failed
+ * @return   none
  */
-void calibrate(int16_t *x, int16_t *y, int16_t *z, int *x_avg, int *y_avg, int *z_avg){
-	int sum = 0, sum1 = 0, sum2 = 0;
-	for(int i = 0; i<100; i++){
-		read_full_xyz();
-		x[i] = acc_x;
-		sum = x[i] + sum;
+static void mma_stream_next(int ok){
+	if(ok && (stream_pending || mma_int_asserted(stream_events))){
+		mma_stream_read();
+		return;
+	}
+	mma_int_arm(stream_events);
+}
 
-		y[i] = acc_y;
-		sum1 = y[i] + sum1;
+/**
+ * @function mma_stream_status
+ * @brief  	 F_STATUS read: drain every stored sample in one DMA burst
+ * @param    xfer	finished transaction
+ * @return   none
+ */
+static void mma_stream_status(i2c_xfer_t *xfer){
+	if(xfer->status != I2C_STATUS_DONE){
+		mma_stream_next(0);
+		return;
+	}
+	stream_count = mma_fifo_count(stream_status);
+	if((stream_count == 0) ||
+		!mma_read_burst_dma(&stream_xfer, stream_raw, stream_count, mma_stream_done)){
+		mma_stream_next(stream_count == 0);
+	}
+}
+
+/**
+ * @function mma_stream_push
+ * @brief  	 Decimate a block of samples to the stream rate and push the
+ * 			 result in the ring
+ * @param    1. samples	time stamped samples, oldest first
+ * 			 2. count	number of samples
+ * @return   none
+ */
+static void mma_stream_push(const mma_sample_t *samples, uint8_t count){
+	const mma_sample_t *out = samples;
+	uint16_t n = count;
 
-		z[i] = acc_z;
-		sum2 = z[i] + sum2;
+	if(stream_decim > 1){
+		n = dsp_decimator_feed(&stream_dec, samples, count, stream_out);
+		out = stream_out;
+	}
+	for(uint16_t i = 0; i < n; i++){
+		ring_put(stream_ring, &out[i]);
 	}
-	delay(100);
-	*x_avg = sum/100;
+}
 
+/**
+ * @function mma_stream_done
+ * @brief  	 DMA read completion: convert the burst and push it in the ring
+ * @param    xfer	finished transaction
+ * @return   none
+ */
+static void mma_stream_done(i2c_xfer_t *xfer){
+	if(xfer->status != I2C_STATUS_DONE){
+		mma_stream_next(0);
+		return;
+	}
+	mma_unpack(stream_raw, stream_samples, stream_count);
+	mma_stamp(stream_samples, stream_count);
+	mma_stream_push(stream_samples, stream_count);
+	mma_stream_next(1);
+}
+
+/**
+ * @function mma_stream_event
+ * @brief  	 Sensor event: read the new samples, or note the event if
+ * 			 the previous read is still running
+ * @param    events	MMA_EVENT_xxx raised
+ * @return   none
+ */
+static void mma_stream_event(uint8_t events){
+	if(!(events & stream_events)){
+		return;
+	}
+	if((stream_xfer.status == I2C_STATUS_QUEUED) || (stream_xfer.status == I2C_STATUS_BUSY)){
+		stream_pending = 1;
+		return;
+	}
+	mma_stream_read();
+}
+
+/**
+ * @function mma_stream_start
+ * @brief  	 Start interrupt driven acquisition. Each data ready (or FIFO
+ * 			 watermark) interrupt reads the new samples with DMA: in FIFO
+ * 			 mode F_STATUS then all F_CNT stored samples in one burst,
+ * 			 starting with the samples already stored (mma_fifo_drain).
+ * 			 The completion interrupt decimates the time stamped samples
+ * 			 to MMA_STREAM_RATE_HZ, pushes them into ring and reads again
+ * 			 while the sensor still asserts its interrupt, so the FIFO
+ * 			 never stays above the watermark.
+ * 			 The sensor must already be configured at 800, 400 or 50 Hz,
+ * 			 with the FIFO enabled when fifo is not 0.
+ * @param    1. ring	destination of the samples, consumed by the main loop
+ * 			 2. fifo	1 to read on FIFO watermark, 0 on data ready
+ * @return   1 on success, 0 if the data rate has no decimation to the
+ * 			 stream rate or the interrupts could not be set up
+ */
+int mma_stream_start(sample_ring_t *ring, uint8_t fifo){
+	uint32_t period = odr_period_us[cur_odr];
 
-	*y_avg = sum1/100;
+	//800 Hz / 16 and 400 Hz / 8 are covered by decim_coeffs, 50 Hz as is
+	if((period * MMA_STREAM_RATE_HZ) > 1000000){
+		return 0;
+	}
+	stream_decim = (uint8_t)(1000000 / (period * MMA_STREAM_RATE_HZ));
+	if((stream_decim != 1) && (stream_decim != 8) && (stream_decim != 16)){
+		return 0;
+	}
+	if((stream_decim > 1) && !dsp_decimator_init(&stream_dec, stream_decim)){
+		return 0;
+	}
+	stream_ring = ring;
+	stream_events = fifo ? MMA_EVENT_FIFO : MMA_EVENT_DRDY;
+	stream_pending = 0;
+	stream_xfer.status = I2C_STATUS_IDLE;
+	if(fifo){
+		//Samples stored since the FIFO was configured, in one burst
+		mma_stream_push(stream_samples, mma_fifo_drain(stream_samples, MMA_FIFO_SIZE));
+	}
 
+	return mma_int_init(stream_events, mma_stream_event);
+}
 
-	*z_avg = sum2/100;
+/**
+ * @function mma_stream_stop
+ * @brief  	 Stop the interrupt driven acquisition and wait for the read
+ * 			 in progress, if any
+ * @param    none
+ * @return   none
+ */
+void mma_stream_stop(void){
+	uint32_t primask = __get_PRIMASK();
 
+	__disable_irq();
+	stream_events = 0;
+	int_events = 0;
+	PORTA->PCR[MMA_INT1_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	PORTA->PCR[MMA_INT2_PIN] = PORT_PCR_MUX(1) | PORT_PCR_ISF_MASK;
+	__set_PRIMASK(primask);
+
+	while((stream_xfer.status == I2C_STATUS_QUEUED) || (stream_xfer.status == I2C_STATUS_BUSY)){
+		__WFI();						//Woken by the I2C0 / DMA0 interrupts
+	}
 }
@@ -1,7 +1,18 @@
 /**@file: mma8451.h
  * @brief: this file contains the initialization of Accelerometer mma8451
- *			read_full_xyz reads the value from the register
- *			calibration: takes average value to calibrate the accelerometer
+ *			mma_read_sample: reads one time stamped sample
+ *			mma_read_burst_dma: DMA read of the sample registers (or FIFO)
+ *			mma_unpack: converts raw sample bytes to 14 bit samples
+ *			init_mma_fifo: enables the 32 sample FIFO with a watermark
+ *			mma_fifo_drain: reads all stored samples in one burst
+ *			mma_int_init: routes data ready / FIFO interrupts to PORTA
+ *			mma_int_arm: re-enables the interrupt of a served event
+ *			mma_get_events: returns the events signalled by the sensor
+ *			mma_apply_config / mma_set_profile: ODR, range and oversampling
+ *			read_xyz: 8 bit fast read of the X/Y/Z MSBs in one burst
+ *			mma_stream_start: interrupt driven acquisition into a sample ring,
+ *			decimated to MMA_STREAM_RATE_HZ
+ *			mma_stream_stop: ends the acquisition
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -24,6 +35,7 @@
  ************************************************/
 #define MMA_ADDR 0x3A
 
+#define REG_STATUS 0x00			//F_STATUS when the FIFO is enabled
 #define REG_XHI 0x01
 #define REG_XLO 0x02
 #define REG_YHI 0x03
@@ -31,50 +43,279 @@
 #define REG_ZHI	0x05
 #define REG_ZLO 0x06
 
+#define REG_F_SETUP 0x09
 #define REG_WHOAMI 0x0D
+#define REG_XYZ_DATA_CFG 0x0E
 #define REG_CTRL1  0x2A
+#define REG_CTRL2  0x2B
+#define REG_CTRL3  0x2C
 #define REG_CTRL4  0x2D
+#define REG_CTRL5  0x2E
 
 #define WHOAMI 0x1A
 
+#define MMA_BYTES_PER_SAMPLE	6		//OUT_X_MSB..OUT_Z_LSB
+#define MMA_BYTES_PER_SAMPLE_FAST	3	//X/Y/Z MSB only (F_READ)
+
+#define MMA_FIFO_SIZE		32			//Samples stored by the sensor FIFO
+#define MMA_STREAM_RATE_HZ	50			//Rate of the samples pushed by the stream
+#define MMA_STREAM_MIN_DECIM	8		//Smallest decimation factor to the stream rate
+#define F_MODE_CIRCULAR		0x40		//F_SETUP: FIFO keeps the newest samples
+#define F_WMRK_MASK			0x3F		//F_SETUP: watermark count
+#define F_CNT_MASK			0x3F		//F_STATUS: samples in the FIFO
+#define F_WMRK_FLAG			0x40		//F_STATUS: watermark reached
+#define F_OVF				0x80		//F_STATUS: samples were lost
+
+#define CTRL1_ACTIVE		0x01
+#define CTRL1_F_READ		0x02
+#define CTRL1_LNOISE		0x04
+#define CTRL1_DR_SHIFT		3
+#define INT_EN_DRDY			0x01		//CTRL_REG4/5: data ready
+#define INT_EN_FIFO			0x40		//CTRL_REG4/5: FIFO watermark
+
+//Sensor interrupt outputs on the FRDM-KL25Z (active low)
+#define MMA_INT1_PIN		14			//PTA14, FIFO watermark
+#define MMA_INT2_PIN		15			//PTA15, data ready
+#define MMA_IRQ_PRIORITY	2
+
+//Events reported to the application
+#define MMA_EVENT_DRDY		0x01
+#define MMA_EVENT_FIFO		0x02
+
+//Output data rate, CTRL_REG1 DR field
+typedef enum{
+	MMA_ODR_800HZ,
+	MMA_ODR_400HZ,
+	MMA_ODR_200HZ,
+	MMA_ODR_100HZ,
+	MMA_ODR_50HZ,
+	MMA_ODR_12_5HZ,
+	MMA_ODR_6_25HZ,
+	MMA_ODR_1_56HZ
+}mma_odr;
+
+//Full scale range, XYZ_DATA_CFG FS field
+typedef enum{
+	MMA_RANGE_2G,
+	MMA_RANGE_4G,
+	MMA_RANGE_8G
+}mma_range;
+
+//Oversampling mode, CTRL_REG2 MODS field
+typedef enum{
+	MMA_MODS_NORMAL,
+	MMA_MODS_LOW_NOISE_LOW_POWER,
+	MMA_MODS_HIGH_RES,
+	MMA_MODS_LOW_POWER
+}mma_mods;
+
+//Sensor configuration, applied with a single batched write
+typedef struct{
+	mma_odr odr;
+	mma_range range;
+	mma_mods mods;
+	uint8_t low_noise;				//CTRL_REG1 LNOISE, ignored above 4g
+	uint8_t fifo_watermark;			//0 = FIFO disabled
+	uint8_t fast_read;				//CTRL_REG1 F_READ, 8 bit samples
+}mma_config;
+
+//Predefined configurations of mma_profiles[]
+typedef enum{
+	MMA_PROFILE_GAIT,				//800 Hz, 4g, high resolution, FIFO
+	MMA_PROFILE_BALANCED,			//200 Hz, 2g, normal
+	MMA_PROFILE_IDLE,				//12.5 Hz, 2g, low power, 8 bit fast read
+	MMA_PROFILE_COUNT
+}mma_profile;
+
+extern const mma_config mma_profiles[MMA_PROFILE_COUNT];
+
+//Called from the PORTA interrupt with the MMA_EVENT_xxx just raised
+typedef void (*mma_event_callback)(uint8_t events);
+
+//One acceleration sample, 14 bit aligned, with its capture time
+typedef struct{
+	uint32_t ts;					//now_us() when the sensor produced it
+	int16_t x;
+	int16_t y;
+	int16_t z;
+}mma_sample_t;
+
+struct sample_ring;
+
 /**
  * @function init_mma
- * @brief  	 Initialize accelerometer by configuring the registers
+ * @brief  	 Initialize accelerometer with the balanced profile
  * @param    none
- * @return   none
+ * @return   1 on success, 0 otherwise
  */
 int init_mma(void);
 
 /**
- * @function read_full_xyz
- * @brief  	 Read acceleration values for x,y,z direction
- *
- * @param    none
- * @return   none
+ * @function mma_apply_config
+ * @brief  	 Put the sensor in standby, write range, oversampling, FIFO
+ * 			 and data rate and go back to active, all in one batch.
+ * 			 Samples are always returned scaled to 2g counts (4096/g)
+ * 			 whatever the range.
+ * @param    cfg	configuration to apply
+ * @return   1 on success, 0 otherwise
+ */
+int mma_apply_config(const mma_config *cfg);
+
+/**
+ * @function mma_set_profile
+ * @brief  	 Apply one of the predefined configurations
+ * @param    profile	entry of mma_profiles[]
+ * @return   1 on success, 0 otherwise
+ */
+int mma_set_profile(mma_profile profile);
+
+/**
+ * @function mma_read_sample
+ * @brief  	 Read one time stamped sample
+ * @param    s	sample read
+ * @return   1 on success, 0 otherwise
  */
-void read_full_xyz(void);
+int mma_read_sample(mma_sample_t *s);
 
 /**
  * @function read_xyz
- * @brief  	 Read the value from the register where the x, y and z direction
- * 			 are stored.
+ * @brief  	 Read the 8 bit X/Y/Z MSBs in a single transaction (3 bytes
+ * 			 in F_READ mode) and scale them to 2g counts like
+ * 			 mma_read_sample.
+ * @param    s	time stamped sample read
+ * @return   1 on success, 0 otherwise
+ */
+int read_xyz(mma_sample_t *s);
+
+/**
+ * @function mma_bytes_per_sample
+ * @brief  	 Bytes transferred per sample in the current read mode
  * @param    none
+ * @return   MMA_BYTES_PER_SAMPLE or MMA_BYTES_PER_SAMPLE_FAST
+ */
+uint8_t mma_bytes_per_sample(void);
+
+/**
+ * @function mma_read_burst_dma
+ * @brief  	 Queue a read of the OUT_X_MSB..OUT_Z_LSB block, moved to RAM
+ * 			 by DMA with a single completion interrupt. With the FIFO
+ * 			 enabled several samples can be drained in one burst, otherwise
+ * 			 samples must be 1.
+ * @param    1. xfer	transaction descriptor, valid until cb is called
+ * 			 2. raw		buffer of samples*mma_bytes_per_sample() bytes
+ * 			 3. samples	number of samples to read
+ * 			 4. cb		called from interrupt when raw is filled
+ * @return   1 if queued, 0 otherwise
+ */
+int mma_read_burst_dma(i2c_xfer_t *xfer, uint8_t *raw, uint16_t samples, i2c_callback cb);
+
+/**
+ * @function mma_unpack
+ * @brief  	 Convert raw sample register bytes (14 bit, or 8 bit in
+ * 			 F_READ mode) to samples scaled to 2g counts for the
+ * 			 configured range
+ * @param    1. raw		bytes read from OUT_X_MSB onwards
+ * 			 2. out		converted samples
+ * 			 3. samples	number of samples in raw
+ * @return   none
+ */
+void mma_unpack(const uint8_t *raw, mma_sample_t *out, uint16_t samples);
+
+/**
+ * @function init_mma_fifo
+ * @brief  	 Initialize the accelerometer with the gait profile and the
+ * 			 32 sample FIFO enabled in circular mode. The watermark flag
+ * 			 is raised once watermark samples are stored.
+ * @param    watermark	samples needed to raise the watermark flag (1..32)
+ * @return   1 on success, 0 otherwise
+ */
+int init_mma_fifo(uint8_t watermark);
+
+/**
+ * @function mma_fifo_drain
+ * @brief  	 Read every sample stored in the FIFO (up to max) in a single
+ * 			 DMA burst and hand them back as a contiguous block.
+ * @param    1. samples	storage for the samples, oldest first
+ * 			 2. max		capacity of samples
+ * @return   number of samples read
+ */
+uint8_t mma_fifo_drain(mma_sample_t *samples, uint8_t max);
+
+/**
+ * @function mma_int_init
+ * @brief  	 Enable the sensor interrupt sources, route the FIFO watermark
+ * 			 to INT1 (PTA14) and data ready to INT2 (PTA15) and arm the
+ * 			 PORTA level low interrupt of the enabled ones. A level
+ * 			 interrupt cannot miss an event that is raised again before
+ * 			 the previous one was served, as an edge would. Each event
+ * 			 disarms its pin until it is served, see mma_int_arm().
+ * @param    1. events	MMA_EVENT_xxx sources to enable
+ * 			 2. cb		called from interrupt on each event (can be NULL)
+ * @return   1 on success, 0 otherwise
+ */
+int mma_int_init(uint8_t events, mma_event_callback cb);
+
+/**
+ * @function mma_int_arm
+ * @brief  	 Re-enable the PORTA interrupt of served events. If the
+ * 			 sensor still asserts the line (more data ready, FIFO still
+ * 			 above the watermark) the interrupt is raised again at once.
+ * 			 mma_read_sample and mma_fifo_drain call it themselves.
+ * @param    events	MMA_EVENT_xxx served, only the enabled ones are armed
  * @return   none
  */
-void read_xyz(void);
+void mma_int_arm(uint8_t events);
 
 /**
- * @function calibrate
- * @brief  	 Calibrates the reading of the accelerometer. The
- * 			 function clears the offset in all x,y,z axis.
- * @param    xval[]	pointer to buffer to store values on x direction
- * 			 yval[]	pointer to buffer to store values on y direction
- * 			 zval[]	pointer to buffer to store values on z direction
- * 			 xavg[]	returns the average of acc. along x-axis
- * 			 yavg[]	returns the average of acc. along y-axis
- * 			 zavg[]	returns the average of acc. along z-axis
- * @return   average values of acceleration
+ * @function mma_get_events
+ * @brief  	 Returns and clears the events raised since the last call
+ * @param    none
+ * @return   MMA_EVENT_xxx bit mask
+ */
+uint8_t mma_get_events(void);
+
+/**
+ * @function mma_wait_event
+ * @brief  	 Sleep until the sensor raises an event
+ * @param    none
+ * @return   MMA_EVENT_xxx bit mask
+ */
+uint8_t mma_wait_event(void);
+
+/**
+ * @function mma_sample_period_us
+ * @brief  	 Time between two samples at the configured data rate
+ * @param    none
+ * @return   sample period in microseconds
+ */
+uint32_t mma_sample_period_us(void);
+
+/**
+ * @function mma_stream_start
+ * @brief  	 Start interrupt driven acquisition. Each data ready (or FIFO
+ * 			 watermark) interrupt reads the new samples with DMA: in FIFO
+ * 			 mode F_STATUS then all F_CNT stored samples in one burst,
+ * 			 starting with the samples already stored (mma_fifo_drain).
+ * 			 The completion interrupt decimates the time stamped samples
+ * 			 to MMA_STREAM_RATE_HZ, pushes them into ring and reads again
+ * 			 while the sensor still asserts its interrupt, so the FIFO
+ * 			 never stays above the watermark.
+ * 			 The sensor must already be configured at 800, 400 or 50 Hz,
+ * 			 with the FIFO enabled when fifo is not 0.
+ * @param    1. ring	destination of the samples, consumed by the main loop
+ * 			 2. fifo	1 to read on FIFO watermark, 0 on data ready
+ * @return   1 on success, 0 if the data rate has no decimation to the
+ * 			 stream rate or the interrupts could not be set up
+ */
+int mma_stream_start(struct sample_ring *ring, uint8_t fifo);
+
+/**
+ * @function mma_stream_stop
+ * @brief  	 Stop the interrupt driven acquisition and wait for the read
+ * 			 in progress, if any
+ * @param    none
+ * @return   none
  */
-void calibrate(int16_t *x, int16_t *y, int16_t *z, int *x_avg, int *y_avg, int *z_avg);
+void mma_stream_stop(void);
 
 #endif /* MMA8451_H_ */
@@ -0,0 +1,101 @@
+/**@file: ring.c
+ * @brief: Lock free single producer / single consumer ring of acceleration
+ *			samples. The producer (acquisition interrupt) only writes head,
+ *			the consumer (main loop) only writes tail, so no interrupt
+ *			masking is needed on either side.
+ *			ring_init clears the ring and its counters
+ *			ring_put / ring_get add and remove one sample
+ *			ring_get_block removes a contiguous batch of samples
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ */
+
+#include "ring.h"
+
+/**
+ * @function ring_init
+ * @brief  	 Empty the ring and clear its counters. Must be called before
+ * 			 the producer starts.
+ * @param    r	ring to initialize
+ * @return   none
+ */
+void ring_init(sample_ring_t *r){
+	r->head = 0;
+	r->tail = 0;
+	r->overflows = 0;
+	r->high_water = 0;
+}
+
+/**
+ * @function ring_put
+ * @brief  	 Producer side: append a sample, or count an overflow when
+ * 			 the ring is full.
+ * @param    1. r	ring
+ * 			 2. s	sample to append
+ * @return   1 if stored, 0 if dropped
+ */
+int ring_put(sample_ring_t *r, const mma_sample_t *s){
+	uint32_t head = r->head;
+	uint32_t used = head - r->tail;
+
+	if(used >= SAMPLE_RING_SIZE){
+		r->overflows++;
+		return 0;
+	}
+	r->buf[head & SAMPLE_RING_MASK] = *s;
+	RING_BARRIER();						//Sample visible before the new head
+	r->head = head + 1;
+
+	if((used + 1) > r->high_water){
+		r->high_water = used + 1;
+	}
+	return 1;
+}
+
+/**
+ * @function ring_get
+ * @brief  	 Consumer side: remove the oldest sample
+ * @param    1. r	ring
+ * 			 2. s	storage for the sample
+ * @return   1 if a sample was removed, 0 if the ring is empty
+ */
+int ring_get(sample_ring_t *r, mma_sample_t *s){
+	return ring_get_block(r, s, 1);
+}
+
+/**
+ * @function ring_get_block
+ * @brief  	 Consumer side: remove up to max of the oldest samples
+ * @param    1. r	ring
+ * 			 2. out	storage for the samples, oldest first
+ * 			 3. max	capacity of out
+ * @return   number of samples removed
+ */
+uint32_t ring_get_block(sample_ring_t *r, mma_sample_t *out, uint32_t max){
+	uint32_t tail = r->tail;
+	uint32_t count = r->head - tail;
+
+	if(count > max){
+		count = max;
+	}
+	RING_BARRIER();						//Head read before the samples
+	for(uint32_t i = 0; i < count; i++){
+		out[i] = r->buf[(tail + i) & SAMPLE_RING_MASK];
+	}
+	RING_BARRIER();						//Samples copied before the slots are freed
+	r->tail = tail + count;
+	return count;
+}
+
+/**
+ * @function ring_count
+ * @brief  	 Number of samples waiting in the ring
+ * @param    r	ring
+ * @return   fill level
+ */
+uint32_t ring_count(const sample_ring_t *r){
+	return r->head - r->tail;
+}
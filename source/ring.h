@@ -0,0 +1,88 @@
+/**@file: ring.h
+ * @brief: Lock free single producer / single consumer ring of acceleration
+ *			samples. The producer (acquisition interrupt) only writes head,
+ *			the consumer (main loop) only writes tail, so no interrupt
+ *			masking is needed on either side.
+ *			ring_init clears the ring and its counters
+ *			ring_put / ring_get add and remove one sample
+ *			ring_get_block removes a contiguous batch of samples
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: MCUXpresso IDE and FRDM-KL25Z Development Board
+ * @Credits: Embedded Systems Fundamentals with Arm Cortex-M based Microcontrollers by Alexander G.Dean
+ */
+#ifndef RING_H_
+#define RING_H_
+
+#include <stdint.h>
+#include "mma8451.h"
+
+#define SAMPLE_RING_SIZE	64			//Must be a power of 2
+#define SAMPLE_RING_MASK	(SAMPLE_RING_SIZE - 1)
+
+#if (SAMPLE_RING_SIZE & SAMPLE_RING_MASK) != 0
+#error "SAMPLE_RING_SIZE must be a power of 2"
+#endif
+
+//Orders the sample copy and the index update (compiler and bus)
+#ifndef RING_BARRIER
+#define RING_BARRIER()		__DMB()
+#endif
+
+//head and tail run freely, the slot is index & SAMPLE_RING_MASK
+typedef struct sample_ring{
+	mma_sample_t buf[SAMPLE_RING_SIZE];
+	volatile uint32_t head;				//Written by the producer only
+	volatile uint32_t tail;				//Written by the consumer only
+	volatile uint32_t overflows;		//Samples dropped because the ring was full
+	volatile uint32_t high_water;		//Largest fill level seen by the producer
+}sample_ring_t;
+
+/**
+ * @function ring_init
+ * @brief  	 Empty the ring and clear its counters. Must be called before
+ * 			 the producer starts.
+ * @param    r	ring to initialize
+ * @return   none
+ */
+void ring_init(sample_ring_t *r);
+
+/**
+ * @function ring_put
+ * @brief  	 Producer side: append a sample, or count an overflow when
+ * 			 the ring is full.
+ * @param    1. r	ring
+ * 			 2. s	sample to append
+ * @return   1 if stored, 0 if dropped
+ */
+int ring_put(sample_ring_t *r, const mma_sample_t *s);
+
+/**
+ * @function ring_get
+ * @brief  	 Consumer side: remove the oldest sample
+ * @param    1. r	ring
+ * 			 2. s	storage for the sample
+ * @return   1 if a sample was removed, 0 if the ring is empty
+ */
+int ring_get(sample_ring_t *r, mma_sample_t *s);
+
+/**
+ * @function ring_get_block
+ * @brief  	 Consumer side: remove up to max of the oldest samples
+ * @param    1. r	ring
+ * 			 2. out	storage for the samples, oldest first
+ * 			 3. max	capacity of out
+ * @return   number of samples removed
+ */
+uint32_t ring_get_block(sample_ring_t *r, mma_sample_t *out, uint32_t max);
+
+/**
+ * @function ring_count
+ * @brief  	 Number of samples waiting in the ring
+ * @param    r	ring
+ * @return   fill level
+ */
+uint32_t ring_count(const sample_ring_t *r);
+
+#endif /* RING_H_ */
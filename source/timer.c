@@ -1,5 +1,8 @@
 /**@file: timer.c
  * @brief: the function is used to set delay of the of msec
+ *			now_us / now_cycles: wrap safe time stamps from Ticks and SysTick->VAL
+ *			delay_us / delay_cycles: sub millisecond busy waits
+ *			timer_clock_changed: follows a new core clock (e.g. VLPR)
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -12,25 +15,86 @@
 #include "timer.h"
 
 ticktime_t Ticks;
+uint32_t timer_cycles_per_us = 48;
+
+static tick_hook hooks[TIMER_MAX_HOOKS];
+static uint8_t hook_count = 0;
+static clock_hook clock_hooks[TIMER_MAX_CLOCK_HOOKS];
+static uint8_t clock_hook_count = 0;
+static uint32_t reset_us = 0;
+
+//Time stamps are counted from the last clock change
+static uint32_t cycles_per_ms = 48000;		//SysTick counts per tick, LOAD + 1
+static ticktime_t tick_base = 0;			//Ticks at the last clock change
+static uint32_t us_base = 0;				//now_us() at the last clock change
+static uint32_t cycle_base = 0;				//now_cycles() at the last clock change
+
+static void timer_sample(ticktime_t *ticks, uint32_t *elapsed);
+
+/**
+ * @func	timer_set_rate()
+ * @brief	Conversions for the core clock in SystemCoreClock
+ * @param	none
+ * @return	none
+ */
+static void timer_set_rate(void){
+	cycles_per_ms = SystemCoreClock / 1000;
+	timer_cycles_per_us = (SystemCoreClock + 999999) / 1000000;
+}
 
 /**
  * @brief: this Init function is used to configure the clock
  * by loading the counter value as per the requirement.
- * Here 10msec has been taken as 1 count value, hence load
- * value becomes (0.01 x 48000000)/16
+ * Here 1msec has been taken as 1 count value, SysTick runs
+ * from the core clock so each count is one core cycle and
+ * the load value comes from SystemCoreClock.
  *
  * @param: NULL
  * @return: NULL
  */
 void init_systick(void){
-	SysTick->LOAD = (48000000/16/1000);				//Interrupt at every 1ms
+	timer_set_rate();
+	SysTick->LOAD = cycles_per_ms - 1;				//Interrupt at every 1ms
 	NVIC_SetPriority(SysTick_IRQn, 3);
 	SysTick->VAL = 0;								//Force reloading the counter value
-	SysTick->CTRL = SysTick_CTRL_TICKINT_Msk |		//Enable Systick timer
+	SysTick->CTRL = SysTick_CTRL_CLKSOURCE_Msk |	//Core clock
+					SysTick_CTRL_TICKINT_Msk |		//Enable Systick timer
 					SysTick_CTRL_ENABLE_Msk;
 	NVIC_EnableIRQ(SysTick_IRQn);					//Enable Systick timer interrupt
 }
 
+/**
+ * @func	timer_clock_changed()
+ * @brief	Reprogram the SysTick reload value and the cycle conversions
+ * 			for the core clock in SystemCoreClock, then run the clock
+ * 			hooks (I2C divider). Call once after switching clock
+ * 			configuration (e.g. BOARD_BootClockVLPR). The time stamps
+ * 			stay continuous, the current millisecond restarts.
+ * @param	none
+ * @return	none
+ */
+void timer_clock_changed(void){
+	uint32_t primask = __get_PRIMASK();
+	ticktime_t ticks;
+	uint32_t elapsed;
+
+	__disable_irq();
+	//Counts of the old clock so far, then restart the millisecond
+	timer_sample(&ticks, &elapsed);
+	us_base += ((ticks - tick_base) * 1000) + ((elapsed * 1000) / cycles_per_ms);
+	cycle_base += ((ticks - tick_base) * cycles_per_ms) + elapsed;
+	tick_base = ticks;
+	timer_set_rate();
+	SysTick->LOAD = cycles_per_ms - 1;
+	SysTick->VAL = 0;								//Reload now with the new value
+	__set_PRIMASK(primask);
+
+	//Peripherals may wait for their interrupts, run with them enabled
+	for(uint8_t i = 0; i < clock_hook_count; i++){
+		clock_hooks[i]();
+	}
+}
+
 /**
  * @brief: function checks if the capacitive sensor's
  * value if greater than the threshold.
@@ -52,17 +116,18 @@ ticktime_t now(){
  * @return: returns ticks since the last call to Reset_Timer()
  */
 void reset_timer(){
-	SysTick->VAL = 0;								//Resetting the counter to 0
+	reset_us = now_us();							//SysTick keeps running
 }
 
 /**
- * @func	getTicks()
- * @brief	Gives the number of ticks since the boot of the program
- * @param	none
- * @return	ticktime_t	Number of ticks
+ * @brief: function return the time passed since the last
+ * call to reset
+ *
+ * @param: NULL
+ * @return: returns microseconds since the last call to reset_timer()
  */
 ticktime_t get_timer(){
-	return SysTick->VAL;							//Return current counter
+	return now_us() - reset_us;
 }
 
 /**
@@ -74,6 +139,10 @@ ticktime_t get_timer(){
  */
 void SysTick_Handler(){
 	Ticks++;				//Increment ticks on each interrupt
+
+	for(uint8_t i = 0; i < hook_count; i++){
+		hooks[i]();
+	}
 }
 
 /**
@@ -92,3 +161,127 @@ void delay(uint16_t delay){
 		__asm volatile ("nop");
 	}
 }
+
+/**
+ * @func	timer_sample()
+ * @brief	Consistent snapshot of the Ticks counter and SysTick->VAL.
+ * 			Also valid with the SysTick interrupt masked for less than
+ * 			a millisecond.
+ * @param	ticks	milliseconds elapsed
+ * 			elapsed	SysTick counts elapsed in the current millisecond
+ * @return	none
+ */
+static void timer_sample(ticktime_t *ticks, uint32_t *elapsed){
+	ticktime_t t;
+	uint32_t val, val2, pending;
+
+	//Retry if the counter reloaded or Ticks moved while sampling
+	do{
+		t = Ticks;
+		val = SysTick->VAL;
+		pending = SCB->ICSR & SCB_ICSR_PENDSTSET_Msk;
+		val2 = SysTick->VAL;
+	}while((t != Ticks) || (val2 > val));
+
+	//Reload happened but the interrupt has not counted it yet
+	if(pending){
+		t++;
+	}
+	*ticks = t;
+	*elapsed = SysTick->LOAD - val;
+}
+
+/**
+ * @func	now_us()
+ * @brief	Microseconds since boot, built from the millisecond Ticks and
+ * 			the SysTick counter. Also valid with the SysTick interrupt
+ * 			masked for less than a millisecond.
+ * @param	none
+ * @return	uint32_t	time in microseconds (wraps after ~71 minutes)
+ */
+uint32_t now_us(void){
+	ticktime_t ticks;
+	uint32_t elapsed;
+
+	timer_sample(&ticks, &elapsed);
+	return us_base + ((ticks - tick_base) * 1000) + ((elapsed * 1000) / cycles_per_ms);
+}
+
+/**
+ * @func	now_cycles()
+ * @brief	Core clock cycles since boot, for benchmarking and short
+ * 			delays. Resolution is one core cycle, each millisecond counts
+ * 			the cycles of the clock it ran at.
+ * @param	none
+ * @return	uint32_t	cycles (wraps after ~89 seconds at 48 MHz)
+ */
+uint32_t now_cycles(void){
+	ticktime_t ticks;
+	uint32_t elapsed;
+
+	timer_sample(&ticks, &elapsed);
+	return cycle_base + ((ticks - tick_base) * cycles_per_ms) + elapsed;
+}
+
+/**
+ * @func	delay_cycles()
+ * @brief	Busy wait at least the given number of core cycles. The call
+ * 			itself costs a few tens of cycles, shorter waits round up.
+ * @param	cycles	cycles to wait, less than 2^31
+ * @return	none
+ */
+void delay_cycles(uint32_t cycles){
+	uint32_t start = now_cycles();
+
+	//Unsigned difference is wrap safe
+	while((now_cycles() - start) < cycles){
+	}
+}
+
+/**
+ * @func	delay_us()
+ * @brief	Busy wait at least the given number of microseconds
+ * @param	us	microseconds to wait, less than 44 seconds at 48 MHz
+ * @return	none
+ */
+void delay_us(uint32_t us){
+	delay_cycles(us * timer_cycles_per_us);
+}
+
+/**
+ * @func	timer_add_hook()
+ * @brief	Register a function called from the SysTick interrupt
+ * 			every millisecond
+ * @param	hook	function to be called
+ * @return	1 if registered, 0 if all hook slots are used
+ */
+int timer_add_hook(tick_hook hook){
+	if(hook_count >= TIMER_MAX_HOOKS){
+		return 0;
+	}
+	hooks[hook_count] = hook;
+	hook_count++;
+	return 1;
+}
+
+/**
+ * @func	timer_add_clock_hook()
+ * @brief	Register a function called by timer_clock_changed() after
+ * 			the SysTick has been reprogrammed, with interrupts enabled.
+ * 			Registering the same function again has no effect.
+ * @param	hook	function to be called
+ * @return	1 if registered, 0 if all hook slots are used
+ */
+int timer_add_clock_hook(clock_hook hook){
+	for(uint8_t i = 0; i < clock_hook_count; i++){
+		if(clock_hooks[i] == hook){
+			return 1;
+		}
+	}
+	if(clock_hook_count >= TIMER_MAX_CLOCK_HOOKS){
+		return 0;
+	}
+	clock_hooks[clock_hook_count] = hook;
+	clock_hook_count++;
+	return 1;
+}
@@ -1,5 +1,8 @@
 /**@file: timer.h
  * @brief: the function is used to set delay of the of msec
+ *			now_us / now_cycles: wrap safe time stamps from Ticks and SysTick->VAL
+ *			delay_us / delay_cycles: sub millisecond busy waits
+ *			timer_clock_changed: follows a new core clock (e.g. VLPR)
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -17,17 +20,43 @@
 
 typedef uint32_t ticktime_t;
 
+//SysTick runs from the core clock, one count per core cycle. The reload
+//value and the conversions follow SystemCoreClock, see timer_clock_changed.
+#define NS_TO_CYCLES(ns)	((((ns) * timer_cycles_per_us) + 999) / 1000)	//Rounded up
+#define TIMER_MAX_HOOKS		4
+#define TIMER_MAX_CLOCK_HOOKS	2
+
+extern uint32_t timer_cycles_per_us;		//Core cycles per microsecond, rounded up
+
+//Function called from the SysTick interrupt every millisecond
+typedef void (*tick_hook)(void);
+
+//Function called by timer_clock_changed to follow a new clock
+typedef void (*clock_hook)(void);
+
 /**
  * @brief: this Init function is used to configure the clock
  * by loading the counter value as per the requirement.
- * Here 10msec has been taken as 1 count value, hence load
- * value becomes (0.01 x 48000000)/16
+ * Here 1msec has been taken as 1 count value, the load value
+ * comes from SystemCoreClock.
  *
  * @param: NULL
  * @return: NULL
  */
 void init_systick(void);
 
+/**
+ * @func	timer_clock_changed()
+ * @brief	Reprogram the SysTick reload value and the cycle conversions
+ * 			for the core clock in SystemCoreClock, then run the clock
+ * 			hooks (I2C divider). Call once after switching clock
+ * 			configuration (e.g. BOARD_BootClockVLPR). The time stamps
+ * 			stay continuous, the current millisecond restarts.
+ * @param	none
+ * @return	none
+ */
+void timer_clock_changed(void);
+
 /**
  * @brief: function checks if the capacitive sensor's
  * value if greater than the threshold.
@@ -52,7 +81,7 @@ void reset_timer();
  * call to reset
  *
  * @param: NULL
- * @return: returns ticks since the last call to Reset_Timer()
+ * @return: returns microseconds since the last call to reset_timer()
  */
 ticktime_t get_timer();
 
@@ -67,4 +96,60 @@ ticktime_t getTicks();
 
 void delay(uint16_t delay);
 
+/**
+ * @func	now_us()
+ * @brief	Microseconds since boot, built from the millisecond Ticks and
+ * 			the SysTick counter. Also valid with the SysTick interrupt
+ * 			masked for less than a millisecond.
+ * @param	none
+ * @return	uint32_t	time in microseconds (wraps after ~71 minutes)
+ */
+uint32_t now_us(void);
+
+/**
+ * @func	now_cycles()
+ * @brief	Core clock cycles since boot, for benchmarking and short
+ * 			delays. Resolution is one core cycle, each millisecond counts
+ * 			the cycles of the clock it ran at.
+ * @param	none
+ * @return	uint32_t	cycles (wraps after ~89 seconds at 48 MHz)
+ */
+uint32_t now_cycles(void);
+
+/**
+ * @func	delay_cycles()
+ * @brief	Busy wait at least the given number of core cycles. The call
+ * 			itself costs a few tens of cycles, shorter waits round up.
+ * @param	cycles	cycles to wait, less than 2^31
+ * @return	none
+ */
+void delay_cycles(uint32_t cycles);
+
+/**
+ * @func	delay_us()
+ * @brief	Busy wait at least the given number of microseconds
+ * @param	us	microseconds to wait, less than 44 seconds at 48 MHz
+ * @return	none
+ */
+void delay_us(uint32_t us);
+
+/**
+ * @func	timer_add_hook()
+ * @brief	Register a function called from the SysTick interrupt
+ * 			every millisecond
+ * @param	hook	function to be called
+ * @return	1 if registered, 0 if all hook slots are used
+ */
+int timer_add_hook(tick_hook hook);
+
+/**
+ * @func	timer_add_clock_hook()
+ * @brief	Register a function called by timer_clock_changed() after
+ * 			the SysTick has been reprogrammed, with interrupts enabled.
+ * 			Registering the same function again has no effect.
+ * @param	hook	function to be called
+ * @return	1 if registered, 0 if all hook slots are used
+ */
+int timer_add_clock_hook(clock_hook hook);
+
 #endif /* TIMER_H_ */
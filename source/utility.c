@@ -1,5 +1,8 @@
 /**@file: utility.c
  * @brief: the function used to detect step takes by the person
+ *			integer only: isqrt32 replaces sqrt
+ *			step_detector: streaming detector run by step_detect
+ *			step_adaptive: peak detector with envelope based thresholds
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -9,51 +12,237 @@
 
 #include "utility.h"
 
+#define STEP_BENCH_N		256
 
-#define	STEP_THRES			2000
-#define STEP_CHANGE_THRES	700
+/**
+ * @function step_detector_init
+ * @brief  	 Reset a detector for a stream at GAIT_FS_HZ, the rate the
+ * 			 band-pass is designed for. The step thresholds adapt to the
+ * 			 signal, see step_adaptive.
+ * @param    1. det		detector state
+ * 			 2. tuning	thresholds, NULL for STEP_MIN_SWING,
+ * 			 			STEP_MIN_INTERVAL_US and a one second decay
+ * @return   none
+ */
+void step_detector_init(step_detector *det, const step_tuning *tuning){
+	dsp_biquad_init_q15(&det->bandpass, GAIT_BANDPASS_STAGES, gait_bandpass_coeffs,
+						det->bandpass_state, GAIT_BANDPASS_SHIFT);
+	det->primed = false;
+	step_adaptive_init(&det->peak, GAIT_FS_HZ);
+	if(tuning != NULL){
+		det->peak.min_swing = tuning->min_swing;
+		det->peak.min_interval_us = tuning->min_interval_us;
+		det->peak.decay_shift = (tuning->decay_shift < STEP_MAX_DECAY_SHIFT) ? tuning->decay_shift : STEP_MAX_DECAY_SHIFT;
+	}
+}
+
+/**
+ * @function step_detector_feed
+ * @brief  	 Feed one sample to a detector
+ * @param    1. det	detector state
+ * 			 2. s	acceleration sample
+ * @return   1 if the sample completes a step, 0 otherwise
+ */
+uint8_t step_detector_feed(step_detector *det, const mma_sample_t *s){
+	return step_detect(det, s, 1, NULL, 0) != 0;
+}
+
+/**
+ * @function step_detect
+ * @brief  	 Run a detector over a block of time stamped samples. No
+ * 			 acquisition or waiting, the caller provides the samples.
+ * 			 Magnitudes and band-pass are computed a block at a time.
+ * @param    1. det			detector state
+ * 			 2. s			acceleration samples, oldest first
+ * 			 3. n			number of samples
+ * 			 4. events		steps found, can be NULL
+ * 			 5. max_events	room in events
+ * @return   steps found in the block (can exceed max_events)
+ */
+uint16_t step_detect(step_detector *det, const mma_sample_t *s, uint16_t n,
+					step_event *events, uint16_t max_events){
+	int16_t mag[STEP_BLOCK_LEN];
+	uint16_t steps = 0;
+
+	for(uint16_t base = 0; base < n; base += STEP_BLOCK_LEN){
+		uint16_t len = ((n - base) < STEP_BLOCK_LEN) ? (n - base) : STEP_BLOCK_LEN;
 
-extern int16_t x[50];
-extern int16_t y[50];
-extern int16_t z[50];
-extern int16_t total_vect[50];
-extern int16_t avg[50];
-extern int x_avg, y_avg, z_avg;
-bool flag = false;
+		//Magnitude does not depend on how the device is worn, the band-pass
+		//removes gravity and keeps the gait band
+		dsp_magnitude_q15(&s[base], mag, len);
+		if(!det->primed){
+			det->bandpass_state[0] = mag[0];	//Start as if 1g had always been there
+			det->bandpass_state[1] = mag[0];
+			det->primed = true;
+		}
+		dsp_biquad_q15(&det->bandpass, mag, mag, len);
 
-extern int16_t acc_x, acc_y, acc_z;
+		for(uint16_t i = 0; i < len; i++){
+			if(step_adaptive_feed_mag(&det->peak, mag[i], s[base + i].ts)){
+				if((events != NULL) && (steps < max_events)){
+					events[steps].ts = s[base + i].ts;
+					events[steps].index = base + i;
+				}
+				steps++;
+			}
+		}
+	}
+	return steps;
+}
+
+/**
+ * @function step_adaptive_init
+ * @brief  	 Reset an adaptive detector. The envelopes decay with a time
+ * 			 constant of about one second at the given sample rate.
+ * @param    1. det			detector state
+ * 			 2. rate_hz		sample rate of the stream
+ * @return   none
+ */
+void step_adaptive_init(step_adaptive *det, uint16_t rate_hz){
+	uint8_t shift = 0;
+
+	while((shift < STEP_MAX_DECAY_SHIFT) && ((1U << (shift + 1)) <= rate_hz)){
+		shift++;
+	}
+	det->decay_shift = shift;
+	det->min_swing = STEP_MIN_SWING;
+	det->min_interval_us = STEP_MIN_INTERVAL_US;
+	det->env_max = 0;
+	det->env_min = 0;
+	det->last_step_us = 0;
+	det->has_step = false;
+	det->primed = false;
+	det->above = false;
+}
 
 /**
- * @function step detect
- * @brief  	 It implements the step detection algorithm based on
- * 			 the readings of the MMA8451 accelerometer.
- * @param    count		 step count to incremented
- * 			 i      	index for the buffer
- * @return   count		It determines the new step count in case if
- * 						step is taken or not.
+ * @function step_adaptive_feed
+ * @brief  	 Feed one time stamped sample to an adaptive detector
+ * @param    1. det	detector state
+ * 			 2. s	acceleration sample
+ * @return   1 if the sample completes a step, 0 otherwise
  */
-uint16_t step_detect(uint16_t count, int i){
-	read_full_xyz();
+uint8_t step_adaptive_feed(step_adaptive *det, const mma_sample_t *s){
+	int32_t x = s->x, y = s->y, z = s->z;
 
-	total_vect[i] = sqrt(((acc_x - x_avg) * (acc_x - x_avg)) + ((acc_y - y_avg) *
-						(acc_y - y_avg)) + ((acc_z - z_avg) * (acc_z - z_avg)));
+	return step_adaptive_feed_mag(det, (int32_t)isqrt32((uint32_t)(x * x) + (uint32_t)(y * y) + (uint32_t)(z * z)), s->ts);
+}
 
-	avg[i] = (total_vect[i] + total_vect[i - 1]) / 2 ;
+/**
+ * @function step_adaptive_feed_mag
+ * @brief  	 Feed one magnitude, raw or band-pass filtered, to an adaptive
+ * 			 detector. A step is a rising crossing of the middle of the
+ * 			 envelopes (with hysteresis) at least min_interval_us after the
+ * 			 previous one.
+ * @param    1. det		detector state
+ * 			 2. value	magnitude in 2g counts, can be negative
+ * 			 3. ts		time stamp of the sample in us
+ * @return   1 if the sample completes a step, 0 otherwise
+ */
+uint8_t step_adaptive_feed_mag(step_adaptive *det, int32_t value, uint32_t ts){
+	int32_t mag = value * 256;			//Q8
+	int32_t mid, hyst;
+	uint8_t step = 0;
 
-	delay(100);
-	if(((avg[i]>STEP_THRES))&& (flag == false))
-			{
-		count++;
-		flag = true;
+	if(!det->primed){
+		det->env_max = mag;
+		det->env_min = mag;
+		det->primed = true;
+		return 0;
 	}
-	else if((avg[i] > STEP_THRES) && (flag == true)){
-		//Don't count
-		__asm volatile ("nop");
+
+	//Envelopes follow peaks at once and relax towards the signal
+	if(mag > det->env_max){
+		det->env_max = mag;
+	}
+	else{
+		det->env_max -= (det->env_max - mag) >> det->decay_shift;
+	}
+	if(mag < det->env_min){
+		det->env_min = mag;
+	}
+	else{
+		det->env_min += (mag - det->env_min) >> det->decay_shift;
+	}
+
+	//Too little movement, standing still or noise
+	if((det->env_max - det->env_min) < ((int32_t)det->min_swing << 8)){
+		det->above = false;
+		return 0;
+	}
+
+	mid = (det->env_max + det->env_min) / 2;
+	hyst = (det->env_max - det->env_min) / 8;
+
+	if(!det->above && (mag > (mid + hyst))){
+		det->above = true;
+		if(!det->has_step || ((ts - det->last_step_us) >= det->min_interval_us)){
+			step = 1;
+			det->last_step_us = ts;
+			det->has_step = true;
+		}
+	}
+	else if(det->above && (mag < (mid - hyst))){
+		det->above = false;
+	}
+	return step;
+}
+
+/**
+ * @function isqrt32
+ * @brief  	 Integer square root (floor), shift and subtract only
+ * @param    n		value
+ * @return   floor(sqrt(n))
+ */
+uint32_t isqrt32(uint32_t n){
+	uint32_t root = 0;
+	uint32_t bit = 1UL << 30;
+
+	while(bit > n){
+		bit >>= 2;
+	}
+	while(bit != 0){
+		if(n >= root + bit){
+			n -= root + bit;
+			root = (root >> 1) + bit;
+		}
+		else{
+			root >>= 1;
+		}
+		bit >>= 2;
+	}
+	return root;
+}
+
+#ifdef STEP_BENCHMARK
+#include <math.h>
+
+/**
+ * @function step_benchmark
+ * @brief  	 Measure the magnitude computation of step_detect with the
+ * 			 soft float sqrt() it used to call and with isqrt32()
+ * @param    float_cycles	core cycles per sample with sqrt()
+ * 			 int_cycles		core cycles per sample with isqrt32()
+ * @return   none
+ */
+void step_benchmark(uint32_t *float_cycles, uint32_t *int_cycles){
+	volatile int16_t sink;
+	uint32_t start;
+	int32_t d;
+
+	start = now_cycles();
+	for(int i = 0; i < STEP_BENCH_N; i++){
+		d = (i * 37) - 4096;
+		sink = sqrt((d * d) + (d * d) + (d * d));
 	}
+	*float_cycles = (now_cycles() - start) / STEP_BENCH_N;
 
-	if((((avg[i] - avg[i-1]) > STEP_CHANGE_THRES)||
-		((avg[i-1] - avg[i]) > STEP_CHANGE_THRES)) && (flag == true)){
-		flag = false;
+	start = now_cycles();
+	for(int i = 0; i < STEP_BENCH_N; i++){
+		d = (i * 37) - 4096;
+		sink = isqrt32((uint32_t)(d * d) + (uint32_t)(d * d) + (uint32_t)(d * d));
 	}
-	return count;
+	*int_cycles = (now_cycles() - start) / STEP_BENCH_N;
+	(void)sink;
 }
+#endif
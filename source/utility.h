@@ -1,5 +1,8 @@
 /**@file: utility.h
  * @brief: the function used to detect step takes by the person
+ *			integer only: isqrt32 replaces sqrt
+ *			step_detector: streaming detector run by step_detect
+ *			step_adaptive: peak detector with envelope based thresholds
  *
  * @author: Swapnil Ghonge
  * @date: May 2nd 2022
@@ -10,20 +13,138 @@
 #define UTILITY_H_
 
 #include <stdbool.h>
-#include <math.h>
 #include "mma8451.h"
+#include "dsp.h"
 #include "timer.h"
 #include "i2c.h"
 
+#define STEP_BLOCK_LEN		10			//Samples handed to step_detect() at once (200 ms at 50 Hz)
+
+//One detected step
+typedef struct{
+	uint32_t ts;						//Time stamp of the sample completing the step
+	uint16_t index;						//Position of that sample in the block
+}step_event;
+
+#define STEP_MIN_SWING		400			//Envelope swing below which nobody walks (~0.1g)
+#define STEP_MIN_INTERVAL_US	250000	//Fastest cadence accepted (4 steps/s)
+#define STEP_MAX_DECAY_SHIFT	15
+
+//Thresholds of a step detector, see step_adaptive
+typedef struct{
+	uint16_t min_swing;					//Minimum env_max - env_min (counts) to detect
+	uint32_t min_interval_us;			//Minimum time between two steps
+	uint8_t decay_shift;				//Envelope time constant is 2^decay_shift samples
+}step_tuning;
+
+//State of one adaptive peak detector. Magnitudes and envelopes are Q8.
+typedef struct{
+	int32_t env_max;					//Upper envelope, instant attack, slow decay
+	int32_t env_min;					//Lower envelope, instant attack, slow decay
+	uint8_t decay_shift;				//Envelope time constant is 2^decay_shift samples
+	uint16_t min_swing;					//Minimum env_max - env_min (counts) to detect
+	uint32_t min_interval_us;			//Minimum time between two steps
+	uint32_t last_step_us;
+	bool has_step;						//last_step_us is valid
+	bool primed;						//Envelopes are initialized
+	bool above;							//Signal is above the upper threshold
+}step_adaptive;
+
+//State of one streaming step detector: magnitude, gait band-pass, then
+//adaptive peak detection, at GAIT_FS_HZ
+typedef struct{
+	dsp_biquad_q15_t bandpass;
+	int16_t bandpass_state[4 * GAIT_BANDPASS_STAGES];
+	bool primed;						//Band-pass settled on the first magnitude
+	step_adaptive peak;					//Envelope thresholds on the filtered magnitude
+}step_detector;
+
+/**
+ * @function step_detector_init
+ * @brief  	 Reset a detector for a stream at GAIT_FS_HZ, the rate the
+ * 			 band-pass is designed for. The step thresholds adapt to the
+ * 			 signal, see step_adaptive.
+ * @param    1. det		detector state
+ * 			 2. tuning	thresholds, NULL for STEP_MIN_SWING,
+ * 			 			STEP_MIN_INTERVAL_US and a one second decay
+ * @return   none
+ */
+void step_detector_init(step_detector *det, const step_tuning *tuning);
+
+/**
+ * @function step_detector_feed
+ * @brief  	 Feed one sample to a detector
+ * @param    1. det	detector state
+ * 			 2. s	acceleration sample
+ * @return   1 if the sample completes a step, 0 otherwise
+ */
+uint8_t step_detector_feed(step_detector *det, const mma_sample_t *s);
+
+/**
+ * @function step_detect
+ * @brief  	 Run a detector over a block of time stamped samples. No
+ * 			 acquisition or waiting, the caller provides the samples.
+ * 			 Magnitudes and band-pass are computed a block at a time.
+ * @param    1. det			detector state
+ * 			 2. s			acceleration samples, oldest first
+ * 			 3. n			number of samples
+ * 			 4. events		steps found, can be NULL
+ * 			 5. max_events	room in events
+ * @return   steps found in the block (can exceed max_events)
+ */
+uint16_t step_detect(step_detector *det, const mma_sample_t *s, uint16_t n,
+					step_event *events, uint16_t max_events);
+
+/**
+ * @function step_adaptive_init
+ * @brief  	 Reset an adaptive detector. The envelopes decay with a time
+ * 			 constant of about one second at the given sample rate.
+ * @param    1. det			detector state
+ * 			 2. rate_hz		sample rate of the stream
+ * @return   none
+ */
+void step_adaptive_init(step_adaptive *det, uint16_t rate_hz);
+
+/**
+ * @function step_adaptive_feed
+ * @brief  	 Feed one time stamped sample to an adaptive detector
+ * @param    1. det	detector state
+ * 			 2. s	acceleration sample
+ * @return   1 if the sample completes a step, 0 otherwise
+ */
+uint8_t step_adaptive_feed(step_adaptive *det, const mma_sample_t *s);
+
+/**
+ * @function step_adaptive_feed_mag
+ * @brief  	 Feed one magnitude, raw or band-pass filtered, to an adaptive
+ * 			 detector. A step is a rising crossing of the middle of the
+ * 			 envelopes (with hysteresis) at least min_interval_us after the
+ * 			 previous one.
+ * @param    1. det		detector state
+ * 			 2. value	magnitude in 2g counts, can be negative
+ * 			 3. ts		time stamp of the sample in us
+ * @return   1 if the sample completes a step, 0 otherwise
+ */
+uint8_t step_adaptive_feed_mag(step_adaptive *det, int32_t value, uint32_t ts);
+
+/**
+ * @function isqrt32
+ * @brief  	 Integer square root (floor), shift and subtract only
+ * @param    n		value
+ * @return   floor(sqrt(n))
+ */
+uint32_t isqrt32(uint32_t n);
+
+#ifdef STEP_BENCHMARK
 /**
- * @function detect_step
- * @brief  	 It implements the step detection algorithm based on
- * 			 the readings of the MMA8451 accelerometer.
- * @param    count	 step count to incremented
- * 			 i      	index for the buffer
- * @return   count		It determines the new step count in case if
- * 						step is taken or not.
+ * @function step_benchmark
+ * @brief  	 Measure the magnitude computation of step_detect with the
+ * 			 soft float sqrt() it used to call and with isqrt32()
+ * @param    float_cycles	core cycles per sample with sqrt()
+ * 			 int_cycles		core cycles per sample with isqrt32()
+ * @return   none
  */
-uint16_t step_detect(uint16_t count, int i);
+void step_benchmark(uint32_t *float_cycles, uint32_t *int_cycles);
+#endif
 
 #endif /* UTILITY_H_ */
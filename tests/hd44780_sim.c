@@ -0,0 +1,314 @@
+/**@file: hd44780_sim.c
+ * @brief: Model of the HD44780 16x2 LCD on the simulated port C, for the
+ *			host tests of lcd.c
+ *			8 bit interface at power on, 4 bit after the function set,
+ *			nibbles latched on the falling edge of E
+ *			instruction set: clear, home, entry mode, display control,
+ *			shift, function set, CGRAM / DDRAM address, data writes with
+ *			the address counter wrap of the 2 line display
+ *			busy flag and address counter reads, execution times
+ *			(37 us, 1.52 ms for clear and home): bytes started while the
+ *			controller is busy, short enable pulses and both sides
+ *			driving the data lines are counted
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
+ */
+
+#include <string.h>
+#include "host.h"
+#include "lcd.h"
+
+#define SIM_REG_NS			20			//Cost of one register access
+#define SIM_PWEH_NS			450			//Enable pulse width high
+#define SIM_EXEC_NS			37000ULL	//Most instructions and data writes
+#define SIM_HOME_NS			1520000ULL	//Clear and return home
+#define SIM_POWER_ON_FILL	'#'			//DDRAM before the first clear
+
+PORT_Type sim_portc;
+GPIO_Type sim_gpioc;
+sim_lcd_stats sim_lcd;
+
+static uint32_t out;					//Port C output latch
+static uint32_t shown_pdor;				//PDOR presented to the CPU
+static uint32_t drive;					//Data lines driven by the LCD
+static uint8_t e_high;
+static uint64_t e_rise_ns;
+static uint64_t access_ns;				//Time of the last register access
+static uint64_t busy_until_ns;
+
+static char ddram[0x80];
+static uint8_t ac;						//Address counter
+static uint8_t mode8;					//8 bit interface
+static uint8_t two_lines;
+static uint8_t increment;
+static uint8_t cgram;					//Data goes to CGRAM
+static uint8_t half;					//High nibble of a byte received
+static uint8_t high_nibble;
+static uint8_t read_phase;				//Next status nibble is AC3-0
+
+/**
+ * @function sim_nibble
+ * @brief  	 Nibble on DB7-DB4
+ * @param    pins	port C levels
+ * @return   nibble
+ */
+static uint8_t sim_nibble(uint32_t pins){
+	return ((pins & LCD_DB7) ? 8 : 0) | ((pins & LCD_DB6) ? 4 : 0) |
+		((pins & LCD_DB5) ? 2 : 0) | ((pins & LCD_DB4) ? 1 : 0);
+}
+
+/**
+ * @function sim_ac_step
+ * @brief  	 Move the address counter after a data write, the lines of
+ * 			 the 2 line display are 0x00-0x27 and 0x40-0x67
+ * @param    none
+ * @return   none
+ */
+static void sim_ac_step(void){
+	if(!two_lines){
+		ac = increment ? ((ac + 1) % 0x50) : ((ac + 0x4F) % 0x50);
+	}
+	else if(increment){
+		ac++;
+		ac = (ac == 0x28) ? 0x40 : ((ac == 0x68) ? 0x00 : ac);
+	}
+	else{
+		ac = (ac == 0x00) ? 0x67 : ((ac == 0x40) ? 0x27 : (ac - 1));
+	}
+}
+
+/**
+ * @function sim_execute
+ * @brief  	 Run an instruction or store a character
+ * @param    1. b		byte
+ * 			 2. rs		1 for data
+ * 			 3. when	time the byte was latched
+ * @return   none
+ */
+static void sim_execute(uint8_t b, uint8_t rs, uint64_t when){
+	uint64_t exec = SIM_EXEC_NS;
+
+	if(sim_lcd.on_byte){
+		sim_lcd.on_byte(b, rs);
+	}
+	if(rs){
+		sim_lcd.data++;
+		if(!cgram){
+			ddram[ac] = (char)b;
+			sim_ac_step();
+		}
+	}
+	else{
+		sim_lcd.commands++;
+		if(b & 0x80){							//Set DDRAM address
+			ac = b & 0x7F;
+			cgram = 0;
+			sim_lcd.addr_sets++;
+		}
+		else if(b & 0x40){						//Set CGRAM address
+			cgram = 1;
+		}
+		else if(b & 0x20){						//Function set
+			mode8 = (b & 0x10) ? 1 : 0;
+			two_lines = (b & 0x08) ? 1 : 0;
+		}
+		else if(b & 0x10){						//Cursor or display shift
+			if(!(b & 0x08)){
+				uint8_t inc = increment;
+
+				increment = (b & 0x04) ? 1 : 0;
+				sim_ac_step();
+				increment = inc;
+			}
+		}
+		else if(b & 0x08){						//Display control, nothing to model
+		}
+		else if(b & 0x04){						//Entry mode
+			increment = (b & 0x02) ? 1 : 0;
+		}
+		else if(b & 0x02){						//Return home
+			ac = 0;
+			cgram = 0;
+			exec = SIM_HOME_NS;
+		}
+		else if(b & 0x01){						//Clear display
+			memset(ddram, ' ', sizeof(ddram));
+			ac = 0;
+			cgram = 0;
+			increment = 1;
+			exec = SIM_HOME_NS;
+		}
+		else{									//0x00, high nibble of the first byte in 8 bit mode
+			exec = 0;
+		}
+	}
+	busy_until_ns = when + exec;
+}
+
+/**
+ * @function sim_e_rise
+ * @brief  	 Enable rising edge, a read puts the status on DB7-DB4
+ * @param    when	time of the edge
+ * @return   none
+ */
+static void sim_e_rise(uint64_t when){
+	e_rise_ns = when;
+	if(out & LCD_RW){
+		uint8_t status = ((when < busy_until_ns) ? 0x80 : 0) | ac;
+		uint8_t n = read_phase ? (status & 0x0F) : (status >> 4);
+
+		if(sim_gpioc.PDDR & LCD_DATA_MASK){
+			sim_lcd.contention++;
+		}
+		drive = LCD_NIBBLE_SET(n);
+	}
+}
+
+/**
+ * @function sim_e_fall
+ * @brief  	 Enable falling edge, latches a written nibble
+ * @param    when	time of the edge
+ * @return   none
+ */
+static void sim_e_fall(uint64_t when){
+	uint8_t rs = (out & LCD_RS) ? 1 : 0;
+	uint8_t n = sim_nibble(out);
+
+	if((when - e_rise_ns) < SIM_PWEH_NS){
+		sim_lcd.short_pulses++;
+	}
+	if(out & LCD_RW){
+		if(!read_phase){
+			sim_lcd.status_reads++;
+		}
+		read_phase ^= 1;
+		drive = 0;
+		return;
+	}
+	if(mode8){
+		if(when < busy_until_ns){
+			sim_lcd.early++;
+		}
+		sim_execute(n << 4, rs, when);			//DB3-DB0 are tied low
+	}
+	else if(!half){
+		if(when < busy_until_ns){
+			sim_lcd.early++;
+		}
+		high_nibble = n;
+		half = 1;
+	}
+	else{
+		half = 0;
+		sim_execute((high_nibble << 4) | n, rs, when);
+	}
+}
+
+/**
+ * @function sim_absorb
+ * @brief  	 Apply the write of the previous register access to the
+ * 			 port pins and follow the enable edges
+ * @param    none
+ * @return   none
+ */
+static void sim_absorb(void){
+	uint8_t e;
+
+	if(sim_gpioc.PDOR != shown_pdor){
+		out = sim_gpioc.PDOR;
+	}
+	out |= sim_gpioc.PSOR;
+	out &= ~sim_gpioc.PCOR;
+	out ^= sim_gpioc.PTOR;
+	sim_gpioc.PSOR = 0;
+	sim_gpioc.PCOR = 0;
+	sim_gpioc.PTOR = 0;
+
+	e = (out & LCD_E) ? 1 : 0;
+	if(e && !e_high){
+		sim_e_rise(access_ns);
+	}
+	else if(!e && e_high){
+		sim_e_fall(access_ns);
+	}
+	e_high = e;
+
+	sim_gpioc.PDOR = out;
+	shown_pdor = out;
+	*(uint32_t *)&sim_gpioc.PDIR = (out & sim_gpioc.PDDR) | (drive & ~sim_gpioc.PDDR);
+}
+
+/**
+ * @function sim_lcd_sync
+ * @brief  	 Called before each GPIOC access of the driver
+ * @param    none
+ * @return   none
+ */
+void sim_lcd_sync(void){
+	sim_absorb();
+	host_advance_ns(SIM_REG_NS);
+	access_ns = host_time_ns;
+}
+
+/**
+ * @function sim_lcd_init
+ * @brief  	 Power on reset of the LCD model
+ * @param    none
+ * @return   none
+ */
+void sim_lcd_init(void){
+	memset(&sim_lcd, 0, sizeof(sim_lcd));
+	memset(&sim_gpioc, 0, sizeof(sim_gpioc));
+	memset(&sim_portc, 0, sizeof(sim_portc));
+	memset(ddram, SIM_POWER_ON_FILL, sizeof(ddram));
+	out = 0;
+	shown_pdor = 0;
+	drive = 0;
+	e_high = 0;
+	access_ns = host_time_ns;
+	busy_until_ns = host_time_ns;
+	ac = 0;
+	mode8 = 1;
+	two_lines = 0;
+	increment = 1;
+	cgram = 0;
+	half = 0;
+	read_phase = 0;
+}
+
+/**
+ * @function sim_lcd_update
+ * @brief  	 Take the last write of the driver into account, e.g. the
+ * 			 final enable edge of a byte, before reading sim_lcd
+ * @param    none
+ * @return   none
+ */
+void sim_lcd_update(void){
+	sim_absorb();
+}
+
+/**
+ * @function sim_lcd_cell
+ * @brief  	 Character shown in a cell of the display
+ * @param    1. row	line, 0 or 1
+ * 			 2. col	column, 0 - 15
+ * @return   DDRAM contents at the cell address
+ */
+char sim_lcd_cell(uint8_t row, uint8_t col){
+	sim_absorb();
+	return ddram[(row ? LCD_ROW2_ADDR : 0) + col];
+}
+
+/**
+ * @function sim_lcd_busy
+ * @brief  	 Reports if the last instruction is still executing
+ * @param    none
+ * @return   1 if busy
+ */
+int sim_lcd_busy(void){
+	sim_absorb();
+	return host_time_ns < busy_until_ns;
+}
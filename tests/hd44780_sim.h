@@ -0,0 +1,83 @@
+/**@file: hd44780_sim.h
+ * @brief: Model of the HD44780 16x2 LCD on the simulated port C, for the
+ *			host tests of lcd.c
+ *			8 bit interface at power on, 4 bit after the function set,
+ *			nibbles latched on the falling edge of E
+ *			instruction set: clear, home, entry mode, display control,
+ *			shift, function set, CGRAM / DDRAM address, data writes with
+ *			the address counter wrap of the 2 line display
+ *			busy flag and address counter reads, execution times
+ *			(37 us, 1.52 ms for clear and home): bytes started while the
+ *			controller is busy, short enable pulses and both sides
+ *			driving the data lines are counted
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.sparkfun.com/datasheets/LCD/HD44780.pdf
+ */
+#ifndef HD44780_SIM_H_
+#define HD44780_SIM_H_
+
+#include <stdint.h>
+
+extern PORT_Type sim_portc;
+extern GPIO_Type sim_gpioc;
+
+void sim_lcd_sync(void);
+
+#undef PORTC
+#define PORTC						(&sim_portc)
+//Every register access first lets the model see the previous write
+#undef GPIOC
+#define GPIOC						(sim_lcd_sync(), &sim_gpioc)
+
+//What the controller saw
+typedef struct{
+	uint32_t commands;					//Instruction register writes
+	uint32_t data;						//Data register writes
+	uint32_t addr_sets;					//Set DDRAM address commands
+	uint32_t status_reads;				//Busy flag reads
+	uint32_t early;						//Bytes started while busy
+	uint32_t short_pulses;				//E high for less than PWEH
+	uint32_t contention;				//MCU and LCD driving the data lines
+	void (*on_byte)(uint8_t b, uint8_t rs);	//Called for every byte written, NULL for none
+}sim_lcd_stats;
+
+extern sim_lcd_stats sim_lcd;
+
+/**
+ * @function sim_lcd_init
+ * @brief  	 Power on reset of the LCD model
+ * @param    none
+ * @return   none
+ */
+void sim_lcd_init(void);
+
+/**
+ * @function sim_lcd_update
+ * @brief  	 Take the last write of the driver into account, e.g. the
+ * 			 final enable edge of a byte, before reading sim_lcd
+ * @param    none
+ * @return   none
+ */
+void sim_lcd_update(void);
+
+/**
+ * @function sim_lcd_cell
+ * @brief  	 Character shown in a cell of the display
+ * @param    1. row	line, 0 or 1
+ * 			 2. col	column, 0 - 15
+ * @return   DDRAM contents at the cell address
+ */
+char sim_lcd_cell(uint8_t row, uint8_t col);
+
+/**
+ * @function sim_lcd_busy
+ * @brief  	 Reports if the last instruction is still executing
+ * @param    none
+ * @return   1 if busy
+ */
+int sim_lcd_busy(void);
+
+#endif /* HD44780_SIM_H_ */
@@ -0,0 +1,386 @@
+/**@file: host.c
+ * @brief: Simulated core and time base of the host tests
+ *			interrupt masking and WFI of the Cortex-M0+
+ *			SysTick every millisecond, running the timer_add_hook() hooks
+ *			timer.h functions on the simulated time: reading the time costs
+ *			HOST_NOW_NS, busy waits advance the time they wait
+ *			device models registered with host_add_device() get their
+ *			events fired and their interrupts run as time goes by
+ *			with HOST_SYSTICK_SIM the SysTick and timer.h above are left to
+ *			timer.c on the model of systick_sim.c
+ *			with HOST_CPU_CYCLES now_cycles counts the cycles of the host
+ *			CPU instead, to time code on the PC (benchmarks)
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <stdlib.h>
+#include <time.h>
+#include "host.h"
+#include "timer.h"
+
+#define HOST_MAX_DEVICES	4
+#define HOST_TICK_NS		1000000ULL
+
+volatile uint32_t host_primask = 0;
+uint64_t host_time_ns = 0;
+uint64_t host_isr_ns = 0;
+uint64_t host_isr_max_ns = 0;
+uint64_t host_irq_off_max_ns = 0;
+uint32_t host_isr_count = 0;
+int host_in_isr = 0;
+int host_failures = 0;
+SIM_Type host_sim;
+
+static const host_device *devices[HOST_MAX_DEVICES];
+static uint8_t device_count = 0;
+#ifdef HOST_SYSTICK_SIM
+static uint64_t next_tick_ns = UINT64_MAX;		//SysTick_Handler of timer.c instead
+#else
+static uint64_t next_tick_ns = HOST_TICK_NS;
+#endif
+static uint8_t tick_pending = 0;
+static uint64_t irq_off_ns;
+static uint32_t nvic_pending = 0;
+static uint32_t ticks = 0;
+#ifndef HOST_SYSTICK_SIM
+static uint32_t reset_us = 0;
+static clock_hook clock_hooks[TIMER_MAX_CLOCK_HOOKS];
+static uint8_t clock_hook_count = 0;
+#endif
+
+static tick_hook hooks[TIMER_MAX_HOOKS];
+static uint8_t hook_count = 0;
+
+/**
+ * @function host_start
+ * @brief  	 Line buffered output, so a test stopped by a timeout still
+ * 			 shows how far it went
+ * @param    none
+ * @return   none
+ */
+__attribute__((constructor)) static void host_start(void){
+	setvbuf(stdout, NULL, _IOLBF, 0);
+}
+
+/**
+ * @function host_add_device
+ * @brief  	 Register a device model with the simulated time base
+ * @param    dev	device, must stay valid
+ * @return   none
+ */
+void host_add_device(const host_device *dev){
+	if(device_count < HOST_MAX_DEVICES){
+		devices[device_count++] = dev;
+	}
+}
+
+/**
+ * @function host_next_event
+ * @brief  	 Time of the next device event or SysTick
+ * @param    none
+ * @return   time in ns
+ */
+static uint64_t host_next_event(void){
+	uint64_t next = next_tick_ns;
+
+	for(uint8_t i = 0; i < device_count; i++){
+		uint64_t t = devices[i]->next_ns();
+
+		if(t < next){
+			next = t;
+		}
+	}
+	return next;
+}
+
+/**
+ * @function host_fire
+ * @brief  	 Process every event due at the current time
+ * @param    none
+ * @return   none
+ */
+static void host_fire(void){
+	for(uint8_t i = 0; i < device_count; i++){
+		if(devices[i]->next_ns() <= host_time_ns){
+			devices[i]->fire();
+		}
+	}
+	if(next_tick_ns <= host_time_ns){
+		next_tick_ns += HOST_TICK_NS;
+		tick_pending = 1;
+	}
+}
+
+/**
+ * @function host_systick
+ * @brief  	 SysTick_Handler of the simulated core
+ * @param    none
+ * @return   none
+ */
+static void host_systick(void){
+	ticks++;
+	for(uint8_t i = 0; i < hook_count; i++){
+		hooks[i]();
+	}
+}
+
+/**
+ * @function host_advance_ns
+ * @brief  	 Move the simulated time forward, firing device events and
+ * 			 SysTick hooks, and running the interrupts they raise
+ * @param    ns		time to advance
+ * @return   none
+ */
+void host_advance_ns(uint64_t ns){
+	uint64_t target = host_time_ns + ns;
+
+	for(;;){
+		uint64_t next = host_next_event();
+
+		if(next > target){
+			break;
+		}
+		if(next > host_time_ns){
+			host_time_ns = next;
+		}
+		host_fire();
+		host_irq_check();
+	}
+	if(target > host_time_ns){
+		host_time_ns = target;
+	}
+	host_irq_check();
+}
+
+/**
+ * @function host_isr_run
+ * @brief  	 Run an interrupt handler, accounting HOST_ISR_NS of CPU time
+ * 			 plus the time it spends itself
+ * @param    handler	interrupt handler
+ * @return   none
+ */
+void host_isr_run(void (*handler)(void)){
+	uint64_t start = host_time_ns;
+	uint64_t spent;
+
+	host_in_isr = 1;
+	handler();
+	host_advance_ns(HOST_ISR_NS);
+	host_in_isr = 0;
+
+	spent = host_time_ns - start;
+	host_isr_ns += spent;
+	host_isr_count++;
+	if(spent > host_isr_max_ns){
+		host_isr_max_ns = spent;
+	}
+}
+
+/**
+ * @function host_irq_check
+ * @brief  	 Run the pending interrupt handlers if the core accepts them
+ * @param    none
+ * @return   none
+ */
+void host_irq_check(void){
+	int ran;
+
+	if(host_in_isr || host_primask){
+		return;
+	}
+	do{
+		ran = 0;
+		for(uint8_t i = 0; i < device_count; i++){
+			while(devices[i]->irq()){
+				ran = 1;
+			}
+		}
+		if(tick_pending){						//Lowest priority
+			tick_pending = 0;
+			host_isr_run(host_systick);
+			ran = 1;
+		}
+	}while(ran);
+}
+
+/**
+ * @function host_nvic_set_pending
+ * @brief  	 NVIC_SetPendingIRQ of the simulated core
+ * @param    irq	interrupt number
+ * @return   none
+ */
+void host_nvic_set_pending(IRQn_Type irq){
+	nvic_pending |= 1UL << irq;
+}
+
+/**
+ * @function host_nvic_take
+ * @brief  	 Read and clear the software pending bit of an interrupt
+ * @param    irq	interrupt number
+ * @return   1 if it was pending
+ */
+int host_nvic_take(IRQn_Type irq){
+	int pending = (nvic_pending >> irq) & 1;
+
+	nvic_pending &= ~(1UL << irq);
+	return pending;
+}
+
+/**
+ * @function host_disable_irq
+ * @brief  	 __disable_irq of the simulated core
+ * @param    none
+ * @return   none
+ */
+void host_disable_irq(void){
+	if(!host_primask){
+		irq_off_ns = host_time_ns;
+	}
+	host_primask = 1;
+}
+
+/**
+ * @function host_set_primask
+ * @brief  	 __set_PRIMASK of the simulated core, pending interrupts run
+ * 			 as soon as they are unmasked
+ * @param    primask	new PRIMASK
+ * @return   none
+ */
+void host_set_primask(uint32_t primask){
+	if(primask){
+		host_disable_irq();
+		return;
+	}
+	if(host_primask && ((host_time_ns - irq_off_ns) > host_irq_off_max_ns)){
+		host_irq_off_max_ns = host_time_ns - irq_off_ns;
+	}
+	host_primask = 0;
+	host_irq_check();
+}
+
+/**
+ * @function host_enable_irq
+ * @brief  	 __enable_irq of the simulated core
+ * @param    none
+ * @return   none
+ */
+void host_enable_irq(void){
+	host_set_primask(0);
+}
+
+/**
+ * @function host_wfi
+ * @brief  	 __WFI of the simulated core: sleep until the next event.
+ * 			 Like the core it also wakes with interrupts masked.
+ * @param    none
+ * @return   none
+ */
+void host_wfi(void){
+	uint64_t next = host_next_event();
+
+	host_advance_ns((next > host_time_ns) ? (next - host_time_ns) : 1);
+}
+
+#ifndef HOST_SYSTICK_SIM
+/************************************************
+ * timer.h on the simulated time
+ ************************************************/
+uint32_t timer_cycles_per_us = HOST_CORE_HZ / 1000000;
+
+void init_systick(void){
+}
+
+void timer_clock_changed(void){
+	for(uint8_t i = 0; i < clock_hook_count; i++){
+		clock_hooks[i]();
+	}
+}
+
+ticktime_t now(){
+	return ticks;
+}
+
+ticktime_t getTicks(){
+	return ticks;
+}
+
+void reset_timer(){
+	reset_us = now_us();
+}
+
+ticktime_t get_timer(){
+	return now_us() - reset_us;
+}
+
+void delay(uint16_t ms){
+	host_advance_ns(ms * HOST_TICK_NS);
+}
+
+uint32_t now_us(void){
+	host_advance_ns(HOST_NOW_NS);
+	return (uint32_t)(host_time_ns / 1000);
+}
+
+uint32_t now_cycles(void){
+#ifdef HOST_CPU_CYCLES
+#if defined(__x86_64__) || defined(__i386__)
+	return (uint32_t)__builtin_ia32_rdtsc();
+#else
+	struct timespec ts;							//No cycle counter, 1 GHz reference
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint32_t)(((uint64_t)ts.tv_sec * 1000000000ULL) + ts.tv_nsec);
+#endif
+#else
+	host_advance_ns(HOST_NOW_NS);
+	return (uint32_t)((host_time_ns * (HOST_CORE_HZ / 1000000)) / 1000);
+#endif
+}
+
+void delay_cycles(uint32_t cycles){
+	host_advance_ns(((uint64_t)cycles * 1000) / (HOST_CORE_HZ / 1000000));
+}
+
+void delay_us(uint32_t us){
+	host_advance_ns((uint64_t)us * 1000);
+}
+
+int timer_add_hook(tick_hook hook){
+	if(hook_count >= TIMER_MAX_HOOKS){
+		return 0;
+	}
+	hooks[hook_count++] = hook;
+	return 1;
+}
+
+int timer_add_clock_hook(clock_hook hook){
+	for(uint8_t i = 0; i < clock_hook_count; i++){
+		if(clock_hooks[i] == hook){
+			return 1;
+		}
+	}
+	if(clock_hook_count >= TIMER_MAX_CLOCK_HOOKS){
+		return 0;
+	}
+	clock_hooks[clock_hook_count++] = hook;
+	return 1;
+}
+#endif
+
+/**
+ * @function host_report
+ * @brief  	 Print the result of a test program
+ * @param    name	test name
+ * @return   exit status, 0 when every check passed
+ */
+int host_report(const char *name){
+	if(host_failures){
+		printf("%s: FAIL (%d)\n", name, host_failures);
+		return EXIT_FAILURE;
+	}
+	printf("%s: PASS\n", name);
+	return EXIT_SUCCESS;
+}
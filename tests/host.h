@@ -0,0 +1,134 @@
+/**@file: host.h
+ * @brief: Host (Linux) build of the firmware modules for the tests in
+ *			this directory. Force included (-include host.h) before every
+ *			unit under test so that:
+ *			the CMSIS intrinsics (interrupt masking, barriers, WFI, NVIC)
+ *			act on a simulated core instead of executing Cortex-M0+ code
+ *			the peripherals used by the drivers point to RAM models
+ *			time only moves through the timer.h functions, which step the
+ *			simulated devices (see host.c)
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+#ifndef HOST_H_
+#define HOST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include "MKL25Z4.h"
+
+/************************************************
+ * Simulated core
+ ************************************************/
+extern volatile uint32_t host_primask;
+extern uint64_t host_time_ns;			//Simulated time
+
+void host_disable_irq(void);
+void host_enable_irq(void);
+void host_set_primask(uint32_t primask);
+void host_wfi(void);
+void host_nvic_set_pending(IRQn_Type irq);
+int host_nvic_take(IRQn_Type irq);
+
+#undef __DMB
+#define __DMB()						__sync_synchronize()
+#define __disable_irq()				host_disable_irq()
+#define __enable_irq()				host_enable_irq()
+#define __get_PRIMASK()				(host_primask)
+#define __set_PRIMASK(p)			host_set_primask(p)
+#define __WFI()						host_wfi()
+#define NVIC_EnableIRQ(irq)			((void)(irq))
+#define NVIC_DisableIRQ(irq)		((void)(irq))
+#define NVIC_ClearPendingIRQ(irq)	((void)(irq))
+#define NVIC_SetPriority(irq, p)	((void)(irq), (void)(p))
+#define NVIC_SetPendingIRQ(irq)		host_nvic_set_pending(irq)
+
+//Device model stepped by the simulated time, see host_add_device()
+typedef struct{
+	uint64_t (*next_ns)(void);			//Time of the next event, UINT64_MAX if none
+	void (*fire)(void);					//Process the events due at host_time_ns
+	int (*irq)(void);					//Run one pending interrupt handler, 1 if one ran
+}host_device;
+
+/**
+ * @function host_add_device
+ * @brief  	 Register a device model with the simulated time base
+ * @param    dev	device, must stay valid
+ * @return   none
+ */
+void host_add_device(const host_device *dev);
+
+/**
+ * @function host_advance_ns
+ * @brief  	 Move the simulated time forward, firing device events and
+ * 			 SysTick hooks, and running the interrupts they raise
+ * @param    ns		time to advance
+ * @return   none
+ */
+void host_advance_ns(uint64_t ns);
+
+/**
+ * @function host_irq_check
+ * @brief  	 Run the pending interrupt handlers if the core accepts them
+ * @param    none
+ * @return   none
+ */
+void host_irq_check(void);
+
+/**
+ * @function host_isr_run
+ * @brief  	 Run an interrupt handler, accounting HOST_ISR_NS of CPU time
+ * 			 plus the time it spends itself
+ * @param    handler	interrupt handler
+ * @return   none
+ */
+void host_isr_run(void (*handler)(void));
+
+#define HOST_CORE_HZ		48000000	//Core clock of the RUN configuration
+#define HOST_ISR_NS			2500		//Entry, exit and body of a short handler (~120 cycles)
+#define HOST_NOW_NS			250			//Cost of one time stamp read
+
+//CPU accounting
+extern uint64_t host_isr_ns;			//Time spent in interrupt handlers
+extern uint64_t host_isr_max_ns;		//Longest single handler
+extern uint64_t host_irq_off_max_ns;	//Longest interrupt masked section
+extern uint32_t host_isr_count;
+extern int host_in_isr;
+
+/************************************************
+ * Peripheral models
+ ************************************************/
+extern SIM_Type host_sim;
+#undef SIM
+#define SIM							(&host_sim)
+
+#ifdef HOST_I2C_SIM
+#include "i2c_sim.h"
+#endif
+#ifdef HOST_MMA_SIM
+#include "mma_sim.h"
+#endif
+#ifdef HOST_SYSTICK_SIM
+#include "systick_sim.h"
+#endif
+#ifdef HOST_LCD_SIM
+#include "hd44780_sim.h"
+#endif
+
+/************************************************
+ * Checks
+ ************************************************/
+extern int host_failures;
+
+int host_report(const char *name);
+
+#define CHECK(cond)	do{ \
+		if(!(cond)){ \
+			printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #cond); \
+			host_failures++; \
+		} \
+	}while(0)
+
+#endif /* HOST_H_ */
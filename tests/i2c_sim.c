@@ -0,0 +1,597 @@
+/**@file: i2c_sim.c
+ * @brief: Register level model of the KL25Z I2C0 master, its DMA
+ *			channel and one slave device, for the host tests of i2c.c
+ *			Each I2C0 / GPIOE access of the driver first calls the model
+ *			(see i2c_sim.h), which applies the previous write the way the
+ *			hardware would: write 1 to clear flags, START on MST rising,
+ *			STOP on MST falling, a byte clocked out on each D write. A read
+ *			of D in receive mode starts the next byte on the hardware, the
+ *			model starts it when the handler returns.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.nxp.com/docs/en/reference-manual/KL25P80M48SF0RM.pdf
+ */
+
+#include "host.h"
+#include "i2c.h"
+#include "dma.h"
+#include "fsl_clock.h"
+
+#define SIM_BUS_HZ			24000000	//Bus clock of the RUN configuration
+#define SIM_REG_NS			20			//Time of one register access
+#define SIM_SHOWN			0x100		//Set in S / FLT as presented, a CPU write clears it
+#define SIM_D_EMPTY			0x100		//D as seen by the CPU, nothing received
+#define SIM_D_RX			0x200		//D holds a received byte
+#define SIM_NEVER			UINT64_MAX
+
+#define SCL_MASK			((uint32_t)1 << I2C_SCL_PIN)
+#define SDA_MASK			((uint32_t)1 << I2C_SDA_PIN)
+
+typedef enum{
+	PH_IDLE,							//No transaction of ours on the bus
+	PH_START,							//START sent, address expected in D
+	PH_TX,								//Master transmitting
+	PH_RX,								//Master receiving
+	PH_HUNG								//Lines held by the slave
+}sim_phase;
+
+typedef enum{
+	BYTE_ADDR,
+	BYTE_TX,
+	BYTE_RX
+}sim_byte;
+
+sim_i2c_regs sim_i2c0;
+GPIO_Type sim_gpioe;
+PORT_Type sim_porte;
+sim_i2c_faults sim_faults;
+sim_i2c_stats sim_i2c;
+
+static const sim_i2c_slave *slave;
+static uint32_t bus_hz = SIM_BUS_HZ;
+static sim_i2c_regs shown;				//Registers as last presented to the CPU
+static sim_phase phase;
+static uint8_t status;					//S without BUSY
+static bool bus_busy;
+static bool stopf;
+static bool rsta;						//Repeated START sent, address expected
+static uint64_t busy_since;
+
+static bool byte_busy;
+static sim_byte byte_kind;
+static uint8_t byte_val;
+static uint64_t byte_done_ns;
+static bool master_nack;				//Master NACKs the byte being received
+static bool rx_full;
+static uint8_t rx_val;
+
+static bool stop_busy;
+static uint64_t stop_done_ns;
+
+static bool addressed;
+static bool read_mode;
+static bool reg_set;
+static uint8_t reg_ptr;
+static bool sda_held;
+static uint8_t held_clocks;
+static bool scl_level = true;
+
+static bool dma_on;
+static bool dma_irq;
+static uint8_t *dma_dst;
+static uint32_t dma_left;
+static dma_callback dma_cb;
+
+//SCL divider for each ICR value (KL25 reference manual, I2C divider table)
+static const uint16_t scl_div[64] = {
+	20, 22, 24, 26, 28, 30, 34, 40, 28, 32, 36, 40, 44, 48, 56, 68,
+	48, 56, 64, 72, 80, 88, 104, 128, 80, 96, 112, 128, 144, 160, 192, 240,
+	160, 192, 224, 256, 288, 320, 384, 480, 320, 384, 448, 512, 576, 640, 768, 960,
+	640, 768, 896, 1024, 1152, 1280, 1536, 1920, 1280, 1536, 1792, 2048, 2304, 2560, 3072, 3840
+};
+
+void I2C0_IRQHandler(void);
+static uint64_t sim_next_ns(void);
+static void sim_fire(void);
+static int sim_irq(void);
+
+static const host_device sim_device = {sim_next_ns, sim_fire, sim_irq};
+
+/**
+ * @function CLOCK_GetBusClkFreq
+ * @brief  	 Bus clock used by I2C_set_speed
+ * @param    none
+ * @return   bus clock, SIM_BUS_HZ unless changed
+ */
+uint32_t CLOCK_GetBusClkFreq(void){
+	return bus_hz;
+}
+
+/**
+ * @function sim_i2c_set_bus_hz
+ * @brief  	 Change the bus clock as a clock configuration switch does,
+ * 			 the I2C0 divider is left as programmed
+ * @param    hz		new bus clock
+ * @return   none
+ */
+void sim_i2c_set_bus_hz(uint32_t hz){
+	bus_hz = hz;
+}
+
+/**
+ * @function sim_i2c_bit_ns
+ * @brief  	 SCL period programmed in I2C0 F
+ * @param    none
+ * @return   period in ns
+ */
+uint32_t sim_i2c_bit_ns(void){
+	uint32_t mult = 1U << (sim_i2c0.F >> 6);
+	uint32_t div = mult * scl_div[sim_i2c0.F & 0x3F];
+
+	return (uint32_t)((1000000000ULL * div) / bus_hz);
+}
+
+/**
+ * @function sim_present
+ * @brief  	 Update the registers read by the CPU from the model state
+ * @param    none
+ * @return   none
+ */
+static void sim_present(void){
+	sim_i2c0.S = SIM_SHOWN | status | (bus_busy ? I2C_S_BUSY_MASK : 0);
+	sim_i2c0.D = rx_full ? (SIM_D_RX | rx_val) : SIM_D_EMPTY;
+	sim_i2c0.FLT = SIM_SHOWN | (sim_i2c0.FLT & I2C_FLT_STOPIE_MASK) | (stopf ? I2C_FLT_STOPF_MASK : 0);
+	shown = sim_i2c0;
+}
+
+/**
+ * @function sim_gpio_update
+ * @brief  	 Line levels with PTE24 / PTE25 as GPIO (open drain emulated
+ * 			 with the direction register), SCL pulses release a slave
+ * 			 stuck driving SDA
+ * @param    none
+ * @return   none
+ */
+static void sim_gpio_update(void){
+	bool gpio = ((sim_porte.PCR[I2C_SCL_PIN] & PORT_PCR_MUX_MASK) >> PORT_PCR_MUX_SHIFT) == 1;
+	bool scl = !(gpio && (sim_gpioe.PDDR & SCL_MASK)) && !sim_faults.hold_scl;
+	bool sda;
+
+	if(gpio && scl && !scl_level){
+		sim_i2c.recover_clocks++;
+		if(sda_held && (held_clocks > 0) && (--held_clocks == 0)){
+			sda_held = false;			//Slave shifted its byte out
+		}
+	}
+	scl_level = scl;
+	sda = !(gpio && (sim_gpioe.PDDR & SDA_MASK)) && !sda_held;
+	*(uint32_t *)&sim_gpioe.PDIR = (scl ? SCL_MASK : 0) | (sda ? SDA_MASK : 0);
+}
+
+/**
+ * @function sim_byte_begin
+ * @brief  	 Start clocking a byte on the bus
+ * @param    1. kind	address, transmitted or received byte
+ * 			 2. val		byte sent by the master
+ * @return   none
+ */
+static void sim_byte_begin(sim_byte kind, uint8_t val){
+	uint32_t bits = (kind == BYTE_ADDR) ? 10 : 9;		//START or repeated START setup
+
+	byte_kind = kind;
+	byte_val = val;
+	byte_busy = true;
+	status &= ~I2C_S_TCF_MASK;
+	byte_done_ns = sim_faults.hold_scl ? SIM_NEVER : (host_time_ns + ((uint64_t)bits * sim_i2c_bit_ns()));
+	sim_i2c.bytes++;
+}
+
+/**
+ * @function sim_rx_next
+ * @brief  	 Receive the next byte when the master asks for one (data
+ * 			 register read in receive mode)
+ * @param    none
+ * @return   none
+ */
+static void sim_rx_next(void){
+	uint8_t c1 = sim_i2c0.C1;
+
+	if(!(c1 & I2C_C1_MST_MASK) || (c1 & I2C_C1_TX_MASK) || byte_busy || (phase != PH_RX)){
+		return;
+	}
+	if(master_nack){
+		sim_i2c.protocol_errors++;		//Read past the NACKed last byte
+		return;
+	}
+	master_nack = (c1 & I2C_C1_TXAK_MASK) != 0;
+	sim_byte_begin(BYTE_RX, 0);
+	if(sim_faults.stuck){
+		sim_faults.stuck--;
+		sda_held = true;				//Slave freezes mid byte
+		held_clocks = sim_faults.stuck_clocks;
+		byte_done_ns = SIM_NEVER;
+		phase = PH_HUNG;
+	}
+}
+
+/**
+ * @function sim_arb_lost
+ * @brief  	 The master lost the bus: ARBL, IICIF and MST cleared
+ * @param    none
+ * @return   none
+ */
+static void sim_arb_lost(void){
+	status |= I2C_S_ARBL_MASK | I2C_S_IICIF_MASK;
+	sim_i2c0.C1 &= ~I2C_C1_MST_MASK;
+	phase = PH_IDLE;
+}
+
+/**
+ * @function sim_start
+ * @brief  	 MST set: START if the bus is free
+ * @param    none
+ * @return   none
+ */
+static void sim_start(void){
+	if(stop_busy){
+		sim_i2c.protocol_errors++;		//Our own STOP is still on the bus
+	}
+	if(bus_busy || stop_busy || sda_held){
+		sim_arb_lost();
+		return;
+	}
+	phase = PH_START;
+	bus_busy = true;
+	busy_since = host_time_ns;
+	addressed = false;
+	sim_i2c.starts++;
+}
+
+/**
+ * @function sim_stop
+ * @brief  	 MST cleared: STOP, unless the slave holds a line
+ * @param    none
+ * @return   none
+ */
+static void sim_stop(void){
+	byte_busy = false;					//A byte in flight is abandoned
+	addressed = false;
+	if(sda_held || sim_faults.hold_scl){
+		phase = PH_HUNG;
+		return;
+	}
+	if(phase == PH_IDLE){
+		return;
+	}
+	phase = PH_IDLE;
+	stop_busy = true;
+	stop_done_ns = host_time_ns + (2 * sim_i2c_bit_ns());
+	sim_i2c.stops++;
+}
+
+/**
+ * @function sim_c1_write
+ * @brief  	 Apply a write of C1
+ * @param    1. old		previous value
+ * 			 2. c1		written value
+ * @return   none
+ */
+static void sim_c1_write(uint8_t old, uint8_t c1){
+	if(c1 & I2C_C1_RSTA_MASK){
+		sim_i2c0.C1 &= ~I2C_C1_RSTA_MASK;	//Write only bit
+		c1 &= ~I2C_C1_RSTA_MASK;
+		if(!(old & I2C_C1_MST_MASK) || byte_busy || (phase == PH_IDLE)){
+			sim_i2c.protocol_errors++;
+		}
+		else{
+			rsta = true;
+			sim_i2c.restarts++;
+		}
+	}
+
+	if((old & I2C_C1_IICEN_MASK) && !(c1 & I2C_C1_IICEN_MASK)){
+		//Module off, the master lets go of the lines
+		byte_busy = false;
+		rx_full = false;
+		rsta = false;
+		phase = (sda_held || sim_faults.hold_scl) ? PH_HUNG : PH_IDLE;
+		if(stop_busy || (phase == PH_IDLE)){
+			stop_busy = false;
+			bus_busy = false;
+		}
+		status = 0;
+		return;
+	}
+	if(!(old & I2C_C1_IICEN_MASK) && (c1 & I2C_C1_IICEN_MASK)){
+		status = I2C_S_TCF_MASK;
+		bus_busy = sda_held || sim_faults.hold_scl;
+		phase = bus_busy ? PH_HUNG : PH_IDLE;
+	}
+	if(!(c1 & I2C_C1_IICEN_MASK)){
+		return;
+	}
+
+	if(!(old & I2C_C1_MST_MASK) && (c1 & I2C_C1_MST_MASK)){
+		sim_start();
+	}
+	else if((old & I2C_C1_MST_MASK) && !(c1 & I2C_C1_MST_MASK)){
+		sim_stop();
+	}
+}
+
+/**
+ * @function sim_d_write
+ * @brief  	 Apply a write of D: address or data byte
+ * @param    val	byte written
+ * @return   none
+ */
+static void sim_d_write(uint8_t val){
+	uint8_t c1 = sim_i2c0.C1;
+
+	if(status & I2C_S_ARBL_MASK){
+		return;							//Ignored until the arbitration loss is handled
+	}
+	if(!(c1 & I2C_C1_IICEN_MASK) || !(c1 & I2C_C1_MST_MASK) || !(c1 & I2C_C1_TX_MASK) || byte_busy){
+		sim_i2c.protocol_errors++;
+		return;
+	}
+	if((phase == PH_START) || rsta){
+		rsta = false;
+		sim_byte_begin(BYTE_ADDR, val);
+	}
+	else if(phase == PH_TX){
+		sim_byte_begin(BYTE_TX, val);
+	}
+	else{
+		sim_i2c.protocol_errors++;
+	}
+}
+
+/**
+ * @function sim_absorb
+ * @brief  	 Apply the CPU writes done since the registers were presented
+ * @param    none
+ * @return   none
+ */
+static void sim_absorb(void){
+	sim_i2c_regs *r = &sim_i2c0;
+
+	if(!(r->S & SIM_SHOWN)){
+		status &= ~(r->S & (I2C_S_IICIF_MASK | I2C_S_ARBL_MASK));	//Write 1 to clear
+	}
+	if((!(r->FLT & SIM_SHOWN) || (r->FLT != shown.FLT)) && (r->FLT & I2C_FLT_STOPF_MASK)){
+		stopf = false;
+	}
+	if(r->C1 != shown.C1){
+		sim_c1_write(shown.C1, r->C1);
+	}
+	if(r->D < SIM_D_EMPTY){
+		sim_d_write((uint8_t)r->D);
+	}
+	sim_gpio_update();
+}
+
+/**
+ * @function sim_i2c_sync
+ * @brief  	 Called before each I2C0 access of the driver
+ * @param    none
+ * @return   none
+ */
+void sim_i2c_sync(void){
+	sim_absorb();
+	sim_present();
+	host_advance_ns(SIM_REG_NS);
+}
+
+/**
+ * @function sim_gpioe_sync
+ * @brief  	 Called before each GPIOE access of the driver
+ * @param    none
+ * @return   none
+ */
+void sim_gpioe_sync(void){
+	sim_absorb();
+	sim_present();
+	host_advance_ns(SIM_REG_NS);
+}
+
+/**
+ * @function sim_byte_done
+ * @brief  	 End of a byte on the bus: the slave answers, the flags are set
+ * @param    none
+ * @return   none
+ */
+static void sim_byte_done(void){
+	bool ack = false;
+
+	byte_busy = false;
+	switch(byte_kind){
+	case BYTE_ADDR:
+		if(sim_faults.arb_lost){
+			//Another master wins during the address, then releases the bus
+			sim_faults.arb_lost--;
+			sim_arb_lost();
+			bus_busy = false;
+			return;
+		}
+		ack = (slave != NULL) && ((byte_val & 0xFE) == slave->addr);
+		if(ack && sim_faults.nak_addr){
+			sim_faults.nak_addr--;
+			ack = false;
+		}
+		addressed = ack;
+		read_mode = (byte_val & 1) != 0;
+		reg_set = false;
+		master_nack = false;
+		phase = (ack && read_mode) ? PH_RX : PH_TX;
+		break;
+
+	case BYTE_TX:
+		ack = addressed && !read_mode;
+		if(ack && sim_faults.nak_data){
+			sim_faults.nak_data--;
+			ack = false;
+		}
+		if(ack){
+			if(!reg_set){
+				reg_ptr = byte_val;			//First byte selects the register
+				reg_set = true;
+			}
+			else{
+				slave->write(reg_ptr, byte_val);
+				reg_ptr = slave->next ? slave->next(reg_ptr) : (uint8_t)(reg_ptr + 1);
+			}
+		}
+		break;
+
+	case BYTE_RX:
+		rx_val = slave->read(reg_ptr);
+		reg_ptr = slave->next ? slave->next(reg_ptr) : (uint8_t)(reg_ptr + 1);
+		status |= I2C_S_TCF_MASK | I2C_S_IICIF_MASK;
+		if(dma_on && (sim_i2c0.C1 & I2C_C1_DMAEN_MASK)){
+			//DMA reads D, which starts the next byte
+			*dma_dst++ = rx_val;
+			sim_i2c.dma_bytes++;
+			if(--dma_left == 0){
+				dma_on = false;
+				dma_irq = true;
+			}
+			sim_rx_next();
+		}
+		else{
+			rx_full = true;
+		}
+		return;
+	}
+
+	status |= I2C_S_TCF_MASK | I2C_S_IICIF_MASK;
+	if(ack){
+		status &= ~I2C_S_RXAK_MASK;
+	}
+	else{
+		status |= I2C_S_RXAK_MASK;
+	}
+}
+
+/**
+ * @function sim_next_ns
+ * @brief  	 Time of the next bus event
+ * @param    none
+ * @return   time in ns, SIM_NEVER if none
+ */
+static uint64_t sim_next_ns(void){
+	uint64_t next = SIM_NEVER;
+
+	sim_absorb();
+	sim_present();
+	if(byte_busy){
+		next = byte_done_ns;
+	}
+	if(stop_busy && (stop_done_ns < next)){
+		next = stop_done_ns;
+	}
+	return next;
+}
+
+/**
+ * @function sim_fire
+ * @brief  	 Process the bus events due now
+ * @param    none
+ * @return   none
+ */
+static void sim_fire(void){
+	sim_absorb();
+	if(byte_busy && (byte_done_ns <= host_time_ns)){
+		sim_byte_done();
+	}
+	if(stop_busy && (stop_done_ns <= host_time_ns)){
+		stop_busy = false;
+		bus_busy = false;
+		stopf = true;
+		sim_i2c.busy_ns += host_time_ns - busy_since;
+		if(sim_i2c0.FLT & I2C_FLT_STOPIE_MASK){
+			status |= I2C_S_IICIF_MASK;
+		}
+	}
+	sim_present();
+}
+
+/**
+ * @function sim_dma_isr
+ * @brief  	 DMA0_IRQHandler: all bytes moved
+ * @param    none
+ * @return   none
+ */
+static void sim_dma_isr(void){
+	if(dma_cb){
+		dma_cb();
+	}
+}
+
+/**
+ * @function sim_irq
+ * @brief  	 Run the DMA0 or I2C0 handler if its interrupt is pending
+ * @param    none
+ * @return   1 if a handler ran
+ */
+static int sim_irq(void){
+	uint8_t c1;
+
+	sim_absorb();
+	sim_present();
+	if(dma_irq){
+		dma_irq = false;
+		host_isr_run(sim_dma_isr);
+		return 1;
+	}
+
+	c1 = sim_i2c0.C1;
+	if(!((status & I2C_S_IICIF_MASK) && (c1 & I2C_C1_IICIE_MASK) && (c1 & I2C_C1_IICEN_MASK)) &&
+		!host_nvic_take(I2C0_IRQn)){
+		return 0;
+	}
+	host_isr_run(I2C0_IRQHandler);
+	sim_absorb();
+	sim_rx_next();						//The handler read D
+	sim_present();
+	return 1;
+}
+
+/************************************************
+ * DMA0 channel used by the driver
+ ************************************************/
+void dma_init(void){
+}
+
+void dma_start_rx(uint8_t source, volatile const void *src, uint8_t *dst, uint32_t len, dma_callback cb){
+	dma_on = true;
+	dma_irq = false;
+	dma_dst = dst;
+	dma_left = len;
+	dma_cb = cb;
+}
+
+void dma_stop(void){
+	dma_on = false;
+	dma_irq = false;
+}
+
+/**
+ * @function sim_i2c_init
+ * @brief  	 Reset the model, attach a slave and register the model with
+ * 			 the host time base
+ * @param    slave	device answering on the bus
+ * @return   none
+ */
+void sim_i2c_init(const sim_i2c_slave *dev){
+	static bool registered = false;
+
+	slave = dev;
+	if(!registered){
+		host_add_device(&sim_device);
+		registered = true;
+	}
+	sim_present();
+}
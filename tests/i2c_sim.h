@@ -0,0 +1,117 @@
+/**@file: i2c_sim.h
+ * @brief: Register level model of the KL25Z I2C0 master, its DMA
+ *			channel and one slave device, for the host tests of i2c.c
+ *			I2C0 registers behave like the hardware: START / repeated
+ *			START / STOP from C1, bytes clocked at the SCL rate set in F,
+ *			IICIF / TCF / RXAK / ARBL / BUSY in S, stop detect in FLT
+ *			reads flagged for DMA are moved by the modelled DMA0 channel
+ *			PTE24 / PTE25 as GPIO: the bus clear sequence is seen on the
+ *			lines and can release a slave holding SDA
+ *			sim_faults injects NAKs, arbitration losses, a slave stuck
+ *			holding SDA and a slave holding SCL
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.nxp.com/docs/en/reference-manual/KL25P80M48SF0RM.pdf
+ */
+#ifndef I2C_SIM_H_
+#define I2C_SIM_H_
+
+#include <stdint.h>
+#include <stdbool.h>
+
+//I2C0 registers seen by i2c.c. S, D and FLT are wider than the hardware
+//registers: the model presents them with bit 8 or 9 set, so a plain CPU
+//write (below 0x100) is told from a value the model left there. A read
+//modify write of FLT is seen when it changes the value.
+typedef struct{
+	uint8_t A1;
+	uint8_t F;
+	uint8_t C1;
+	uint16_t S;
+	uint16_t D;
+	uint8_t C2;
+	uint16_t FLT;
+	uint8_t RA;
+	uint8_t SMB;
+	uint8_t A2;
+	uint8_t SLTH;
+	uint8_t SLTL;
+}sim_i2c_regs;
+
+extern sim_i2c_regs sim_i2c0;
+extern GPIO_Type sim_gpioe;
+extern PORT_Type sim_porte;
+
+void sim_i2c_sync(void);
+void sim_gpioe_sync(void);
+
+//Every register access first lets the model see the previous write
+#undef I2C0
+#define I2C0						(sim_i2c_sync(), &sim_i2c0)
+#undef GPIOE
+#define GPIOE						(sim_gpioe_sync(), &sim_gpioe)
+#undef PORTE
+#define PORTE						(&sim_porte)
+
+//Slave device on the bus
+typedef struct{
+	uint8_t addr;						//Address, write form
+	uint8_t (*read)(uint8_t reg);		//Register read by the master
+	void (*write)(uint8_t reg, uint8_t val);
+	uint8_t (*next)(uint8_t reg);		//Register after reg, NULL to increment
+}sim_i2c_slave;
+
+//Faults injected on the next transactions, counted down as they happen
+typedef struct{
+	uint16_t nak_addr;					//Address bytes not acknowledged
+	uint16_t nak_data;					//Written data bytes not acknowledged
+	uint16_t arb_lost;					//Address bytes losing arbitration
+	uint16_t stuck;						//Read bytes where the slave freezes driving SDA low
+	uint8_t stuck_clocks;				//SCL pulses the frozen slave needs to let SDA go
+	bool hold_scl;						//Slave holds SCL low, nothing moves while set
+}sim_i2c_faults;
+
+//What happened on the bus
+typedef struct{
+	uint32_t starts;
+	uint32_t restarts;
+	uint32_t stops;
+	uint32_t bytes;						//Bytes clocked on the bus
+	uint32_t dma_bytes;					//Read bytes moved by DMA
+	uint32_t protocol_errors;			//Accesses the hardware would not accept
+	uint32_t recover_clocks;			//SCL pulses sent with the pins as GPIO
+	uint64_t busy_ns;					//Time the bus was busy
+}sim_i2c_stats;
+
+extern sim_i2c_faults sim_faults;
+extern sim_i2c_stats sim_i2c;
+
+/**
+ * @function sim_i2c_init
+ * @brief  	 Reset the model, attach a slave and register the model with
+ * 			 the host time base
+ * @param    slave	device answering on the bus
+ * @return   none
+ */
+void sim_i2c_init(const sim_i2c_slave *slave);
+
+/**
+ * @function sim_i2c_bit_ns
+ * @brief  	 SCL period programmed in I2C0 F
+ * @param    none
+ * @return   period in ns
+ */
+uint32_t sim_i2c_bit_ns(void);
+
+/**
+ * @function sim_i2c_set_bus_hz
+ * @brief  	 Change the bus clock as a clock configuration switch does,
+ * 			 the I2C0 divider is left as programmed
+ * @param    hz		new bus clock
+ * @return   none
+ */
+void sim_i2c_set_bus_hz(uint32_t hz);
+
+#endif /* I2C_SIM_H_ */
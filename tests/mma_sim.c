@@ -0,0 +1,304 @@
+/**@file: mma_sim.c
+ * @brief: Model of the MMA8451 on the simulated I2C0 bus, for the host
+ *			tests of mma8451.c
+ *			samples produced at the configured data rate, the sample
+ *			number n is encoded in X (n mod 4096 counts) with Y = 0 and
+ *			Z = 1g, or generated by sim_mma.signal when set
+ *			32 sample FIFO (circular mode, watermark, overflow), data
+ *			ready, F_STATUS, register wrap of OUT_X_MSB..OUT_Z_LSB in
+ *			FIFO mode
+ *			INT1 (FIFO) / INT2 (data ready) on PTA14 / PTA15 and the
+ *			PORTA pin interrupts, edge or level as set in PCR IRQC
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.nxp.com/docs/en/data-sheet/MMA8451Q.pdf
+ */
+
+#include "host.h"
+#include "mma8451.h"
+
+#define SIM_NEVER			UINT64_MAX
+#define IRQC_LEVEL_LOW		0x8
+#define IRQC_FALLING		0xA
+#define PIN_INT1			(1U << MMA_INT1_PIN)
+#define PIN_INT2			(1U << MMA_INT2_PIN)
+
+PORT_Type sim_porta;
+GPIO_Type sim_gpioa;
+sim_mma_stats sim_mma;
+
+static uint8_t regs[0x40];
+static int16_t fifo[MMA_FIFO_SIZE][3];
+static uint8_t fifo_head;				//Oldest sample
+static uint8_t fifo_cnt;
+static int16_t out[3];					//Sample presented in OUT_X_MSB..OUT_Z_LSB
+static uint8_t drdy;					//New sample not read yet
+static uint8_t overflow;
+static uint64_t next_sample_ns = SIM_NEVER;
+static uint32_t pins = PIN_INT1 | PIN_INT2;	//Line levels, high when released
+static uint32_t isf;					//Pin interrupt flags
+
+//Sample period for each CTRL_REG1 DR value
+static const uint32_t odr_period_ns[8] = {
+	1250000, 2500000, 5000000, 10000000, 20000000, 80000000, 160000000, 640000000
+};
+
+void PORTA_IRQHandler(void);
+
+/**
+ * @function sim_irqc
+ * @brief  	 Interrupt configuration of a PORTA pin
+ * @param    pin	pin number
+ * @return   PCR IRQC field
+ */
+static uint32_t sim_irqc(uint8_t pin){
+	return (sim_porta.PCR[pin] & PORT_PCR_IRQC_MASK) >> PORT_PCR_IRQC_SHIFT;
+}
+
+/**
+ * @function sim_pins_update
+ * @brief  	 Drive INT1 / INT2 from the sensor state and latch the pin
+ * 			 interrupt flags
+ * @param    none
+ * @return   none
+ */
+static void sim_pins_update(void){
+	uint32_t now = PIN_INT1 | PIN_INT2;
+	uint8_t wmrk = regs[REG_F_SETUP] & F_WMRK_MASK;
+	uint32_t falling;
+
+	if((regs[REG_CTRL4] & INT_EN_FIFO) && (regs[REG_F_SETUP] & 0xC0) && wmrk && (fifo_cnt >= wmrk)){
+		now &= ~((regs[REG_CTRL5] & INT_EN_FIFO) ? PIN_INT1 : PIN_INT2);
+	}
+	if((regs[REG_CTRL4] & INT_EN_DRDY) && drdy){
+		now &= ~((regs[REG_CTRL5] & INT_EN_DRDY) ? PIN_INT1 : PIN_INT2);
+	}
+	falling = pins & ~now;
+	pins = now;
+	*(uint32_t *)&sim_gpioa.PDIR = pins;
+
+	for(uint8_t pin = MMA_INT1_PIN; pin <= MMA_INT2_PIN; pin++){
+		uint32_t bit = 1U << pin;
+
+		if(((sim_irqc(pin) == IRQC_FALLING) && (falling & bit)) ||
+			((sim_irqc(pin) == IRQC_LEVEL_LOW) && !(pins & bit))){
+			isf |= bit;
+		}
+		if(sim_irqc(pin) == 0){
+			isf &= ~bit;
+		}
+	}
+	sim_porta.ISFR = isf;
+}
+
+/**
+ * @function sim_sample
+ * @brief  	 Sample number n, 14 bit counts
+ * @param    1. n		sample number
+ * 			 2. axis	0 = X, 1 = Y, 2 = Z
+ * @return   14 bit sample
+ */
+static int16_t sim_sample(uint32_t n, uint8_t axis){
+	uint16_t one_g = 4096 >> (regs[REG_XYZ_DATA_CFG] & 0x03);
+
+	if(sim_mma.signal){
+		return sim_mma.signal(n, axis);
+	}
+	switch(axis){
+	case 0:
+		return (int16_t)(n % one_g);
+	case 1:
+		return 0;
+	default:
+		return (int16_t)one_g;
+	}
+}
+
+/**
+ * @function sim_convert
+ * @brief  	 New sample: into the FIFO or the output registers
+ * @param    none
+ * @return   none
+ */
+static void sim_convert(void){
+	int16_t s[3];
+	uint32_t n = sim_mma.produced++;
+
+	for(uint8_t a = 0; a < 3; a++){
+		s[a] = sim_sample(n, a);
+	}
+	if(regs[REG_F_SETUP] & 0xC0){
+		if(fifo_cnt == MMA_FIFO_SIZE){
+			fifo_head = (fifo_head + 1) % MMA_FIFO_SIZE;	//Circular: oldest lost
+			fifo_cnt--;
+			overflow = 1;
+			sim_mma.overflows++;
+		}
+		for(uint8_t a = 0; a < 3; a++){
+			fifo[(fifo_head + fifo_cnt) % MMA_FIFO_SIZE][a] = s[a];
+		}
+		fifo_cnt++;
+		if(fifo_cnt > sim_mma.max_fifo){
+			sim_mma.max_fifo = fifo_cnt;
+		}
+	}
+	else{
+		for(uint8_t a = 0; a < 3; a++){
+			out[a] = s[a];
+		}
+		drdy = 1;
+	}
+}
+
+/**
+ * @function sim_mma_read
+ * @brief  	 Register read by the master
+ * @param    reg	register
+ * @return   register value
+ */
+static uint8_t sim_mma_read(uint8_t reg){
+	uint8_t val;
+	int16_t v;
+
+	if(reg == REG_STATUS){
+		if(regs[REG_F_SETUP] & 0xC0){
+			uint8_t wmrk = regs[REG_F_SETUP] & F_WMRK_MASK;
+
+			val = fifo_cnt | (overflow ? F_OVF : 0) | ((wmrk && (fifo_cnt >= wmrk)) ? F_WMRK_FLAG : 0);
+			overflow = 0;
+			return val;
+		}
+		return drdy ? 0x0F : 0x00;
+	}
+	if((reg >= REG_XHI) && (reg <= REG_ZLO)){
+		if(reg == REG_XHI){
+			//Reading X MSB takes the next sample
+			if(regs[REG_F_SETUP] & 0xC0){
+				if(fifo_cnt){
+					for(uint8_t a = 0; a < 3; a++){
+						out[a] = fifo[fifo_head][a];
+					}
+					fifo_head = (fifo_head + 1) % MMA_FIFO_SIZE;
+					fifo_cnt--;
+					sim_mma.read++;
+				}
+			}
+			else if(drdy){
+				drdy = 0;
+				sim_mma.read++;
+			}
+			sim_pins_update();
+		}
+		v = (int16_t)(out[(reg - REG_XHI) / 2] * 4);	//Left aligned 14 bit
+		return ((reg - REG_XHI) & 1) ? (uint8_t)v : (uint8_t)(v >> 8);
+	}
+	if(reg == REG_WHOAMI){
+		return WHOAMI;
+	}
+	return (reg < sizeof(regs)) ? regs[reg] : 0;
+}
+
+/**
+ * @function sim_mma_write
+ * @brief  	 Register write by the master
+ * @param    1. reg		register
+ * 			 2. val		value
+ * @return   none
+ */
+static void sim_mma_write(uint8_t reg, uint8_t val){
+	uint8_t was_active;
+
+	if(reg >= sizeof(regs)){
+		return;
+	}
+	was_active = regs[REG_CTRL1] & CTRL1_ACTIVE;
+	regs[reg] = val;
+	if(reg == REG_F_SETUP){
+		fifo_cnt = 0;
+		fifo_head = 0;
+		overflow = 0;
+	}
+	if(reg == REG_CTRL1){
+		if(!(val & CTRL1_ACTIVE)){
+			next_sample_ns = SIM_NEVER;
+		}
+		else if(!was_active){
+			next_sample_ns = host_time_ns + odr_period_ns[(val >> CTRL1_DR_SHIFT) & 0x07];
+		}
+	}
+	sim_pins_update();
+}
+
+/**
+ * @function sim_mma_next
+ * @brief  	 Register after reg with auto increment
+ * @param    reg	register just accessed
+ * @return   next register
+ */
+static uint8_t sim_mma_next(uint8_t reg){
+	if((reg == REG_ZLO) && (regs[REG_F_SETUP] & 0xC0)){
+		return REG_XHI;					//FIFO burst wraps on the sample registers
+	}
+	return reg + 1;
+}
+
+static const sim_i2c_slave sim_mma_slave = {MMA_ADDR, sim_mma_read, sim_mma_write, sim_mma_next};
+
+static uint64_t sim_mma_next_ns(void){
+	return next_sample_ns;
+}
+
+/**
+ * @function sim_mma_fire
+ * @brief  	 Conversion at the data rate
+ * @param    none
+ * @return   none
+ */
+static void sim_mma_fire(void){
+	if(next_sample_ns > host_time_ns){
+		return;
+	}
+	sim_convert();
+	next_sample_ns += odr_period_ns[(regs[REG_CTRL1] >> CTRL1_DR_SHIFT) & 0x07];
+	sim_pins_update();
+}
+
+/**
+ * @function sim_mma_irq
+ * @brief  	 Run PORTA_IRQHandler if a pin interrupt is pending. The
+ * 			 handler clears the flags it reads on entry, edges seen
+ * 			 while it runs latch again.
+ * @param    none
+ * @return   1 if the handler ran
+ */
+static int sim_mma_irq(void){
+	uint32_t flags;
+
+	sim_pins_update();
+	flags = isf;
+	if(flags == 0){
+		return 0;
+	}
+	sim_mma.irqs++;
+	isf &= ~flags;						//Cleared by the handler once read
+	sim_porta.ISFR = flags;
+	host_isr_run(PORTA_IRQHandler);
+	sim_pins_update();
+	return 1;
+}
+
+static const host_device sim_mma_device = {sim_mma_next_ns, sim_mma_fire, sim_mma_irq};
+
+/**
+ * @function sim_mma_init
+ * @brief  	 Reset the sensor model and attach it to the simulated bus
+ * @param    none
+ * @return   none
+ */
+void sim_mma_init(void){
+	host_add_device(&sim_mma_device);
+	sim_i2c_init(&sim_mma_slave);
+	sim_pins_update();
+}
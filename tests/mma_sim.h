@@ -0,0 +1,51 @@
+/**@file: mma_sim.h
+ * @brief: Model of the MMA8451 on the simulated I2C0 bus, for the host
+ *			tests of mma8451.c
+ *			samples produced at the configured data rate, the sample
+ *			number n is encoded in X (n mod 4096 counts) with Y = 0 and
+ *			Z = 1g, or generated by sim_mma.signal when set
+ *			32 sample FIFO (circular mode, watermark, overflow), data
+ *			ready, F_STATUS, register wrap of OUT_X_MSB..OUT_Z_LSB in
+ *			FIFO mode
+ *			INT1 (FIFO) / INT2 (data ready) on PTA14 / PTA15 and the
+ *			PORTA pin interrupts, edge or level as set in PCR IRQC
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://www.nxp.com/docs/en/data-sheet/MMA8451Q.pdf
+ */
+#ifndef MMA_SIM_H_
+#define MMA_SIM_H_
+
+#include <stdint.h>
+
+extern PORT_Type sim_porta;
+extern GPIO_Type sim_gpioa;
+
+#undef PORTA
+#define PORTA						(&sim_porta)
+#undef GPIOA
+#define GPIOA						(&sim_gpioa)
+
+//What the sensor did
+typedef struct{
+	uint32_t produced;					//Samples converted
+	uint32_t read;						//Samples read out by the master
+	uint32_t overflows;					//Samples lost in the FIFO
+	uint32_t irqs;						//PORTA handlers run
+	uint32_t max_fifo;					//Highest F_CNT seen
+	int16_t (*signal)(uint32_t n, uint8_t axis);	//Custom 14 bit sample, NULL for the ramp
+}sim_mma_stats;
+
+extern sim_mma_stats sim_mma;
+
+/**
+ * @function sim_mma_init
+ * @brief  	 Reset the sensor model and attach it to the simulated bus
+ * @param    none
+ * @return   none
+ */
+void sim_mma_init(void);
+
+#endif /* MMA_SIM_H_ */
@@ -0,0 +1,165 @@
+/**@file: systick_sim.c
+ * @brief: Model of the Cortex-M0+ SysTick timer clocked by the core, for
+ *			the host tests of timer.c
+ *			the counter runs down from LOAD at the simulated core clock,
+ *			a write to VAL restarts it, a new LOAD is taken at the next
+ *			reload, the reload raises SysTick_Handler and PENDSTSET in
+ *			SCB->ICSR until the handler runs
+ *			sim_systick_set_core_hz changes the core clock the way a
+ *			clock configuration switch does, SystemCoreClock included
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://developer.arm.com/documentation/dui0662/b/Cortex-M0--Peripherals/Optional-System-timer--SysTick
+ */
+
+#include "host.h"
+
+#define SIM_NEVER			UINT64_MAX
+#define SIM_REG_NS			20			//Cost of one register access
+
+SysTick_Type sim_systick;
+SCB_Type sim_scb;
+uint32_t SystemCoreClock;
+
+static uint32_t core_hz;
+static uint64_t start_ns;				//Counter was at load
+static uint32_t load;					//Reload value of the current period
+static uint32_t shown_val;				//VAL presented to the CPU
+static uint8_t enabled;
+static uint8_t pending;					//Interrupt raised, handler not run yet
+
+void SysTick_Handler(void);
+
+/**
+ * @function sim_counts
+ * @brief  	 Counts since the start of the period
+ * @param    none
+ * @return   SysTick counts
+ */
+static uint64_t sim_counts(void){
+	return ((host_time_ns - start_ns) * core_hz) / 1000000000ULL;
+}
+
+/**
+ * @function sim_period_ns
+ * @brief  	 Length of a full period of the counter
+ * @param    none
+ * @return   time in ns
+ */
+static uint64_t sim_period_ns(void){
+	return ((((uint64_t)load + 1) * 1000000000ULL) + core_hz - 1) / core_hz;
+}
+
+/**
+ * @function sim_absorb
+ * @brief  	 Apply what the CPU wrote since the last access: enable, VAL
+ * 			 cleared
+ * @param    none
+ * @return   none
+ */
+static void sim_absorb(void){
+	uint8_t en = (sim_systick.CTRL & SysTick_CTRL_ENABLE_Msk) != 0;
+
+	if((en && !enabled) || (sim_systick.VAL != shown_val)){
+		start_ns = host_time_ns;		//Reloads from LOAD
+		load = sim_systick.LOAD & SysTick_LOAD_RELOAD_Msk;
+	}
+	enabled = en;
+}
+
+/**
+ * @function sim_present
+ * @brief  	 Show the counter and the pending flag to the CPU
+ * @param    none
+ * @return   none
+ */
+static void sim_present(void){
+	uint64_t counts = sim_counts();
+
+	sim_systick.VAL = enabled ? (uint32_t)((counts > load) ? 0 : (load - counts)) : 0;
+	shown_val = sim_systick.VAL;
+	sim_scb.ICSR = pending ? SCB_ICSR_PENDSTSET_Msk : 0;
+}
+
+/**
+ * @function sim_systick_sync
+ * @brief  	 Called before each SysTick or SCB access of the driver
+ * @param    none
+ * @return   none
+ */
+void sim_systick_sync(void){
+	sim_absorb();
+	host_advance_ns(SIM_REG_NS);
+	sim_present();
+}
+
+static uint64_t sim_systick_next_ns(void){
+	return enabled ? (start_ns + sim_period_ns()) : SIM_NEVER;
+}
+
+/**
+ * @function sim_systick_fire
+ * @brief  	 Reload at the end of each period
+ * @param    none
+ * @return   none
+ */
+static void sim_systick_fire(void){
+	while(enabled && ((start_ns + sim_period_ns()) <= host_time_ns)){
+		start_ns += sim_period_ns();
+		load = sim_systick.LOAD & SysTick_LOAD_RELOAD_Msk;
+		if(sim_systick.CTRL & SysTick_CTRL_TICKINT_Msk){
+			pending = 1;
+		}
+	}
+	sim_present();
+}
+
+/**
+ * @function sim_systick_irq
+ * @brief  	 Run SysTick_Handler if the timer interrupt is pending
+ * @param    none
+ * @return   1 if the handler ran
+ */
+static int sim_systick_irq(void){
+	if(!pending){
+		return 0;
+	}
+	pending = 0;						//PENDSTSET cleared on entry
+	sim_present();
+	host_isr_run(SysTick_Handler);
+	return 1;
+}
+
+static const host_device sim_systick_device = {sim_systick_next_ns, sim_systick_fire, sim_systick_irq};
+
+/**
+ * @function sim_systick_init
+ * @brief  	 Reset the timer model and attach it to the simulated time
+ * @param    core_hz	core clock
+ * @return   none
+ */
+void sim_systick_init(uint32_t hz){
+	core_hz = hz;
+	SystemCoreClock = hz;
+	host_add_device(&sim_systick_device);
+	sim_present();
+}
+
+/**
+ * @function sim_systick_set_core_hz
+ * @brief  	 Switch the core clock, the counter keeps its value and counts
+ * 			 at the new rate. SystemCoreClock is updated as the board
+ * 			 clock functions do.
+ * @param    core_hz	new core clock
+ * @return   none
+ */
+void sim_systick_set_core_hz(uint32_t hz){
+	uint64_t counts = sim_counts();
+
+	core_hz = hz;
+	start_ns = host_time_ns - ((counts * 1000000000ULL) / hz);
+	SystemCoreClock = hz;
+	sim_present();
+}
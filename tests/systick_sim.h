@@ -0,0 +1,50 @@
+/**@file: systick_sim.h
+ * @brief: Model of the Cortex-M0+ SysTick timer clocked by the core, for
+ *			the host tests of timer.c
+ *			the counter runs down from LOAD at the simulated core clock,
+ *			a write to VAL restarts it, a new LOAD is taken at the next
+ *			reload, the reload raises SysTick_Handler and PENDSTSET in
+ *			SCB->ICSR until the handler runs
+ *			sim_systick_set_core_hz changes the core clock the way a
+ *			clock configuration switch does, SystemCoreClock included
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ * @Credits: https://developer.arm.com/documentation/dui0662/b/Cortex-M0--Peripherals/Optional-System-timer--SysTick
+ */
+#ifndef SYSTICK_SIM_H_
+#define SYSTICK_SIM_H_
+
+#include <stdint.h>
+
+extern SysTick_Type sim_systick;
+extern SCB_Type sim_scb;
+
+void sim_systick_sync(void);
+
+//Every register access first lets the model see the previous write
+#undef SysTick
+#define SysTick						(sim_systick_sync(), &sim_systick)
+#undef SCB
+#define SCB							(sim_systick_sync(), &sim_scb)
+
+/**
+ * @function sim_systick_init
+ * @brief  	 Reset the timer model and attach it to the simulated time
+ * @param    core_hz	core clock
+ * @return   none
+ */
+void sim_systick_init(uint32_t core_hz);
+
+/**
+ * @function sim_systick_set_core_hz
+ * @brief  	 Switch the core clock, the counter keeps its value and counts
+ * 			 at the new rate. SystemCoreClock is updated as the board
+ * 			 clock functions do.
+ * @param    core_hz	new core clock
+ * @return   none
+ */
+void sim_systick_set_core_hz(uint32_t core_hz);
+
+#endif /* SYSTICK_SIM_H_ */
@@ -0,0 +1,115 @@
+/**@file: test_activity.c
+ * @brief: Host test of the activity classifier on the step pipeline of
+ *			main(): step_detect, the FFT cadence and activity_feed run on
+ *			the same synthetic stream
+ *			standing, walking (1.8 steps/s) and running (2.8 steps/s)
+ *			windows are classified idle, walk and run once the cadence
+ *			and the gravity estimate have settled
+ *			a full scale swing saturates the dynamic acceleration of the
+ *			gravity tracker instead of wrapping
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "activity.h"
+#include "cadence.h"
+#include "utility.h"
+
+#define RATE_HZ			GAIT_FS_HZ
+#define ONE_G			4096			//2g range counts
+#define SEGMENT_WINDOWS	5				//Windows of each activity
+#define SETTLE_WINDOWS	2				//Not checked after a change
+
+typedef struct{
+	const char *name;
+	double steps_per_s;					//0 standing
+	double bounce;						//Vertical bounce in 2g counts
+	activity_class expect;
+}segment;
+
+static const segment segments[] = {
+	{"idle", 0, 0, ACTIVITY_IDLE},
+	{"walk", 1.8, 1200, ACTIVITY_WALK},
+	{"run", 2.8, 3000, ACTIVITY_RUN},
+	{"walk", 1.8, 1200, ACTIVITY_WALK},
+	{"idle", 0, 0, ACTIVITY_IDLE},
+};
+
+static const char *const class_name[ACTIVITY_COUNT] = {"idle", "walk", "run", "stairs"};
+
+/**
+ * @function check_saturation
+ * @brief  	 A jump from +full scale to -full scale right after the
+ * 			 tracker is seeded gives the most negative dynamic value
+ * @param    none
+ * @return   none
+ */
+static void check_saturation(void){
+	gravity_tracker gt;
+	mma_sample_t s = {0, INT16_MAX, INT16_MIN, 0}, d;
+
+	gravity_init(&gt, RATE_HZ);
+	gravity_remove(&gt, &s, &d);
+	s.x = INT16_MIN;
+	s.y = INT16_MAX;
+	gravity_remove(&gt, &s, &d);
+	CHECK(d.x == INT16_MIN);
+	CHECK(d.y == INT16_MAX);
+	CHECK(d.z == 0);
+}
+
+int main(void){
+	activity_tracker act;
+	cadence_est cad;
+	step_detector det;
+	mma_sample_t block[STEP_BLOCK_LEN];
+	int16_t mag[STEP_BLOCK_LEN];
+	uint32_t window = 0, i = 0, wrong = 0;
+
+	printf("activity classifier, %d s windows\n", ACTIVITY_WINDOW_S);
+	check_saturation();
+
+	activity_init(&act, RATE_HZ);
+	cadence_init(&cad, RATE_HZ);
+	step_detector_init(&det, NULL);
+	for(uint8_t seg = 0; seg < sizeof(segments) / sizeof(segments[0]); seg++){
+		const segment *g = &segments[seg];
+		uint32_t seg_windows = 0;
+
+		printf("  %s:", g->name);
+		while(seg_windows < SEGMENT_WINDOWS){
+			uint16_t steps;
+
+			for(uint32_t j = 0; j < STEP_BLOCK_LEN; j++, i++){
+				double t = (double)i / RATE_HZ;
+
+				block[j].ts = (uint32_t)(t * 1000000);
+				block[j].x = (int16_t)((rand() % 41) - 20);
+				block[j].y = (int16_t)((rand() % 41) - 20);
+				block[j].z = (int16_t)(ONE_G + (g->bounce * sin(2.0 * M_PI * g->steps_per_s * t)));
+			}
+			steps = step_detect(&det, block, STEP_BLOCK_LEN, NULL, 0);
+			dsp_magnitude_q15(block, mag, STEP_BLOCK_LEN);
+			cadence_feed_block(&cad, mag, STEP_BLOCK_LEN);
+			if(activity_feed(&act, block, STEP_BLOCK_LEN, steps, cad.spm)){
+				printf(" %s", class_name[act.cls]);
+				if((seg_windows >= SETTLE_WINDOWS) && (act.cls != g->expect)){
+					printf(" (std %ld, %ld steps/min, cadence %ld, vertical %ld)",
+						(long)act.feat[FEAT_STD], (long)act.feat[FEAT_STEP_RATE],
+						(long)act.feat[FEAT_CADENCE], (long)act.feat[FEAT_VERT_RATIO]);
+					wrong++;
+				}
+				seg_windows++;
+				window++;
+			}
+		}
+		printf("\n");
+	}
+	CHECK(window == (SEGMENT_WINDOWS * (sizeof(segments) / sizeof(segments[0]))));
+	CHECK(wrong == 0);
+	return host_report("test_activity");
+}
@@ -0,0 +1,289 @@
+/**@file: test_biquad.c
+ * @brief: Host test of the gait band-pass of the step pipeline
+ *			the Q14 coefficients folded from GAIT_FS_HZ match a floating
+ *			point Butterworth design
+ *			the frequency response of dsp_biquad_q15 measured with sine
+ *			waves follows the design: pass band 0.5 - 5 Hz, gravity and
+ *			fast vibration rejected
+ *			filtering in blocks of any size gives the same output
+ *			cost per sample of the filter
+ *			step_detect counts the steps of a simulated walk and none
+ *			standing still
+ *			detectors with different step_tuning count differently on
+ *			the same stream
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include <time.h>
+#include "dsp.h"
+#include "utility.h"
+
+#define AMPLITUDE		8000			//Sine test input around the same offset
+#define SETTLE_S		20				//Filter settling before a measurement
+#define MEASURE_S		20				//Whole number of periods of every test frequency
+#define BENCH_N			100000
+#define MAX_NS_PER_SAMPLE	1000		//Host time budget, loose for slow machines
+
+static int16_t x[BENCH_N];
+static int16_t y[BENCH_N];
+
+/**
+ * @function butterworth
+ * @brief  	 Floating point reference of one 2nd order Butterworth
+ * 			 section, bilinear transform, CMSIS order and signs
+ * @param    1. fc		cut off frequency in Hz
+ * 			 2. high	1 for a high pass, 0 for a low pass
+ * 			 3. c		b0, 0, b1, b2, a1, a2
+ * @return   none
+ */
+static void butterworth(double fc, int high, double *c){
+	double k = tan(M_PI * fc / GAIT_FS_HZ);
+	double norm = 1.0 / (1.0 + (M_SQRT2 * k) + (k * k));
+
+	c[0] = high ? norm : (k * k * norm);
+	c[1] = 0;
+	c[2] = high ? (-2.0 * c[0]) : (2.0 * c[0]);
+	c[3] = c[0];
+	c[4] = 2.0 * (1.0 - (k * k)) * norm;
+	c[5] = -(1.0 - (M_SQRT2 * k) + (k * k)) * norm;
+}
+
+/**
+ * @function reference_gain_db
+ * @brief  	 Gain of the reference design at a frequency
+ * @param    1. ref	coefficients of both sections
+ * 			 2. f	frequency in Hz
+ * @return   gain in dB
+ */
+static double reference_gain_db(const double *ref, double f){
+	double w = 2.0 * M_PI * f / GAIT_FS_HZ;
+	double g = 1.0;
+
+	for(int st = 0; st < GAIT_BANDPASS_STAGES; st++){
+		const double *c = &ref[6 * st];
+		double nr = c[0] + (c[2] * cos(w)) + (c[3] * cos(2 * w));
+		double ni = -(c[2] * sin(w)) - (c[3] * sin(2 * w));
+		double dr = 1.0 - (c[4] * cos(w)) - (c[5] * cos(2 * w));
+		double di = (c[4] * sin(w)) + (c[5] * sin(2 * w));
+
+		g *= sqrt(((nr * nr) + (ni * ni)) / ((dr * dr) + (di * di)));
+	}
+	return 20.0 * log10(g);
+}
+
+/**
+ * @function measured_gain_db
+ * @brief  	 Filter an offset sine and measure the output amplitude at
+ * 			 its frequency once the filter has settled, by correlation
+ * 			 over a whole number of periods
+ * @param    f	frequency in Hz, a multiple of 1 / MEASURE_S
+ * @return   gain in dB
+ */
+static double measured_gain_db(double f){
+	dsp_biquad_q15_t bp;
+	int16_t state[4 * GAIT_BANDPASS_STAGES];
+	uint32_t settle = SETTLE_S * GAIT_FS_HZ;
+	uint32_t n = settle + (MEASURE_S * GAIT_FS_HZ);
+	double re = 0, im = 0;
+
+	for(uint32_t i = 0; i < n; i++){
+		x[i] = (int16_t)lround(AMPLITUDE + (AMPLITUDE * sin(2.0 * M_PI * f * i / GAIT_FS_HZ)));
+	}
+	dsp_biquad_init_q15(&bp, GAIT_BANDPASS_STAGES, gait_bandpass_coeffs, state, GAIT_BANDPASS_SHIFT);
+	dsp_biquad_q15(&bp, x, y, n);
+	for(uint32_t i = settle; i < n; i++){
+		re += y[i] * cos(2.0 * M_PI * f * i / GAIT_FS_HZ);
+		im += y[i] * sin(2.0 * M_PI * f * i / GAIT_FS_HZ);
+	}
+	return 20.0 * log10((2.0 * sqrt((re * re) + (im * im)) / (n - settle)) / AMPLITUDE);
+}
+
+/**
+ * @function check_response
+ * @brief  	 Compare the measured response with the reference design
+ * @param    ref	coefficients of both sections
+ * @return   none
+ */
+static void check_response(const double *ref){
+	static const double freqs[] = {0.1, 0.25, 0.5, 1, 2, 3, 5, 8, 12, 20};
+
+	printf("  f (Hz)  design  measured (dB)\n");
+	for(uint32_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++){
+		double want = reference_gain_db(ref, freqs[i]);
+		double got = measured_gain_db(freqs[i]);
+
+		printf("  %6.2f  %6.1f  %6.1f\n", freqs[i], want, got);
+		//Q14 coefficients and a 16 bit output are good to a fraction of
+		//a dB in the band, the small stop band outputs are coarser
+		CHECK(fabs(got - want) < ((want > -20) ? 0.2 : 1.0));
+	}
+	CHECK(measured_gain_db(1.5) > -0.5);				//Walking cadence
+	CHECK(measured_gain_db(0.1) < -20);					//Posture changes
+	CHECK(measured_gain_db(20) < -20);					//Vibration
+}
+
+/**
+ * @function check_blocks
+ * @brief  	 Filtering in blocks of varying size gives the output of one
+ * 			 block
+ * @param    none
+ * @return   none
+ */
+static void check_blocks(void){
+	dsp_biquad_q15_t bp;
+	int16_t state[4 * GAIT_BANDPASS_STAGES];
+	int16_t part[BENCH_N / 4];
+	uint32_t n = 1000, diff = 0;
+
+	for(uint32_t i = 0; i < n; i++){
+		x[i] = (int16_t)((i * 7919) % 16000);
+	}
+	dsp_biquad_init_q15(&bp, GAIT_BANDPASS_STAGES, gait_bandpass_coeffs, state, GAIT_BANDPASS_SHIFT);
+	dsp_biquad_q15(&bp, x, y, n);
+
+	dsp_biquad_init_q15(&bp, GAIT_BANDPASS_STAGES, gait_bandpass_coeffs, state, GAIT_BANDPASS_SHIFT);
+	for(uint32_t i = 0, len = 1; i < n; i += len, len = (len % 13) + 1){
+		if(len > (n - i)){
+			len = n - i;
+		}
+		dsp_biquad_q15(&bp, &x[i], &part[i], len);
+	}
+	for(uint32_t i = 0; i < n; i++){
+		diff += (part[i] != y[i]);
+	}
+	CHECK(diff == 0);
+}
+
+/**
+ * @function check_cost
+ * @brief  	 Time of the filter per sample on the host, and the update
+ * 			 of the cycle count recorded in the instance
+ * @param    none
+ * @return   none
+ */
+static void check_cost(void){
+	dsp_biquad_q15_t bp;
+	int16_t state[4 * GAIT_BANDPASS_STAGES];
+	struct timespec t0, t1;
+	uint64_t ns;
+
+	for(uint32_t i = 0; i < BENCH_N; i++){
+		x[i] = (int16_t)((i * 7919) % 16000);
+	}
+	dsp_biquad_init_q15(&bp, GAIT_BANDPASS_STAGES, gait_bandpass_coeffs, state, GAIT_BANDPASS_SHIFT);
+	clock_gettime(CLOCK_MONOTONIC, &t0);
+	dsp_biquad_q15(&bp, x, y, BENCH_N);
+	clock_gettime(CLOCK_MONOTONIC, &t1);
+	ns = ((uint64_t)(t1.tv_sec - t0.tv_sec) * 1000000000ULL) + t1.tv_nsec - t0.tv_nsec;
+
+	//5 multiply accumulates per stage and sample
+	printf("  %d MAC per sample, host %.1f ns per sample\n", 5 * GAIT_BANDPASS_STAGES, (double)ns / BENCH_N);
+	CHECK((ns / BENCH_N) < MAX_NS_PER_SAMPLE);
+	CHECK(bp.cycles > 0);					//Simulated clock on the host, only the update is checked
+}
+
+/**
+ * @function walk_block
+ * @brief  	 One block of simulated acceleration: 1g on Z plus a vertical
+ * 			 bounce at the step rate and some vibration
+ * @param    1. block			STEP_BLOCK_LEN samples
+ * 			 2. i				index of the first sample in the stream
+ * 			 3. steps_per_s		step rate, 0 standing still
+ * 			 4. bounce			amplitude of the bounce in 2g counts
+ * @return   none
+ */
+static void walk_block(mma_sample_t *block, uint32_t i, double steps_per_s, double bounce){
+	for(uint32_t j = 0; j < STEP_BLOCK_LEN; j++){
+		double t = (double)(i + j) / GAIT_FS_HZ;
+
+		block[j].ts = (uint32_t)(t * 1000000);
+		block[j].x = (int16_t)(300 * sin(2.0 * M_PI * 0.2 * t));
+		block[j].y = (int16_t)(((i + j) & 1) ? 60 : -60);
+		block[j].z = (int16_t)(4096 + (bounce * sin(2.0 * M_PI * steps_per_s * t)));
+	}
+}
+
+/**
+ * @function walk
+ * @brief  	 Count the steps of 20 s of simulated walk with the default
+ * 			 detector
+ * @param    1. steps_per_s	step rate, 0 standing still
+ * 			 2. bounce		amplitude of the bounce in 2g counts
+ * @return   steps counted
+ */
+static uint32_t walk(double steps_per_s, double bounce){
+	step_detector det;
+	mma_sample_t block[STEP_BLOCK_LEN];
+	uint32_t steps = 0;
+
+	step_detector_init(&det, NULL);
+	for(uint32_t i = 0; i < (20 * GAIT_FS_HZ); i += STEP_BLOCK_LEN){
+		walk_block(block, i, steps_per_s, bounce);
+		steps += step_detect(&det, block, STEP_BLOCK_LEN, NULL, 0);
+	}
+	return steps;
+}
+
+/**
+ * @function check_tunings
+ * @brief  	 Detectors with different tunings side by side on the same
+ * 			 20 s of fast walk: a longer minimum interval drops every
+ * 			 other step, a larger minimum swing ignores the walk
+ * @param    none
+ * @return   none
+ */
+static void check_tunings(void){
+	const step_tuning slow = {STEP_MIN_SWING, 500000, 5};		//At most 2 steps/s
+	const step_tuning stiff = {3000, STEP_MIN_INTERVAL_US, 5};	//Swing of 0.75g or more
+	step_detector det[3];
+	mma_sample_t block[STEP_BLOCK_LEN];
+	uint32_t steps[3] = {0, 0, 0};
+
+	step_detector_init(&det[0], NULL);
+	step_detector_init(&det[1], &slow);
+	step_detector_init(&det[2], &stiff);
+	for(uint32_t i = 0; i < (20 * GAIT_FS_HZ); i += STEP_BLOCK_LEN){
+		walk_block(block, i, 2.8, 1200);
+		for(uint8_t d = 0; d < 3; d++){
+			steps[d] += step_detect(&det[d], block, STEP_BLOCK_LEN, NULL, 0);
+		}
+	}
+	printf("  walk 2.8 steps/s for 20 s: %lu steps default, %lu with 500 ms minimum interval, "
+		"%lu with 3000 minimum swing\n", (unsigned long)steps[0], (unsigned long)steps[1],
+		(unsigned long)steps[2]);
+	CHECK((steps[0] >= 54) && (steps[0] <= 57));
+	CHECK((steps[1] >= 26) && (steps[1] <= 29));
+	CHECK(steps[2] == 0);
+}
+
+int main(void){
+	double ref[6 * GAIT_BANDPASS_STAGES];
+	uint32_t coeff_err = 0, steps;
+
+	printf("gait band-pass at %d Hz\n", GAIT_FS_HZ);
+	butterworth(GAIT_HPF_HZ, 1, &ref[0]);
+	butterworth(GAIT_LPF_HZ, 0, &ref[6]);
+	for(int i = 0; i < 6 * GAIT_BANDPASS_STAGES; i++){
+		if(labs(gait_bandpass_coeffs[i] - lround(ref[i] * 16384)) > 1){
+			coeff_err++;
+		}
+	}
+	CHECK(coeff_err == 0);
+
+	check_response(ref);
+	check_blocks();
+	check_cost();
+
+	steps = walk(1.8, 1200);
+	printf("  walk 1.8 steps/s for 20 s: %lu steps, standing: %lu\n",
+		(unsigned long)steps, (unsigned long)walk(0, 0));
+	CHECK((steps >= 35) && (steps <= 37));
+	CHECK(walk(0, 0) == 0);
+	check_tunings();
+	return host_report("test_biquad");
+}
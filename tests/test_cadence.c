@@ -0,0 +1,110 @@
+/**@file: test_cadence.c
+ * @brief: Host test of the FFT cadence estimator
+ *			gait tones at known cadences on the 50 Hz magnitude stream
+ *			give their steps per minute, also with vibration on top
+ *			no cadence standing still, on noise and when the gait band
+ *			holds no bin (no interpolation around an empty peak)
+ *			analysis every CADENCE_HOP samples once the window is full
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "cadence.h"
+#include "mma8451.h"
+
+#define RATE_HZ			MMA_STREAM_RATE_HZ
+#define RUN_SAMPLES		(4 * CADENCE_FFT_LEN)
+#define ONE_G			4096			//2g range counts
+#define SPM_TOLERANCE	3
+
+//Magnitude at sample i of a test signal
+typedef int16_t (*signal_fn)(uint32_t i, double arg);
+
+/**
+ * @function gait
+ * @brief  	 1g plus the vertical bounce of a walk at arg steps per minute
+ * 			 and a small 9 Hz vibration
+ */
+static int16_t gait(uint32_t i, double arg){
+	double t = (double)i / RATE_HZ;
+
+	return (int16_t)(ONE_G + (800 * sin(2.0 * M_PI * (arg / 60.0) * t)) +
+		(60 * sin(2.0 * M_PI * 9.0 * t)));
+}
+
+/**
+ * @function still
+ * @brief  	 1g and the least significant bit toggling
+ */
+static int16_t still(uint32_t i, double arg){
+	return (int16_t)(ONE_G + (i & 1));
+}
+
+/**
+ * @function noise
+ * @brief  	 1g and uniform noise of +/- arg counts
+ */
+static int16_t noise(uint32_t i, double arg){
+	return (int16_t)(ONE_G + (rand() % (2 * (int)arg + 1)) - (int)arg);
+}
+
+/**
+ * @function run
+ * @brief  	 Feed RUN_SAMPLES of a signal in blocks and check that an
+ * 			 analysis comes every CADENCE_HOP samples once the window is
+ * 			 full
+ * @param    1. est		estimator, reset here
+ * 			 2. rate_hz	sample rate given to the estimator
+ * 			 3. fn		signal
+ * 			 4. arg		signal parameter
+ * @return   last cadence in steps per minute
+ */
+static uint16_t run(cadence_est *est, uint16_t rate_hz, signal_fn fn, double arg){
+	int16_t block[10];
+	uint32_t updates = 0;
+
+	cadence_init(est, rate_hz);
+	for(uint32_t i = 0; i < RUN_SAMPLES; i += 10){
+		for(uint32_t j = 0; j < 10; j++){
+			block[j] = fn(i + j, arg);
+		}
+		updates += cadence_feed_block(est, block, 10);
+	}
+	CHECK(updates == (((RUN_SAMPLES - CADENCE_FFT_LEN) / CADENCE_HOP) + 1));
+	return est->spm;
+}
+
+int main(void){
+	static const uint16_t cadences[] = {60, 90, 100, 115, 120, 135, 150, 170, 180, 200};
+	cadence_est est;
+	uint16_t spm;
+
+	printf("FFT cadence, %d points at %d Hz\n", CADENCE_FFT_LEN, RATE_HZ);
+	for(uint8_t i = 0; i < sizeof(cadences) / sizeof(cadences[0]); i++){
+		spm = run(&est, RATE_HZ, gait, cadences[i]);
+		printf("  gait at %3u spm: %3u spm\n", cadences[i], spm);
+		CHECK(abs((int)spm - (int)cadences[i]) <= SPM_TOLERANCE);
+		CHECK(est.peak > 0);
+	}
+
+	spm = run(&est, RATE_HZ, still, 0);
+	printf("  standing: %u spm\n", spm);
+	CHECK(spm == 0);
+
+	srand(1);
+	spm = run(&est, RATE_HZ, noise, 400);
+	printf("  noise: %u spm\n", spm);
+	CHECK(spm == 0);
+
+	//At 4 kHz the 0.5 - 4 Hz band falls between bins 0 and 1, no bin to
+	//search, no peak and no neighbours to interpolate
+	spm = run(&est, 4000, gait, 120);
+	printf("  gait at 120 spm given as 4 kHz: %u spm, band peak %u\n", spm, est.peak);
+	CHECK(spm == 0);
+	CHECK(est.peak == 0);
+	return host_report("test_cadence");
+}
@@ -0,0 +1,155 @@
+/**@file: test_gravity.c
+ * @brief: Host test of the gravity tracker and of step counting while
+ *			the device turns
+ *			a walk with gravity on Z, then X, then -Y, then half way
+ *			between Y and Z, each reached by a one second rotation
+ *			the tracker converges on the new gravity within a few time
+ *			constants and picks the right vertical axis for the activity
+ *			features, the bounce is left in the dynamic part
+ *			step_detect (magnitude and gait band-pass, no gravity
+ *			tracker) counts the same steps in every orientation
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <math.h>
+#include <stdlib.h>
+#include "dsp.h"
+#include "utility.h"
+
+#define ONE_G			4096			//2g range counts
+#define SEGMENT_S		20				//Time spent in each orientation
+#define TURN_S			1				//Rotation to the next orientation
+#define STEP_HZ			1.8
+#define BOUNCE			1200			//Vertical bounce of the walk in 2g counts
+#define CONVERGED		(ONE_G / 10)	//Largest error of a settled estimate
+#define SEGMENTS		4
+
+//Direction of gravity in each segment, unit vectors
+static const double orient[SEGMENTS][3] = {
+	{0, 0, 1}, {1, 0, 0}, {0, -1, 0}, {0, M_SQRT1_2, M_SQRT1_2},
+};
+static const char *const orient_name[SEGMENTS] = {"Z", "X", "-Y", "Y+Z"};
+
+/**
+ * @function direction
+ * @brief  	 Gravity direction at a time of the walk, turning linearly
+ * 			 from the previous orientation during the first TURN_S of a
+ * 			 segment
+ * @param    1. t		time in s
+ * 			 2. u		unit vector
+ * @return   none
+ */
+static void direction(double t, double *u){
+	uint32_t seg = (uint32_t)(t / SEGMENT_S);
+	double f = (t - (seg * SEGMENT_S)) / TURN_S;
+	double len = 0;
+
+	if((seg == 0) || (f >= 1)){
+		f = 1;
+	}
+	for(uint8_t a = 0; a < 3; a++){
+		u[a] = (seg ? (orient[seg - 1][a] * (1 - f)) : 0) + (orient[seg][a] * f);
+		len += u[a] * u[a];
+	}
+	for(uint8_t a = 0; a < 3; a++){
+		u[a] /= sqrt(len);
+	}
+}
+
+/**
+ * @function error
+ * @brief  	 Distance between the estimate and the gravity of a segment
+ * @param    1. gt		tracker state
+ * 			 2. seg		segment
+ * @return   error in counts
+ */
+static uint32_t error(const gravity_tracker *gt, uint32_t seg){
+	double dx = (gt->gx / 256.0) - (orient[seg][0] * ONE_G);
+	double dy = (gt->gy / 256.0) - (orient[seg][1] * ONE_G);
+	double dz = (gt->gz / 256.0) - (orient[seg][2] * ONE_G);
+
+	return (uint32_t)sqrt((dx * dx) + (dy * dy) + (dz * dz));
+}
+
+int main(void){
+	gravity_tracker gt;
+	step_detector det;
+	mma_sample_t block[STEP_BLOCK_LEN];
+	uint32_t steps[SEGMENTS] = {0}, settle_ms[SEGMENTS], end_err[SEGMENTS];
+	uint8_t vert[SEGMENTS];
+	double dyn_along[SEGMENTS] = {0}, dyn_total[SEGMENTS] = {0};
+	uint32_t tau_ms;
+
+	gravity_init(&gt, GAIT_FS_HZ);
+	step_detector_init(&det, NULL);
+	tau_ms = ((1UL << gt.shift) * 1000) / GAIT_FS_HZ;
+	printf("gravity tracker, time constant %lu ms\n", (unsigned long)tau_ms);
+	for(uint32_t s = 0; s < SEGMENTS; s++){
+		settle_ms[s] = UINT32_MAX;
+	}
+
+	for(uint32_t i = 0; i < (SEGMENTS * SEGMENT_S * GAIT_FS_HZ); i += STEP_BLOCK_LEN){
+		uint32_t seg = i / (SEGMENT_S * GAIT_FS_HZ);
+		uint32_t ms_in = ((i % (SEGMENT_S * GAIT_FS_HZ)) * 1000) / GAIT_FS_HZ;
+
+		for(uint32_t j = 0; j < STEP_BLOCK_LEN; j++){
+			double t = (double)(i + j) / GAIT_FS_HZ;
+			double u[3], a;
+			mma_sample_t d;
+
+			direction(t, u);
+			a = ONE_G + (BOUNCE * sin(2.0 * M_PI * STEP_HZ * t));
+			block[j].ts = (uint32_t)(t * 1000000);
+			block[j].x = (int16_t)lround(a * u[0]);
+			block[j].y = (int16_t)lround(a * u[1]);
+			block[j].z = (int16_t)lround(a * u[2]);
+
+			//Bounce seen in the dynamic part, once settled
+			gravity_remove(&gt, &block[j], &d);
+			if(ms_in >= (SEGMENT_S * 500)){
+				double along = (d.x * u[0]) + (d.y * u[1]) + (d.z * u[2]);
+
+				dyn_along[seg] += along * along;
+				dyn_total[seg] += ((double)d.x * d.x) + ((double)d.y * d.y) + ((double)d.z * d.z);
+			}
+		}
+		steps[seg] += step_detect(&det, block, STEP_BLOCK_LEN, NULL, 0);
+
+		//First time the estimate is within CONVERGED of the new gravity
+		if((settle_ms[seg] == UINT32_MAX) && (error(&gt, seg) < CONVERGED)){
+			settle_ms[seg] = ms_in + ((STEP_BLOCK_LEN * 1000) / GAIT_FS_HZ);
+		}
+		if(((i + STEP_BLOCK_LEN) % (SEGMENT_S * GAIT_FS_HZ)) == 0){
+			end_err[seg] = error(&gt, seg);
+			vert[seg] = 0;
+			if(abs(gt.gy) > abs(gt.gx)){
+				vert[seg] = 1;
+			}
+			if(abs(gt.gz) > abs((vert[seg] == 1) ? gt.gy : gt.gx)){
+				vert[seg] = 2;
+			}
+		}
+	}
+
+	for(uint32_t s = 0; s < SEGMENTS; s++){
+		double share = dyn_total[s] ? (dyn_along[s] / dyn_total[s]) : 0;
+		uint8_t axis = 0;
+
+		for(uint8_t a = 1; a < 3; a++){
+			axis = (fabs(orient[s][a]) > fabs(orient[s][axis])) ? a : axis;
+		}
+		printf("  gravity on %-3s: settled in %lu ms, error %lu counts at the end, vertical axis %c, "
+			"%.0f%% of the dynamic part along gravity, %lu steps\n", orient_name[s],
+			(unsigned long)settle_ms[s], (unsigned long)end_err[s], 'X' + vert[s], share * 100,
+			(unsigned long)steps[s]);
+		CHECK(settle_ms[s] <= ((TURN_S * 1000) + (4 * tau_ms)));
+		CHECK(end_err[s] < CONVERGED);
+		CHECK((s == (SEGMENTS - 1)) || (vert[s] == axis));	//Y+Z is a tie
+		CHECK(share > 0.9);
+		CHECK(abs((int)steps[s] - (int)(STEP_HZ * SEGMENT_S)) <= 1);
+	}
+	return host_report("test_gravity");
+}
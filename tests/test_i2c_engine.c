@@ -0,0 +1,267 @@
+/**@file: test_i2c_engine.c
+ * @brief: Host test of the interrupt driven I2C0 engine on the simulated
+ *			I2C0 (i2c_sim.c) with an accelerometer like register file
+ *			blocking block reads / writes and batches return the slave data
+ *			descriptors with a data phase but no length or buffer are refused
+ *			timer_clock_changed() reprograms the SCL divider after a bus
+ *			clock switch
+ *			a completion callback resubmitting its own descriptor, with
+ *			other transactions queued, runs them all without touching the
+ *			transaction on the bus
+ *			throughput and CPU time of the per byte interrupt mode, the
+ *			DMA mode and the blocking calls at the default SCL rate
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <string.h>
+#include "i2c.h"
+#include "timer.h"
+
+#define DEV_ADDR		0x3A
+#define RUN_NS			200000000ULL	//Simulated time of each throughput run
+#define CHAIN_LEN		50
+
+static uint8_t regs[256];
+
+static uint8_t slave_read(uint8_t reg){
+	return regs[reg];
+}
+
+static void slave_write(uint8_t reg, uint8_t val){
+	regs[reg] = val;
+}
+
+static const sim_i2c_slave slave = {DEV_ADDR, slave_read, slave_write, NULL};
+
+static i2c_xfer_t chain;
+static i2c_xfer_t other;
+static uint8_t chain_buf[32];
+static uint8_t other_buf[6];
+static uint32_t chain_done;
+static uint32_t chain_limit;
+static uint32_t chain_bad;
+
+/**
+ * @function chain_cb
+ * @brief  	 Check the data and resubmit the same descriptor from the
+ * 			 completion callback
+ * @param    xfer	finished transaction
+ * @return   none
+ */
+static void chain_cb(i2c_xfer_t *xfer){
+	if((xfer->status != I2C_STATUS_DONE) || memcmp(xfer->buf, &regs[xfer->reg], xfer->len)){
+		chain_bad++;
+	}
+	if(++chain_done < chain_limit){
+		if(!I2C_submit(xfer)){
+			chain_bad++;
+		}
+	}
+}
+
+/**
+ * @function other_cb
+ * @brief  	 Keep a second transaction queued behind the chain
+ * @param    xfer	finished transaction
+ * @return   none
+ */
+static void other_cb(i2c_xfer_t *xfer){
+	if((xfer->status != I2C_STATUS_DONE) || memcmp(xfer->buf, &regs[xfer->reg], xfer->len)){
+		chain_bad++;
+	}
+	if(chain_done < chain_limit){
+		I2C_submit(xfer);
+	}
+}
+
+/**
+ * @function run_chain
+ * @brief  	 Run callback chained reads until limit completions
+ * @param    1. len		bytes per read
+ * 			 2. flags	I2C_XFER_xxx flags
+ * 			 3. limit	completions of the chained descriptor
+ * 			 4. with_other	keep a second descriptor queued
+ * @return   simulated time taken in ns
+ */
+static uint64_t run_chain(uint16_t len, uint8_t flags, uint32_t limit, int with_other){
+	uint64_t start = host_time_ns;
+
+	chain.dev = DEV_ADDR;
+	chain.reg = 0x01;
+	chain.dir = I2C_XFER_READ;
+	chain.buf = chain_buf;
+	chain.len = len;
+	chain.flags = flags;
+	chain.callback = chain_cb;
+	other.dev = DEV_ADDR;
+	other.reg = 0x40;
+	other.dir = I2C_XFER_READ;
+	other.buf = other_buf;
+	other.len = sizeof(other_buf);
+	other.flags = 0;
+	other.callback = other_cb;
+	chain_done = 0;
+	chain_limit = limit;
+	chain_bad = 0;
+
+	CHECK(I2C_submit(&chain));
+	if(with_other){
+		CHECK(I2C_submit(&other));
+	}
+	while(!I2C_engine_idle() && ((host_time_ns - start) < (2 * RUN_NS))){
+		__WFI();
+	}
+	CHECK(I2C_engine_idle());
+	return host_time_ns - start;
+}
+
+/**
+ * @function report_rate
+ * @brief  	 Print and check the bus use and CPU time of a run
+ * @param    1. name		mode measured
+ * 			 2. bytes		bytes clocked during the run
+ * 			 3. ns			duration of the run
+ * 			 4. isr_ns		time spent in handlers during the run
+ * 			 5. min_util	minimum bus use in percent
+ * 			 6. min_idle	minimum CPU idle time in percent
+ * @return   none
+ */
+static void report_rate(const char *name, uint32_t bytes, uint64_t ns, uint64_t isr_ns,
+		uint32_t min_util, uint32_t min_idle){
+	uint64_t line = 1000000000ULL / (9ULL * sim_i2c_bit_ns());		//Bytes/s at full bus use
+	uint64_t rate = ((uint64_t)bytes * 1000000000ULL) / ns;
+	uint32_t util = (uint32_t)((rate * 100) / line);
+	uint32_t idle = (uint32_t)(100 - ((isr_ns * 100) / ns));
+
+	printf("  %-10s %6lu B/s of %6lu (%3lu%%), CPU idle %3lu%%\n", name,
+		(unsigned long)rate, (unsigned long)line, (unsigned long)util, (unsigned long)idle);
+	CHECK(util >= min_util);
+	CHECK(idle >= min_idle);
+}
+
+/**
+ * @function check_clock_change
+ * @brief  	 Switch the bus clock, the SCL rate is off until
+ * 			 timer_clock_changed() runs the I2C clock hook
+ * @param    bus_hz		new bus clock
+ * @return   none
+ */
+static void check_clock_change(uint32_t bus_hz){
+	uint32_t stale, rate;
+	uint8_t val;
+
+	sim_i2c_set_bus_hz(bus_hz);
+	stale = 1000000000UL / sim_i2c_bit_ns();
+	timer_clock_changed();
+	rate = 1000000000UL / sim_i2c_bit_ns();
+	printf("  bus %lu Hz: SCL %lu Hz before timer_clock_changed, %lu Hz after\n",
+		(unsigned long)bus_hz, (unsigned long)stale, (unsigned long)rate);
+	CHECK((rate <= I2C_SPEED_DEFAULT) && (rate >= ((I2C_SPEED_DEFAULT * 3) / 4)));
+	CHECK(I2C_write_block(DEV_ADDR, 0x30, (const uint8_t *)"\x5A", 1));
+	val = I2C_read_byte(DEV_ADDR, 0x30);
+	CHECK(val == 0x5A);
+}
+
+/**
+ * @function submit_invalid
+ * @brief  	 Submit a descriptor and report if the engine took it
+ * @param    1. dir		data phase
+ * 			 2. buf		data
+ * 			 3. len		data length
+ * @return   result of I2C_submit
+ */
+static int submit_invalid(i2c_dir dir, uint8_t *buf, uint16_t len){
+	static i2c_xfer_t xfer;
+
+	xfer.dev = DEV_ADDR;
+	xfer.reg = 0x20;
+	xfer.dir = dir;
+	xfer.buf = buf;
+	xfer.len = len;
+	xfer.flags = 0;
+	xfer.callback = NULL;
+	xfer.status = I2C_STATUS_IDLE;
+	return I2C_submit(&xfer);
+}
+
+int main(void){
+	uint8_t buf[16];
+	uint8_t wr[4] = {0x11, 0x22, 0x33, 0x44};
+	i2c_reg_write batch[3] = {{0x2A, 0x01}, {0x0E, 0x00}, {0x2B, 0x02}};
+	uint32_t bytes;
+	uint64_t isr, ns;
+
+	for(int i = 0; i < 256; i++){
+		regs[i] = (uint8_t)(i * 7 + 3);
+	}
+	sim_i2c_init(&slave);
+	I2C_init();
+	CHECK(sim_i2c.protocol_errors == 0);
+
+	//Blocking calls
+	CHECK(I2C_read_block(DEV_ADDR, 0x01, buf, 6));
+	CHECK(memcmp(buf, &regs[0x01], 6) == 0);
+	CHECK(I2C_read_byte(DEV_ADDR, 0x0D) == regs[0x0D]);
+	CHECK(I2C_write_block(DEV_ADDR, 0x20, wr, sizeof(wr)));
+	CHECK(memcmp(&regs[0x20], wr, sizeof(wr)) == 0);
+	CHECK(I2C_write_batch(DEV_ADDR, batch, 3));
+	CHECK((regs[0x2A] == 0x01) && (regs[0x0E] == 0x00) && (regs[0x2B] == 0x02));
+
+	//Descriptors without their data are refused
+	CHECK(!submit_invalid(I2C_XFER_READ, buf, 0));
+	CHECK(!submit_invalid(I2C_XFER_WRITE_BATCH, (uint8_t *)batch, 0));
+	CHECK(!submit_invalid(I2C_XFER_READ, NULL, 6));
+	CHECK(!submit_invalid(I2C_XFER_WRITE, NULL, 4));
+	CHECK(!submit_invalid(I2C_XFER_WRITE_BATCH, NULL, 3));
+	CHECK(!I2C_submit(NULL));
+
+	//One timer_clock_changed() call also brings the SCL rate back
+	check_clock_change(8000000);
+	check_clock_change(24000000);
+
+	//Resubmit from the callback, alone and with a second descriptor queued
+	run_chain(6, 0, CHAIN_LEN, 0);
+	CHECK(chain_done == CHAIN_LEN);
+	CHECK(chain_bad == 0);
+	run_chain(6, 0, CHAIN_LEN, 1);
+	CHECK(chain_done == CHAIN_LEN);
+	CHECK(chain_bad == 0);
+	run_chain(32, I2C_XFER_DMA, CHAIN_LEN, 1);
+	CHECK(chain_done == CHAIN_LEN);
+	CHECK(chain_bad == 0);
+	CHECK(sim_i2c.protocol_errors == 0);
+	if(host_failures){
+		return host_report("test_i2c_engine");	//Engine state unknown, skip the timing runs
+	}
+
+	printf("I2C0 at %lu Hz SCL\n", (unsigned long)(1000000000UL / sim_i2c_bit_ns()));
+
+	//Per byte interrupts, 6 byte sample reads back to back
+	bytes = sim_i2c.bytes;
+	isr = host_isr_ns;
+	ns = run_chain(6, 0, (uint32_t)(RUN_NS / (9ULL * 9 * sim_i2c_bit_ns())), 0);
+	report_rate("interrupt", sim_i2c.bytes - bytes, ns, host_isr_ns - isr, 75, 80);
+
+	//DMA, full FIFO reads
+	bytes = sim_i2c.bytes;
+	isr = host_isr_ns;
+	ns = run_chain(32, I2C_XFER_DMA, (uint32_t)(RUN_NS / (35ULL * 9 * sim_i2c_bit_ns())), 0);
+	report_rate("dma", sim_i2c.bytes - bytes, ns, host_isr_ns - isr, 85, 95);
+
+	//Blocking reads, the CPU waits for each one
+	bytes = sim_i2c.bytes;
+	ns = host_time_ns;
+	while((host_time_ns - ns) < RUN_NS){
+		CHECK(I2C_read_block(DEV_ADDR, 0x01, buf, 6));
+	}
+	ns = host_time_ns - ns;
+	report_rate("blocking", sim_i2c.bytes - bytes, ns, ns, 75, 0);
+	printf("  I2C_get_throughput %lu B/s\n", (unsigned long)I2C_get_throughput());
+
+	CHECK(sim_i2c.protocol_errors == 0);
+	CHECK(sim_i2c.starts == sim_i2c.stops);
+	return host_report("test_i2c_engine");
+}
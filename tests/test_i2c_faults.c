@@ -0,0 +1,156 @@
+/**@file: test_i2c_faults.c
+ * @brief: Host test of the I2C0 engine error handling on the simulated
+ *			bus with injected faults
+ *			NAKs are retried without a bus clear, then reported
+ *			arbitration loss and a slave stuck holding SDA are cleared
+ *			with the bit banged sequence and the transaction retried
+ *			a slave holding SCL times out every attempt and is reported
+ *			the bus clear and the wait for the previous STOP never keep
+ *			a handler running or interrupts masked for long
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <string.h>
+#include "i2c.h"
+#include "timer.h"
+
+#define DEV_ADDR		0x3A
+#define MAX_ISR_NS		20000			//Longest handler allowed
+#define MAX_IRQ_OFF_NS	20000			//Longest masked section allowed
+
+static uint8_t regs[256];
+
+static uint8_t slave_read(uint8_t reg){
+	return regs[reg];
+}
+
+static void slave_write(uint8_t reg, uint8_t val){
+	regs[reg] = val;
+}
+
+static const sim_i2c_slave slave = {DEV_ADDR, slave_read, slave_write, NULL};
+
+/**
+ * @function read_async
+ * @brief  	 Submit a read and sleep until the engine reports it
+ * @param    1. xfer	descriptor to use
+ * 			 2. buf		storage for the data
+ * 			 3. len		bytes to read
+ * @return   final status of the transaction
+ */
+static i2c_status read_async(i2c_xfer_t *xfer, uint8_t *buf, uint16_t len){
+	uint64_t start = host_time_ns;
+
+	memset(buf, 0, len);
+	xfer->dev = DEV_ADDR;
+	xfer->reg = 0x01;
+	xfer->dir = I2C_XFER_READ;
+	xfer->buf = buf;
+	xfer->len = len;
+	xfer->flags = 0;
+	xfer->callback = NULL;
+	CHECK(I2C_submit(xfer));
+	while(((xfer->status == I2C_STATUS_QUEUED) || (xfer->status == I2C_STATUS_BUSY)) &&
+		((host_time_ns - start) < 1000000000ULL)){
+		__WFI();
+	}
+	return xfer->status;
+}
+
+int main(void){
+	i2c_engine_stats before, after;
+	i2c_xfer_t xfer, next;
+	uint8_t buf[6], buf2[6];
+
+	for(int i = 0; i < 256; i++){
+		regs[i] = (uint8_t)(i * 5 + 1);
+	}
+	sim_i2c_init(&slave);
+	I2C_init();
+	host_isr_max_ns = 0;
+	host_irq_off_max_ns = 0;
+
+	//Address NAK once: retried, no bus clear
+	I2C_engine_get_stats(&before);
+	sim_faults.nak_addr = 1;
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_DONE);
+	CHECK(memcmp(buf, &regs[0x01], sizeof(buf)) == 0);
+	I2C_engine_get_stats(&after);
+	CHECK(after.naks == before.naks + 1);
+	CHECK(after.retries == before.retries + 1);
+	CHECK(after.recoveries == before.recoveries);
+
+	//Device absent: every attempt NAKed, reported after the retries
+	I2C_engine_get_stats(&before);
+	sim_faults.nak_addr = 100;
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_NAK);
+	I2C_engine_get_stats(&after);
+	CHECK(after.naks == before.naks + 1 + I2C_MAX_RETRIES);
+	CHECK(after.errors == before.errors + 1);
+	sim_faults.nak_addr = 0;
+
+	//Data NAK on a blocking write
+	sim_faults.nak_data = 1;
+	buf2[0] = 0x5A;
+	CHECK(I2C_write_block(DEV_ADDR, 0x30, buf2, 1));
+	CHECK(regs[0x30] == 0x5A);
+
+	//Arbitration lost: bus clear then retry
+	I2C_engine_get_stats(&before);
+	sim_faults.arb_lost = 1;
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_DONE);
+	CHECK(memcmp(buf, &regs[0x01], sizeof(buf)) == 0);
+	I2C_engine_get_stats(&after);
+	CHECK(after.arb_lost == before.arb_lost + 1);
+	CHECK(after.recoveries == before.recoveries + 1);
+
+	//Slave stuck mid byte: timeout, clocked free, retried, with a second
+	//transaction queued behind it
+	I2C_engine_get_stats(&before);
+	sim_faults.stuck = 1;
+	sim_faults.stuck_clocks = 5;
+	next.dev = DEV_ADDR;
+	next.reg = 0x10;
+	next.dir = I2C_XFER_READ;
+	next.buf = buf2;
+	next.len = sizeof(buf2);
+	next.flags = 0;
+	next.callback = NULL;
+	CHECK(I2C_submit(&next));
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_DONE);
+	CHECK(memcmp(buf, &regs[0x01], sizeof(buf)) == 0);
+	CHECK(next.status == I2C_STATUS_DONE);
+	CHECK(memcmp(buf2, &regs[0x10], sizeof(buf2)) == 0);
+	I2C_engine_get_stats(&after);
+	CHECK(after.timeouts == before.timeouts + 1);
+	CHECK(after.recoveries == before.recoveries + 1);
+	CHECK(sim_i2c.recover_clocks >= 5);
+
+	//Same on a blocking read, the bus clear runs from the wait loop
+	sim_faults.stuck = 1;
+	CHECK(I2C_read_block(DEV_ADDR, 0x01, buf, sizeof(buf)));
+	CHECK(memcmp(buf, &regs[0x01], sizeof(buf)) == 0);
+
+	//SCL held low for good: every attempt times out
+	I2C_engine_get_stats(&before);
+	sim_faults.hold_scl = true;
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_TIMEOUT);
+	I2C_engine_get_stats(&after);
+	CHECK(after.timeouts == before.timeouts + 1 + I2C_MAX_RETRIES);
+	CHECK(after.errors == before.errors + 1);
+	sim_faults.hold_scl = false;
+
+	//Bus usable again once released
+	CHECK(read_async(&xfer, buf, sizeof(buf)) == I2C_STATUS_DONE);
+	CHECK(memcmp(buf, &regs[0x01], sizeof(buf)) == 0);
+
+	printf("longest handler %lu ns, longest masked section %lu ns\n",
+		(unsigned long)host_isr_max_ns, (unsigned long)host_irq_off_max_ns);
+	CHECK(host_isr_max_ns < MAX_ISR_NS);
+	CHECK(host_irq_off_max_ns < MAX_IRQ_OFF_NS);
+	CHECK(sim_i2c.protocol_errors == 0);
+	return host_report("test_i2c_faults");
+}
@@ -0,0 +1,87 @@
+/**@file: test_isqrt.c
+ * @brief: Host test of isqrt32 and run of step_benchmark (STEP_BENCHMARK)
+ *			isqrt32 gives floor(sqrt(n)) on both sides of every perfect
+ *			square of the uint32_t range, where the result changes, and
+ *			against sqrt() on values spread over the whole range
+ *			cycles per sample of the magnitude with sqrt() and with
+ *			isqrt32(), counted with the host CPU counter (HOST_CPU_CYCLES).
+ *			The PC has a hardware sqrt, the figures on the Cortex-M0+
+ *			(soft float) come from the same function built for the board.
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <math.h>
+#include "utility.h"
+
+#define SPREAD_STEP		65521			//Prime stride over the uint32_t range
+#define BENCH_RUNS		16
+
+/**
+ * @function check_squares
+ * @brief  	 isqrt32 of r*r - 1, r*r and r*r + r (the last value below
+ * 			 the next square) for every root of the uint32_t range
+ * @param    none
+ * @return   number of wrong results
+ */
+static uint32_t check_squares(void){
+	uint32_t bad = 0;
+
+	bad += (isqrt32(0) != 0);
+	for(uint32_t r = 1; r <= 0xFFFF; r++){
+		uint32_t sq = r * r;
+
+		bad += (isqrt32(sq - 1) != (r - 1));
+		bad += (isqrt32(sq) != r);
+		bad += (isqrt32(sq + (2 * r)) != r);	//(r + 1)^2 - 1, UINT32_MAX for the last root
+	}
+	return bad;
+}
+
+/**
+ * @function check_spread
+ * @brief  	 isqrt32 against the double precision sqrt(), which is exact
+ * 			 for 32 bit values, every SPREAD_STEP over the whole range
+ * @param    checked	number of values compared
+ * @return   number of wrong results
+ */
+static uint32_t check_spread(uint32_t *checked){
+	uint32_t bad = 0;
+	uint64_t n;
+
+	*checked = 0;
+	for(n = 0; n <= UINT32_MAX; n += SPREAD_STEP){
+		bad += (isqrt32((uint32_t)n) != (uint32_t)sqrt((double)n));
+		(*checked)++;
+	}
+	bad += (isqrt32(UINT32_MAX) != (uint32_t)sqrt((double)UINT32_MAX));
+	return bad;
+}
+
+int main(void){
+	uint32_t float_cycles, int_cycles, best_float = UINT32_MAX, best_int = UINT32_MAX;
+	uint32_t squares_bad, spread_bad, checked;
+
+	printf("isqrt32\n");
+	squares_bad = check_squares();
+	spread_bad = check_spread(&checked);
+	printf("  %lu wrong around the 65535 squares, %lu wrong of %lu values against sqrt()\n",
+		(unsigned long)squares_bad, (unsigned long)spread_bad, (unsigned long)checked);
+	CHECK(squares_bad == 0);
+	CHECK(spread_bad == 0);
+	CHECK(isqrt32(UINT32_MAX) == 0xFFFF);
+
+	//Best of a few runs, the PC is not alone on its core
+	for(uint32_t i = 0; i < BENCH_RUNS; i++){
+		step_benchmark(&float_cycles, &int_cycles);
+		best_float = (float_cycles < best_float) ? float_cycles : best_float;
+		best_int = (int_cycles < best_int) ? int_cycles : best_int;
+	}
+	printf("  step_benchmark on the host: sqrt() %lu cycles/sample, isqrt32() %lu cycles/sample\n",
+		(unsigned long)best_float, (unsigned long)best_int);
+	CHECK(best_float > 0);
+	CHECK(best_int > 0);
+	return host_report("test_isqrt");
+}
@@ -0,0 +1,239 @@
+/**@file: test_lcd_engine.c
+ * @brief: Host test of the background LCD engine on the simulated
+ *			HD44780 (hd44780_sim.c), output drained by the SysTick hook
+ *			lcd_fb_flush only queues and returns at once, the hook never
+ *			waits for the controller
+ *			the controller receives the same commands and characters, in
+ *			the same order, as when the frames are written directly, with
+ *			new frames queued while earlier ones drain
+ *			a full queue truncates a flush, the next flushes send the
+ *			rest and the display ends on the last frame
+ *			queue depth, high water and bytes per second counters
+ *			no byte is sent while the controller is busy, also the first
+ *			one after the clear of start_lcd
+ *			built twice, with and without the busy flag (LCD_USE_BUSY_FLAG)
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <string.h>
+#include "lcd.h"
+
+#define FRAMES			60
+#define FRAME_NS		5000000ULL		//Main loop period, the queue builds up but never fills
+#define LOG_LEN			4096
+#define MAX_HOOK_NS		10000			//Longest SysTick handler with the engine
+
+static uint16_t log_direct[LOG_LEN];
+static uint16_t log_engine[LOG_LEN];
+static uint16_t *log_buf;
+static uint32_t log_len;
+
+static void log_byte(uint8_t b, uint8_t rs){
+	if(log_len < LOG_LEN){
+		log_buf[log_len] = b | (rs ? 0x100 : 0);
+	}
+	log_len++;
+}
+
+/**
+ * @function check_display
+ * @brief  	 The display shows the expected lines
+ * @param    1. line1	16 characters
+ * 			 2. line2	16 characters
+ * @return   1 if every cell matches
+ */
+static int check_display(const char *line1, const char *line2){
+	int bad = 0;
+
+	for(uint8_t c = 0; c < LCD_COLS; c++){
+		bad += (sim_lcd_cell(0, c) != line1[c]);
+		bad += (sim_lcd_cell(1, c) != line2[c]);
+	}
+	return bad == 0;
+}
+
+/**
+ * @function restart
+ * @brief  	 Power on the LCD model and initialize the display directly,
+ * 			 then log the bytes the controller receives
+ * @param    log	log of the run
+ * @return   none
+ */
+static void restart(uint16_t *log){
+	sim_lcd_init();
+	lcd_init();
+	start_lcd();
+	sim_lcd_update();
+	log_buf = log;
+	log_len = 0;
+	sim_lcd.on_byte = log_byte;
+}
+
+/**
+ * @function draw
+ * @brief  	 Frame i of the test screen: a fixed title, a counter and a
+ * 			 marker moving along the second line
+ * @param    i	frame number
+ * @return   none
+ */
+static void draw(uint32_t i){
+	lcd_fb_clear();
+	lcd_fb_write(0, 0, "steps");
+	lcd_fb_write_int(0, 8, 1000 + (i * 3), 8);
+	lcd_fb_write(1, i % LCD_COLS, "*");
+}
+
+/**
+ * @function wait_drained
+ * @brief  	 Let the engine send the queue and the controller execute
+ * 			 the last byte
+ * @param    none
+ * @return   none
+ */
+static void wait_drained(void){
+	for(uint32_t ms = 0; !lcd_engine_idle() && (ms < 1000); ms++){
+		host_advance_ns(1000000);
+	}
+	host_advance_ns(2000000);
+	sim_lcd_update();
+}
+
+/**
+ * @function check_order
+ * @brief  	 The frames written directly and through the engine, with the
+ * 			 main loop running faster than the drain, reach the
+ * 			 controller as the same byte sequence
+ * @param    none
+ * @return   none
+ */
+static void check_order(void){
+	uint32_t direct_len, max_flush_ns = 0, mismatch = 0;
+	lcd_engine_stats stats;
+
+	restart(log_direct);
+	for(uint32_t i = 0; i < FRAMES; i++){
+		draw(i);
+		lcd_fb_flush();
+	}
+	sim_lcd_update();
+	direct_len = log_len;
+
+	restart(log_engine);
+	CHECK(lcd_engine_start());
+	for(uint32_t i = 0; i < FRAMES; i++){
+		uint64_t t0 = host_time_ns;
+
+		draw(i);
+		lcd_fb_flush();
+		if((host_time_ns - t0) > max_flush_ns){
+			max_flush_ns = host_time_ns - t0;
+		}
+		host_advance_ns(FRAME_NS);
+	}
+	lcd_engine_get_stats(&stats);
+	CHECK(stats.depth > 0);						//Still draining after the loop
+	wait_drained();
+
+	for(uint32_t i = 0; (i < log_len) && (i < direct_len) && (i < LOG_LEN); i++){
+		mismatch += (log_engine[i] != log_direct[i]);
+	}
+	lcd_engine_get_stats(&stats);
+	printf("  %d frames: %lu bytes direct, %lu through the engine, %lu differ, high water %u, "
+		"longest flush %lu ns, longest SysTick %lu ns\n", FRAMES, (unsigned long)direct_len,
+		(unsigned long)log_len, (unsigned long)mismatch, stats.high_water,
+		(unsigned long)max_flush_ns, (unsigned long)host_isr_max_ns);
+	CHECK(direct_len < LOG_LEN);
+	CHECK(log_len == direct_len);
+	CHECK(mismatch == 0);
+	CHECK(stats.depth == 0);
+	CHECK(stats.high_water > 16);				//Frames queued behind earlier ones
+	CHECK(stats.high_water < (LCD_QUEUE_LEN - 1));	//No truncated flush in this run
+	CHECK(max_flush_ns == 0);					//Queued only, no port access
+	CHECK(host_isr_max_ns < MAX_HOOK_NS);
+	CHECK(check_display("steps   1177    ", "           *    "));
+}
+
+/**
+ * @function check_full_queue
+ * @brief  	 Two full screens flushed back to back overflow the queue,
+ * 			 the flushes of the following main loop passes finish the
+ * 			 second one
+ * @param    none
+ * @return   none
+ */
+static void check_full_queue(void){
+	uint16_t first, second, passes = 0;
+
+	lcd_fb_write(0, 0, "ABCDEFGHIJKLMNOP");
+	lcd_fb_write(1, 0, "abcdefghijklmnop");
+	first = lcd_fb_flush();
+	lcd_fb_write(0, 0, "0123456789012345");
+	lcd_fb_write(1, 0, "qrstuvwxyzQRSTUV");
+	second = lcd_fb_flush();
+	CHECK(first >= (2 * LCD_COLS));
+	CHECK((first + second) == (LCD_QUEUE_LEN - 1));
+
+	while(passes < 1000){
+		host_advance_ns(FRAME_NS);
+		passes++;
+		if(!lcd_fb_flush() && lcd_engine_idle()){
+			break;
+		}
+	}
+	wait_drained();
+	printf("  full queue: %u + %u bytes queued, done after %u passes\n", first, second, passes);
+	CHECK(check_display("0123456789012345", "qrstuvwxyzQRSTUV"));
+}
+
+/**
+ * @function check_rate
+ * @brief  	 Throughput counters with the engine kept busy for more
+ * 			 than a second
+ * @param    none
+ * @return   none
+ */
+static void check_rate(void){
+	lcd_engine_stats stats;
+	uint32_t bytes;
+	uint8_t other = 0;
+
+	lcd_engine_get_stats(&stats);
+	bytes = stats.bytes;
+	for(uint32_t ms = 0; ms < 2500; ms++){
+		if(lcd_engine_idle()){					//Every cell changes
+			other ^= 1;
+			lcd_fb_write(0, 0, other ? "ABCDEFGHIJKLMNOP" : "0123456789012345");
+			lcd_fb_write(1, 0, other ? "abcdefghijklmnop" : "qrstuvwxyzQRSTUV");
+			lcd_fb_flush();
+		}
+		host_advance_ns(1000000);
+	}
+	wait_drained();
+	lcd_engine_get_stats(&stats);
+	printf("  busy engine: %lu bytes/s (at most %d per tick)\n",
+		(unsigned long)stats.bytes_per_s, LCD_ENGINE_BYTES_PER_TICK);
+	CHECK(stats.bytes_per_s >= 900);
+	CHECK(stats.bytes_per_s <= (1000 * LCD_ENGINE_BYTES_PER_TICK));
+	CHECK((stats.bytes - bytes) >= 2000);
+}
+
+int main(void){
+	printf("LCD engine, busy flag %s\n", LCD_USE_BUSY_FLAG ? "on" : "off");
+	check_order();
+	check_full_queue();
+	check_rate();
+
+	sim_lcd_update();
+	printf("  controller: %lu commands, %lu data, %lu status reads, early %lu, short pulses %lu\n",
+		(unsigned long)sim_lcd.commands, (unsigned long)sim_lcd.data,
+		(unsigned long)sim_lcd.status_reads, (unsigned long)sim_lcd.early,
+		(unsigned long)sim_lcd.short_pulses);
+	CHECK(sim_lcd.early == 0);
+	CHECK(sim_lcd.short_pulses == 0);
+	CHECK(sim_lcd.contention == 0);
+	CHECK(LCD_USE_BUSY_FLAG ? (sim_lcd.status_reads > 0) : (sim_lcd.status_reads == 0));
+	return host_report(LCD_USE_BUSY_FLAG ? "test_lcd_engine_bf" : "test_lcd_engine");
+}
@@ -0,0 +1,182 @@
+/**@file: test_lcd_fb.c
+ * @brief: Host test of the LCD shadow framebuffer on the simulated
+ *			HD44780 (hd44780_sim.c)
+ *			start_lcd leaves a blank 2 line display in 4 bit mode
+ *			lcd_fb_flush makes the display show the framebuffer, sends
+ *			nothing for an unchanged frame, one address command per run
+ *			of changed cells and one data write per changed cell
+ *			padded numbers clear the digits of a longer old value
+ *			after a direct write the next flush rewrites every cell
+ *			bus writes and time per frame of the distance / calorie
+ *			screen of main() against two lcd_data_write lines
+ *			no byte is sent while the controller is busy
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <string.h>
+#include "lcd.h"
+
+#define FRAMES			100
+
+/**
+ * @function check_display
+ * @brief  	 The display shows the expected lines
+ * @param    1. line1	16 characters
+ * 			 2. line2	16 characters
+ * @return   1 if every cell matches
+ */
+static int check_display(const char *line1, const char *line2){
+	int bad = 0;
+
+	for(uint8_t c = 0; c < LCD_COLS; c++){
+		bad += (sim_lcd_cell(0, c) != line1[c]);
+		bad += (sim_lcd_cell(1, c) != line2[c]);
+	}
+	if(bad){
+		char got[LCD_ROWS][LCD_COLS + 1];
+
+		for(uint8_t r = 0; r < LCD_ROWS; r++){
+			for(uint8_t c = 0; c < LCD_COLS; c++){
+				got[r][c] = sim_lcd_cell(r, c);
+			}
+			got[r][LCD_COLS] = '\0';
+		}
+		printf("  display \"%s\" \"%s\", expected \"%s\" \"%s\"\n", got[0], got[1], line1, line2);
+	}
+	return bad == 0;
+}
+
+/**
+ * @function flush_counted
+ * @brief  	 Flush and check the bytes the controller received against
+ * 			 the count returned and the expected commands and data
+ * @param    1. addr_sets	Set DDRAM address commands expected
+ * 			 2. data		characters expected
+ * @return   none
+ */
+static void flush_counted(uint32_t addr_sets, uint32_t data){
+	sim_lcd_stats before;
+	uint32_t writes = lcd_get_bus_writes();
+	uint16_t sent;
+
+	sim_lcd_update();
+	before = sim_lcd;
+	sent = lcd_fb_flush();
+	sim_lcd_update();
+	CHECK(sent == (addr_sets + data));
+	CHECK((lcd_get_bus_writes() - writes) == sent);
+	CHECK((sim_lcd.addr_sets - before.addr_sets) == addr_sets);
+	CHECK((sim_lcd.commands - before.commands) == addr_sets);
+	CHECK((sim_lcd.data - before.data) == data);
+}
+
+/**
+ * @function draw
+ * @brief  	 The screen of main()
+ * @param    1. distance
+ * 			 2. calorie
+ * @return   none
+ */
+static void draw(uint32_t distance, uint32_t calorie){
+	lcd_fb_write(0, 0, "distance:");
+	lcd_fb_write_int(0, 9, distance, LCD_COLS - 9);
+	lcd_fb_write(1, 0, "calorie:");
+	lcd_fb_write_int(1, 9, calorie, LCD_COLS - 9);
+}
+
+/**
+ * @function check_frames
+ * @brief  	 Bus writes and time of FRAMES updates of the screen of
+ * 			 main() with the framebuffer and with lcd_data_write
+ * @param    none
+ * @return   none
+ */
+static void check_frames(void){
+	uint32_t writes, fb_writes, direct_writes;
+	uint64_t t0, fb_ns, direct_ns;
+	char text[2][LCD_COLS + 1];
+
+	//One step more per frame, the distance changes every few frames
+	writes = lcd_get_bus_writes();
+	t0 = host_time_ns;
+	for(uint32_t i = 0; i < FRAMES; i++){
+		draw(1000 + ((i * 7) / 10), 100 + (i / 20));
+		lcd_fb_flush();
+	}
+	fb_writes = lcd_get_bus_writes() - writes;
+	fb_ns = host_time_ns - t0;
+	CHECK(check_display("distance:1069   ", "calorie: 104    "));
+
+	writes = lcd_get_bus_writes();
+	t0 = host_time_ns;
+	for(uint32_t i = 0; i < FRAMES; i++){
+		snprintf(text[0], sizeof(text[0]), "distance:%lu", (unsigned long)(1000 + ((i * 7) / 10)));
+		snprintf(text[1], sizeof(text[1]), "calorie:%lu", (unsigned long)(100 + (i / 20)));
+		lcd_data_write(text[0], LCD_LINE1);
+		lcd_data_write(text[1], LCD_LINE2);
+	}
+	direct_writes = lcd_get_bus_writes() - writes;
+	direct_ns = host_time_ns - t0;
+	CHECK(check_display("distance:1069   ", "calorie:104     "));
+
+	printf("  %d frames: framebuffer %lu bytes %lu us, lcd_data_write %lu bytes %lu us\n", FRAMES,
+		(unsigned long)fb_writes, (unsigned long)(fb_ns / 1000),
+		(unsigned long)direct_writes, (unsigned long)(direct_ns / 1000));
+	CHECK((fb_writes * 10) < direct_writes);
+	CHECK((fb_ns * 10) < direct_ns);
+}
+
+int main(void){
+	printf("LCD framebuffer\n");
+	sim_lcd_init();
+	lcd_init();
+	start_lcd();
+	CHECK(check_display("                ", "                "));
+
+	//First frame: only the non blank cells, one address per run but
+	//none for the first one at the home address left by the clear
+	lcd_fb_clear();
+	lcd_fb_write(0, 0, "Steps");
+	lcd_fb_write_int(0, 11, 12345, 5);
+	lcd_fb_write(1, 4, "Walk");
+	flush_counted(2, 14);
+	CHECK(check_display("Steps      12345", "    Walk        "));
+
+	//Unchanged frame sends nothing
+	lcd_fb_write(0, 0, "Steps");
+	flush_counted(0, 0);
+
+	//Last digit, then two separate runs on both lines
+	lcd_fb_write_int(0, 11, 12346, 5);
+	flush_counted(1, 1);
+	lcd_fb_write(0, 2, "EP");
+	lcd_fb_write(1, 4, "Run ");
+	flush_counted(2, 6);
+	CHECK(check_display("StEPs      12346", "    Run         "));
+
+	//Shorter number padded over the old digits
+	lcd_fb_write_int(0, 11, 7, 5);
+	flush_counted(1, 5);
+	CHECK(check_display("StEPs      7    ", "    Run         "));
+
+	//Direct write, the framebuffer takes the whole display back
+	lcd_data_write("direct", LCD_LINE2);
+	CHECK(check_display("StEPs      7    ", "direct          "));
+	flush_counted(2, 2 * LCD_COLS);
+	CHECK(check_display("StEPs      7    ", "    Run         "));
+
+	lcd_fb_clear();
+	check_frames();
+
+	sim_lcd_update();
+	printf("  controller: %lu commands, %lu data, early %lu, short pulses %lu\n",
+		(unsigned long)sim_lcd.commands, (unsigned long)sim_lcd.data,
+		(unsigned long)sim_lcd.early, (unsigned long)sim_lcd.short_pulses);
+	CHECK(sim_lcd.early == 0);
+	CHECK(sim_lcd.short_pulses == 0);
+	CHECK(sim_lcd.contention == 0);
+	return host_report("test_lcd_fb");
+}
@@ -0,0 +1,249 @@
+/**@file: test_mma_stream.c
+ * @brief: Host test of the interrupt driven MMA8451 acquisition on the
+ *			simulated sensor and I2C0 bus
+ *			blocking drain of the FIFO in one burst
+ *			FIFO watermark stream at 800 Hz, started with the FIFO above
+ *			the watermark: every burst is read without
+ *			FIFO overflow and decimated to one sample per 20 ms, with
+ *			the DC level kept and a 50 Hz tone rejected, also while other
+ *			transactions keep the bus busy and delay the reads
+ *			the reads are paced by the INT1 interrupt, about one per
+ *			watermark, and the core sleeps in between
+ *			data ready stream at 50 Hz: every sample reaches the ring in
+ *			order, undecimated
+ *			data rates with no decimation to the stream rate are refused
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include <stdlib.h>
+#include "mma8451.h"
+#include "ring.h"
+#include "dsp.h"
+
+#define RUN_NS			3000000000ULL	//Simulated time of each run
+#define STREAM_US		(1000000 / MMA_STREAM_RATE_HZ)
+#define TS_JITTER_US	5000			//Read latency differences between bursts
+#define WARMUP			(DECIM_TAPS / 16)	//Outputs before the filter is full
+#define TONE_COUNTS		1000			//50 Hz square wave on Y, 14 bit counts at 4g
+#define ODR_NS			1250000ULL		//800 Hz
+#define MIN_IDLE		90				//CPU idle in percent while streaming
+
+static sample_ring_t ring;
+static i2c_xfer_t hog;
+static uint8_t hog_buf[32];
+static volatile int hog_on;
+
+/**
+ * @function hog_cb
+ * @brief  	 Keep a long read queued on the bus
+ * @param    xfer	finished transaction
+ * @return   none
+ */
+static void hog_cb(i2c_xfer_t *xfer){
+	if(hog_on){
+		I2C_submit(xfer);
+	}
+}
+
+/**
+ * @function tone
+ * @brief  	 Sensor signal for the FIFO runs: X = 0.5g, Y = 50 Hz square
+ * 			 wave at 800 Hz, Z = 1g (4g range)
+ * @param    1. n		sample number
+ * 			 2. axis	0 = X, 1 = Y, 2 = Z
+ * @return   14 bit sample
+ */
+static int16_t tone(uint32_t n, uint8_t axis){
+	switch(axis){
+	case 0:
+		return 1024;
+	case 1:
+		return ((n / 8) & 1) ? TONE_COUNTS : -TONE_COUNTS;
+	default:
+		return 2048;
+	}
+}
+
+/**
+ * @function wait_sample
+ * @brief  	 Main loop consumer: take one sample from the ring, sleep
+ * 			 while it is empty
+ * @param    1. end	simulated time to give up at
+ * 			 2. s	sample taken
+ * @return   1 if a sample was taken, 0 at the end of the run
+ */
+static int wait_sample(uint64_t end, mma_sample_t *s){
+	while(host_time_ns < end){
+		if(ring_get_block(&ring, s, 1)){
+			return 1;
+		}
+		__disable_irq();
+		if(ring_count(&ring) == 0){
+			__WFI();
+		}
+		__enable_irq();
+	}
+	return 0;
+}
+
+/**
+ * @function run_drain
+ * @brief  	 mma_fifo_drain returns the stored samples as one contiguous
+ * 			 block of consecutive, evenly stamped samples
+ * @param    none
+ * @return   none
+ */
+static void run_drain(void){
+	mma_sample_t s[MMA_FIFO_SIZE];
+	uint32_t gaps = 0;
+	uint8_t n;
+
+	CHECK(init_mma_fifo(16));
+	host_advance_ns((10 * ODR_NS) + 1000);
+	n = mma_fifo_drain(s, MMA_FIFO_SIZE);
+	for(uint8_t i = 1; i < n; i++){
+		if(((s[i].x / 2) != (((s[i - 1].x / 2) + 1) % 2048)) || (s[i].z != 4096) ||
+			((s[i].ts - s[i - 1].ts) != (ODR_NS / 1000))){
+			gaps++;
+		}
+	}
+	printf("  %-12s %u samples in one burst\n", "drain", n);
+	CHECK(n == 10);
+	CHECK(gaps == 0);
+}
+
+/**
+ * @function run_fifo
+ * @brief  	 FIFO watermark stream decimated to the stream rate,
+ * 			 optionally with a bus hog
+ * @param    1. name		scenario
+ * 			 2. with_hog	keep 32 byte reads queued on the bus
+ * @return   none
+ */
+static void run_fifo(const char *name, int with_hog){
+	uint64_t end = host_time_ns + RUN_NS;
+	uint32_t received = 0, produced, bad_ts = 0, bad_level = 0;
+	int32_t max_y = 0;
+	uint32_t last_ts = 0;
+	uint32_t irqs, idle;
+	uint64_t isr_ns;
+	mma_sample_t s;
+
+	ring_init(&ring);
+	sim_mma.signal = tone;
+	CHECK(init_mma_fifo(16));
+	produced = sim_mma.produced;
+	sim_mma.overflows = 0;
+	sim_mma.max_fifo = 0;
+	host_advance_ns(24 * ODR_NS);			//Stored before the stream starts
+	CHECK(mma_stream_start(&ring, 1));
+	irqs = sim_mma.irqs;
+	isr_ns = host_isr_ns;
+	if(with_hog){
+		hog.dev = MMA_ADDR;
+		hog.reg = 0x10;					//Clear of the sample registers
+		hog.dir = I2C_XFER_READ;
+		hog.buf = hog_buf;
+		hog.len = sizeof(hog_buf);
+		hog.flags = 0;
+		hog.callback = hog_cb;
+		hog_on = 1;
+		CHECK(I2C_submit(&hog));
+	}
+	while(wait_sample(end, &s)){
+		int32_t dt = (int32_t)(s.ts - last_ts);
+
+		if((received > 0) && ((dt < (STREAM_US - TS_JITTER_US)) || (dt > (STREAM_US + TS_JITTER_US)))){
+			bad_ts++;
+		}
+		if(received >= WARMUP){
+			//2% of the scaled level on X and Z, 50 Hz folded onto DC
+			if((abs(s.x - 2048) > 82) || (abs(s.z - 4096) > 82)){
+				bad_level++;
+			}
+			if(abs(s.y) > max_y){
+				max_y = abs(s.y);
+			}
+		}
+		last_ts = s.ts;
+		received++;
+	}
+	irqs = sim_mma.irqs - irqs;
+	idle = (uint32_t)(100 - (((host_isr_ns - isr_ns) * 100) / RUN_NS));
+	hog_on = 0;
+	mma_stream_stop();
+	sim_mma.signal = NULL;
+	produced = sim_mma.produced - produced;
+
+	printf("  %-12s produced %5lu received %4lu, max F_CNT %2lu, overflows %lu, 50 Hz residue %ld\n",
+		name, (unsigned long)produced, (unsigned long)received, (unsigned long)sim_mma.max_fifo,
+		(unsigned long)sim_mma.overflows, (long)max_y);
+	printf("  %-12s %lu PORTA interrupts, CPU idle %lu%%\n", "", (unsigned long)irqs, (unsigned long)idle);
+	CHECK(sim_mma.overflows == 0);
+	CHECK(ring.overflows == 0);
+	CHECK(received * 16 <= produced);
+	CHECK((received * 16) + (2 * MMA_FIFO_SIZE) >= produced);
+	CHECK(bad_ts == 0);
+	CHECK(bad_level == 0);
+	CHECK(max_y < 40);						//Tone of 2000 scaled counts
+	CHECK(irqs <= (produced / 16) + 2);		//One per watermark, no polling
+	CHECK(irqs * 32 >= produced);
+	CHECK(idle >= MIN_IDLE);
+}
+
+/**
+ * @function run_drdy
+ * @brief  	 Data ready stream at the stream rate, samples pass through
+ * 			 and keep the ramp encoded in X by the sensor model
+ * @param    none
+ * @return   none
+ */
+static void run_drdy(void){
+	const mma_config cfg = {MMA_ODR_50HZ, MMA_RANGE_2G, MMA_MODS_NORMAL, 1, 0, 0};
+	uint64_t end = host_time_ns + RUN_NS;
+	uint32_t received = 0, produced, gaps = 0;
+	int32_t last = -1;
+	mma_sample_t s;
+
+	ring_init(&ring);
+	CHECK(mma_apply_config(&cfg));
+	produced = sim_mma.produced;
+	CHECK(mma_stream_start(&ring, 0));
+	while(wait_sample(end, &s)){
+		if(((last >= 0) && (s.x != ((last + 1) % 4096))) || (s.z != 4096)){
+			gaps++;
+		}
+		last = s.x;
+		received++;
+	}
+	mma_stream_stop();
+	produced = sim_mma.produced - produced;
+	printf("  %-12s produced %5lu received %4lu\n", "data ready",
+		(unsigned long)produced, (unsigned long)received);
+	CHECK(gaps == 0);
+	CHECK(received + 1 >= produced);
+}
+
+int main(void){
+	sim_mma_init();
+	I2C_init();
+
+	printf("MMA8451 stream\n");
+	run_drain();
+	run_fifo("fifo", 0);
+	run_fifo("fifo+bus", 1);
+	while(!I2C_engine_idle()){
+		__WFI();
+	}
+	run_drdy();
+
+	//200 Hz has no decimation to the stream rate
+	CHECK(mma_set_profile(MMA_PROFILE_BALANCED));
+	CHECK(!mma_stream_start(&ring, 0));
+
+	CHECK(sim_i2c.protocol_errors == 0);
+	return host_report("test_mma_stream");
+}
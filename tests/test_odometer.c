@@ -0,0 +1,155 @@
+/**@file: test_odometer.c
+ * @brief: Host test of the odometer of activity.c
+ *			the stride grows with the cadence between its clamps and
+ *			scales with the height, one tread on stairs
+ *			the smoothed cadence follows the step intervals within one
+ *			step per minute, a pause longer than ODO_PAUSE_US brings back
+ *			ODO_CADENCE_DEFAULT, also across the wrap of the 32 bit us
+ *			time stamps
+ *			distance and calories add up exactly past 65536 m, where a
+ *			32 bit Q16 total would wrap
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include "activity.h"
+
+#define HEIGHT_CM		170
+#define LONG_STEPS		100000			//About 80 km at 120 steps/min
+
+/**
+ * @function check_stride
+ * @brief  	 Stride against cadence, height and activity
+ * @param    none
+ * @return   none
+ */
+static void check_stride(void){
+	uint32_t prev = 0, rising = 1;
+	uint32_t lo_c = ((ODO_RATIO_MIN_Q16 - ODO_RATIO_A_Q16) / ODO_RATIO_B_Q16) + 1;
+	uint32_t hi_c = ((ODO_RATIO_MAX_Q16 - ODO_RATIO_A_Q16) / ODO_RATIO_B_Q16) + 1;
+
+	for(uint16_t c = 0; c <= 300; c += 10){
+		uint32_t s = odometer_stride_q16(HEIGHT_CM, c, ACTIVITY_WALK);
+
+		rising &= (s >= prev);
+		prev = s;
+	}
+	printf("  stride at %d cm: %lu mm at 60, %lu mm at 100, %lu mm at 140, %lu mm at 200 steps/min\n",
+		HEIGHT_CM, (unsigned long)((odometer_stride_q16(HEIGHT_CM, 60, ACTIVITY_WALK) * 1000) >> 16),
+		(unsigned long)((odometer_stride_q16(HEIGHT_CM, 100, ACTIVITY_WALK) * 1000) >> 16),
+		(unsigned long)((odometer_stride_q16(HEIGHT_CM, 140, ACTIVITY_RUN) * 1000) >> 16),
+		(unsigned long)((odometer_stride_q16(HEIGHT_CM, 200, ACTIVITY_RUN) * 1000) >> 16));
+	CHECK(rising);
+	CHECK(odometer_stride_q16(HEIGHT_CM, 100, ACTIVITY_WALK) ==
+		(((ODO_RATIO_A_Q16 + (100UL * ODO_RATIO_B_Q16)) * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, 0, ACTIVITY_WALK) == ((ODO_RATIO_MIN_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, lo_c - 1, ACTIVITY_WALK) == ((ODO_RATIO_MIN_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, lo_c, ACTIVITY_WALK) > ((ODO_RATIO_MIN_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, hi_c - 1, ACTIVITY_WALK) < ((ODO_RATIO_MAX_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, hi_c, ACTIVITY_WALK) == ((ODO_RATIO_MAX_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(HEIGHT_CM, 400, ACTIVITY_RUN) == ((ODO_RATIO_MAX_Q16 * HEIGHT_CM) / 100));
+	CHECK(odometer_stride_q16(2 * HEIGHT_CM, 120, ACTIVITY_WALK) ==
+		(2 * odometer_stride_q16(HEIGHT_CM, 120, ACTIVITY_WALK)));
+	CHECK(odometer_stride_q16(HEIGHT_CM, 80, ACTIVITY_STAIRS) == ODO_STAIR_STRIDE_Q16);
+	CHECK(odometer_stride_q16(HEIGHT_CM, 160, ACTIVITY_STAIRS) == ODO_STAIR_STRIDE_Q16);
+}
+
+/**
+ * @function walk
+ * @brief  	 Steps at a fixed interval
+ * @param    1. odo		odometer state
+ * 			 2. ts		time stamp of the first step, next one on return
+ * 			 3. steps	number of steps
+ * 			 4. spm		steps per minute
+ * @return   none
+ */
+static void walk(odometer *odo, uint32_t *ts, uint32_t steps, uint32_t spm){
+	for(uint32_t i = 0; i < steps; i++){
+		odometer_step(odo, *ts, ACTIVITY_WALK);
+		*ts += 60000000UL / spm;
+	}
+}
+
+/**
+ * @function check_cadence
+ * @brief  	 Cadence tracking and restart after a pause, started just
+ * 			 before the time stamps wrap
+ * @param    none
+ * @return   none
+ */
+static void check_cadence(void){
+	odometer odo;
+	uint32_t ts = UINT32_MAX - 5000000UL;
+	uint64_t before;
+
+	odometer_init(&odo, HEIGHT_CM);
+	CHECK(odo.cadence == ODO_CADENCE_DEFAULT);
+
+	//First step, no interval yet
+	odometer_step(&odo, ts, ACTIVITY_WALK);
+	CHECK(odo.cadence == ODO_CADENCE_DEFAULT);
+	CHECK(odo.distance_q16 == odometer_stride_q16(HEIGHT_CM, ODO_CADENCE_DEFAULT, ACTIVITY_WALK));
+	ts += 500000;
+
+	//Through the wrap of ts
+	walk(&odo, &ts, 40, 120);
+	printf("  120 steps/min across the time stamp wrap: cadence %u\n", odo.cadence);
+	CHECK((odo.cadence >= 119) && (odo.cadence <= 120));
+	walk(&odo, &ts, 40, 160);
+	CHECK((odo.cadence >= 159) && (odo.cadence <= 160));
+
+	//Pause, the first step after it uses the default cadence again
+	ts += ODO_PAUSE_US + 1;
+	before = odo.distance_q16;
+	odometer_step(&odo, ts, ACTIVITY_WALK);
+	printf("  after a %lu ms pause: cadence %u\n", (unsigned long)((ODO_PAUSE_US + 1) / 1000), odo.cadence);
+	CHECK(odo.cadence == ODO_CADENCE_DEFAULT);
+	CHECK((odo.distance_q16 - before) == odometer_stride_q16(HEIGHT_CM, ODO_CADENCE_DEFAULT, ACTIVITY_WALK));
+
+	//A pause of exactly ODO_PAUSE_US is still walking
+	ts += ODO_PAUSE_US;
+	odometer_step(&odo, ts, ACTIVITY_WALK);
+	CHECK(odo.cadence == ((3 * ODO_CADENCE_DEFAULT) + (60000000UL / ODO_PAUSE_US) + 2) / 4);
+
+	//Two steps with the same time stamp
+	odometer_step(&odo, ts, ACTIVITY_WALK);
+	CHECK(odo.cadence == ODO_CADENCE_DEFAULT);
+}
+
+/**
+ * @function check_long_walk
+ * @brief  	 Totals of a walk longer than a 32 bit Q16 distance holds
+ * @param    none
+ * @return   none
+ */
+static void check_long_walk(void){
+	odometer odo;
+	uint32_t ts = 0, stride;
+	uint64_t expect;
+
+	odometer_init(&odo, HEIGHT_CM);
+	walk(&odo, &ts, 2, 120);
+	walk(&odo, &ts, 60, 120);				//Cadence settled
+	odo.distance_q16 = 0;
+	odo.calorie_q16 = 0;
+	stride = odometer_stride_q16(HEIGHT_CM, odo.cadence, ACTIVITY_WALK);
+	walk(&odo, &ts, LONG_STEPS, 120);
+	expect = (uint64_t)stride * LONG_STEPS;
+
+	printf("  %d steps: %lu m (32 bit Q16 wraps at 65536 m), %lu kcal\n", LONG_STEPS,
+		(unsigned long)(odo.distance_q16 >> 16), (unsigned long)(odo.calorie_q16 >> 16));
+	CHECK((odo.cadence >= 119) && (odo.cadence <= 120));
+	CHECK(odo.distance_q16 == expect);
+	CHECK((odo.distance_q16 >> 16) > 65536);
+	CHECK(odo.calorie_q16 == ((uint64_t)activity_kcal_q16[ACTIVITY_WALK] * LONG_STEPS));
+}
+
+int main(void){
+	printf("odometer\n");
+	check_stride();
+	check_cadence();
+	check_long_walk();
+	return host_report("test_odometer");
+}
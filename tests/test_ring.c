@@ -0,0 +1,129 @@
+/**@file: test_ring.c
+ * @brief: Stress test of the lock free sample ring with a producer and a
+ *			consumer running on two host threads, standing in for the
+ *			acquisition interrupt and the main loop
+ *			every sample put is got exactly once and in order, the copy
+ *			is never torn (all fields from the same sample)
+ *			dropped samples are counted in overflows
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux, POSIX threads
+ */
+
+#include <pthread.h>
+#include <sched.h>
+#include "ring.h"
+
+#define SAMPLES			20000000U
+#define DROP_YIELD		97				//Dropping producer lets the consumer run this often
+
+static sample_ring_t ring;
+static volatile int producer_done;
+static uint32_t drop_mode;				//Producer drops instead of retrying
+static uint32_t put_ok;
+
+/**
+ * @function make_sample
+ * @brief  	 Sample carrying its sequence number in every field
+ * @param    1. seq		sequence number
+ * 			 2. s		sample built
+ * @return   none
+ */
+static void make_sample(uint32_t seq, mma_sample_t *s){
+	s->ts = seq;
+	s->x = (int16_t)seq;
+	s->y = (int16_t)(seq >> 16);
+	s->z = (int16_t)~seq;
+}
+
+static void *producer(void *arg){
+	mma_sample_t s;
+
+	for(uint32_t seq = 0; seq < SAMPLES; seq++){
+		make_sample(seq, &s);
+		if(drop_mode){
+			put_ok += ring_put(&ring, &s);
+			if((seq % DROP_YIELD) == 0){
+				sched_yield();
+			}
+		}
+		else{
+			while(!ring_put(&ring, &s)){
+				sched_yield();			//Full, also needed on a single core host
+			}
+			put_ok++;
+		}
+	}
+	__atomic_store_n(&producer_done, 1, __ATOMIC_RELEASE);
+	return NULL;
+}
+
+/**
+ * @function run
+ * @brief  	 Run the producer thread against a consumer taking blocks of
+ * 			 varying size
+ * @param    drop	1 if the producer drops samples when the ring is full
+ * @return   none
+ */
+static void run(uint32_t drop){
+	pthread_t thread;
+	mma_sample_t out[SAMPLE_RING_SIZE];
+	mma_sample_t ref;
+	uint32_t got = 0, torn = 0, order = 0, max = 1;
+	int64_t last = -1;
+	int done = 0;
+
+	ring_init(&ring);
+	drop_mode = drop;
+	put_ok = 0;
+	producer_done = 0;
+	pthread_create(&thread, NULL, producer, NULL);
+
+	while(!done){
+		uint32_t n;
+
+		done = __atomic_load_n(&producer_done, __ATOMIC_ACQUIRE);
+		n = ring_get_block(&ring, out, max);
+		for(uint32_t i = 0; i < n; i++){
+			make_sample(out[i].ts, &ref);
+			if((out[i].x != ref.x) || (out[i].y != ref.y) || (out[i].z != ref.z)){
+				torn++;
+			}
+			if(drop ? ((int64_t)out[i].ts <= last) : ((int64_t)out[i].ts != (last + 1))){
+				order++;
+			}
+			last = out[i].ts;
+		}
+		got += n;
+		if(n){
+			done = 0;					//Drain what is left after the producer ends
+		}
+		else{
+			sched_yield();
+		}
+		max = (max % SAMPLE_RING_SIZE) + 1;
+	}
+	pthread_join(thread, NULL);
+
+	printf("  %s: got %lu, dropped %lu, torn %lu, out of order %lu, high water %lu\n",
+		drop ? "dropping" : "blocking", (unsigned long)got, (unsigned long)ring.overflows,
+		(unsigned long)torn, (unsigned long)order, (unsigned long)ring.high_water);
+	CHECK(torn == 0);
+	CHECK(order == 0);
+	CHECK(got == put_ok);
+	CHECK(ring_count(&ring) == 0);
+	if(drop){
+		CHECK(got + ring.overflows == SAMPLES);
+	}
+	else{
+		CHECK(got == SAMPLES);
+	}
+}
+
+int main(void){
+	printf("sample ring, 2 threads\n");
+	run(0);
+	run(1);
+	return host_report("test_ring");
+}
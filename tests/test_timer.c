@@ -0,0 +1,118 @@
+/**@file: test_timer.c
+ * @brief: Host test of timer.c on the simulated SysTick (systick_sim.c)
+ *			the reload value comes from SystemCoreClock, Ticks count
+ *			milliseconds at 48 MHz (RUN) and after a switch to 4 MHz (VLPR)
+ *			followed by timer_clock_changed()
+ *			now_us follows the simulated time and stays continuous and
+ *			monotonic across the clock changes, now_cycles counts the
+ *			cycles of the current clock
+ *			delay_us waits the time asked at both clocks
+ *			the clock hooks run once per timer_clock_changed(), after the
+ *			SysTick has the new rate
+ *
+ * @author: Swapnil Ghonge
+ * @date: May 2nd 2022
+ * @tools: GCC on Linux
+ */
+
+#include "timer.h"
+
+#define RUN_HZ			48000000
+#define VLPR_HZ			4000000
+#define RUN_MS			100				//Simulated time of each rate check
+#define DELAY_US		500
+
+static uint32_t hook_runs;
+static uint32_t hook_load;
+
+static void clock_hook_probe(void){
+	hook_runs++;
+	hook_load = sim_systick.LOAD;
+}
+
+/**
+ * @function check_rate
+ * @brief  	 Ticks, now_us, now_cycles and delay_us at the current clock
+ * @param    hz		core clock
+ * @return   none
+ */
+static void check_rate(uint32_t hz){
+	uint32_t t0, u0, c0, ticks, us, cycles, wait_us;
+	uint64_t h0, host_us;
+
+	t0 = getTicks();
+	u0 = now_us();
+	c0 = now_cycles();
+	h0 = host_time_ns;
+	host_advance_ns(RUN_MS * 1000000ULL);
+	ticks = getTicks() - t0;
+	us = now_us() - u0;
+	cycles = now_cycles() - c0;
+	host_us = (host_time_ns - h0) / 1000;
+
+	h0 = host_time_ns;
+	delay_us(DELAY_US);
+	wait_us = (uint32_t)((host_time_ns - h0) / 1000);
+
+	printf("  %2lu MHz: LOAD %lu, %lu ticks in %d ms, now_us %lu / %lu us, %lu cycles, delay_us(%d) %lu us\n",
+		(unsigned long)(hz / 1000000), (unsigned long)sim_systick.LOAD, (unsigned long)ticks, RUN_MS,
+		(unsigned long)us, (unsigned long)host_us, (unsigned long)cycles, DELAY_US, (unsigned long)wait_us);
+	CHECK(sim_systick.LOAD == ((hz / 1000) - 1));
+	CHECK(timer_cycles_per_us == (hz / 1000000));
+	CHECK((ticks >= (RUN_MS - 1)) && (ticks <= (RUN_MS + 1)));
+	CHECK((us + 2 >= host_us) && (us <= host_us + 2));
+	CHECK((cycles + (2 * timer_cycles_per_us) >= (host_us * (hz / 1000000))) &&
+		(cycles <= ((host_us + 2) * (hz / 1000000))));
+	CHECK((wait_us >= DELAY_US) && (wait_us <= (DELAY_US + 10)));
+}
+
+/**
+ * @function switch_clock
+ * @brief  	 Change the core clock in the middle of a millisecond and
+ * 			 check the time stamps across the change
+ * @param    hz		new core clock
+ * @return   none
+ */
+static void switch_clock(uint32_t hz){
+	uint32_t before, after, last, back = 0;
+	uint64_t h0;
+
+	host_advance_ns(333333);				//Part way into a millisecond
+	before = now_us();
+	h0 = host_time_ns;
+	sim_systick_set_core_hz(hz);
+	hook_runs = 0;
+	timer_clock_changed();
+	after = now_us();
+	CHECK(hook_runs == 1);
+	CHECK(hook_load == ((hz / 1000) - 1));
+	CHECK((after >= before) && ((after - before) <= (((host_time_ns - h0) / 1000) + 2)));
+
+	//Monotonic through the next reloads
+	last = after;
+	for(uint32_t i = 0; i < 5000; i++){
+		uint32_t t;
+
+		host_advance_ns(777);
+		t = now_us();
+		back += (t < last);
+		last = t;
+	}
+	CHECK(back == 0);
+}
+
+int main(void){
+	printf("SysTick time base\n");
+	sim_systick_init(RUN_HZ);
+	init_systick();
+	CHECK(timer_add_clock_hook(clock_hook_probe));
+	CHECK(timer_add_clock_hook(clock_hook_probe));	//Already there, not run twice
+	check_rate(RUN_HZ);
+
+	switch_clock(VLPR_HZ);
+	check_rate(VLPR_HZ);
+
+	switch_clock(RUN_HZ);
+	check_rate(RUN_HZ);
+	return host_report("test_timer");
+}
@@ -0,0 +1,163 @@
+#!/usr/bin/env python3
+"""Emit source/activity_tree.h, the decision tree used by source/activity.c.
+
+    gen_activity_tree.py                  default hand set tree
+    gen_activity_tree.py --train FILE     CART trained on a CSV of windows
+    gen_activity_tree.py --json FILE      tree exported as nested JSON
+
+The CSV has one row per window with the columns std, step_rate, cadence,
+vert_ratio (as computed by activity.c) and label (idle/walk/run/stairs).
+A JSON node is {"feature": name, "threshold": int, "left": node,
+"right": node} with left taken when the feature is below the threshold,
+a leaf is just the class name.
+"""
+import argparse
+import csv
+import json
+import sys
+
+FEATURES = ["std", "step_rate", "cadence", "vert_ratio"]
+CLASSES = ["idle", "walk", "run", "stairs"]
+
+# Hand set from bench recordings until a trained tree replaces it.
+# std in 2g counts (4096/g), rates in steps/min, vert_ratio in Q8.
+DEFAULT_TREE = {
+    "feature": "std", "threshold": 250,
+    "left": "idle",
+    "right": {
+        "feature": "step_rate", "threshold": 40,
+        "left": "idle",
+        "right": {
+            "feature": "step_rate", "threshold": 140,
+            "left": {
+                "feature": "vert_ratio", "threshold": 200,
+                "left": "walk",
+                "right": {
+                    "feature": "cadence", "threshold": 100,
+                    "left": "stairs",
+                    "right": "walk",
+                },
+            },
+            "right": "run",
+        },
+    },
+}
+
+
+def gini(rows):
+    n = len(rows)
+    if n == 0:
+        return 0.0
+    counts = {}
+    for r in rows:
+        counts[r[-1]] = counts.get(r[-1], 0) + 1
+    return 1.0 - sum((c / n) ** 2 for c in counts.values())
+
+
+def majority(rows):
+    counts = {}
+    for r in rows:
+        counts[r[-1]] = counts.get(r[-1], 0) + 1
+    return max(counts, key=counts.get)
+
+
+def train(rows, depth, max_depth, min_rows):
+    if depth == max_depth or len(rows) < min_rows or gini(rows) == 0.0:
+        return majority(rows)
+    best = None
+    for f in range(len(FEATURES)):
+        for thr in sorted(set(r[f] for r in rows)):
+            left = [r for r in rows if r[f] < thr]
+            right = [r for r in rows if r[f] >= thr]
+            if not left or not right:
+                continue
+            cost = (len(left) * gini(left) + len(right) * gini(right)) / len(rows)
+            if best is None or cost < best[0]:
+                best = (cost, f, thr, left, right)
+    if best is None:
+        return majority(rows)
+    _, f, thr, left, right = best
+    return {
+        "feature": FEATURES[f], "threshold": int(thr),
+        "left": train(left, depth + 1, max_depth, min_rows),
+        "right": train(right, depth + 1, max_depth, min_rows),
+    }
+
+
+def load_csv(path):
+    rows = []
+    with open(path, newline="") as f:
+        for rec in csv.DictReader(f):
+            rows.append([int(float(rec[k])) for k in FEATURES] + [rec["label"]])
+    return rows
+
+
+def flatten(tree):
+    """Breadth first list of (feature, threshold, left, right) tuples."""
+    nodes = []
+    queue = [tree]
+    while queue:
+        node = queue.pop(0)
+        if isinstance(node, str):
+            nodes.append(("ACTIVITY_LEAF", "ACTIVITY_" + node.upper(), 0, 0))
+            continue
+        left = len(nodes) + len(queue) + 1
+        nodes.append(("FEAT_" + node["feature"].upper(), str(node["threshold"]),
+                      left, left + 1))
+        queue.append(node["left"])
+        queue.append(node["right"])
+    return nodes
+
+
+def depth(tree):
+    if isinstance(tree, str):
+        return 1
+    return 1 + max(depth(tree["left"]), depth(tree["right"]))
+
+
+def emit(tree, source, out):
+    nodes = flatten(tree)
+    out.write("/**@file: activity_tree.h\n")
+    out.write(" * @brief: Decision tree of the activity classifier, generated by\n")
+    out.write(" *			tools/gen_activity_tree.py (%s), do not edit.\n" % source)
+    out.write(" *			Node: {feature, threshold, left, right}, left when the\n")
+    out.write(" *			feature is below the threshold. Leaves hold the class.\n")
+    out.write(" */\n")
+    out.write("#ifndef ACTIVITY_TREE_H_\n#define ACTIVITY_TREE_H_\n\n")
+    out.write("#define ACTIVITY_TREE_DEPTH\t%d\n" % depth(tree))
+    out.write("#define ACTIVITY_TREE_NODES\t%d\n\n" % len(nodes))
+    out.write("static const activity_node activity_tree[ACTIVITY_TREE_NODES] = {\n")
+    for i, (feat, thr, left, right) in enumerate(nodes):
+        out.write("\t{%s, %s, %d, %d},\t\t//%d\n" % (feat, thr, left, right, i))
+    out.write("};\n\n#endif /* ACTIVITY_TREE_H_ */\n")
+
+
+def main():
+    parser = argparse.ArgumentParser()
+    parser.add_argument("--train", help="CSV of labelled feature windows")
+    parser.add_argument("--json", help="tree as nested JSON")
+    parser.add_argument("--max-depth", type=int, default=4)
+    parser.add_argument("--min-rows", type=int, default=4)
+    parser.add_argument("-o", "--output", help="header to write, stdout if omitted")
+    args = parser.parse_args()
+
+    if args.train:
+        tree = train(load_csv(args.train), 1, args.max_depth, args.min_rows)
+        source = "trained on " + args.train
+    elif args.json:
+        with open(args.json) as f:
+            tree = json.load(f)
+        source = "from " + args.json
+    else:
+        tree = DEFAULT_TREE
+        source = "default tree"
+
+    if args.output:
+        with open(args.output, "w") as f:
+            emit(tree, source, f)
+    else:
+        emit(tree, source, sys.stdout)
+
+
+if __name__ == "__main__":
+    main()